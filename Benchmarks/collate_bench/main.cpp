@@ -0,0 +1,101 @@
+/*
+ * Сортировка имён: QString::localeAwareCompare на каждое сравнение, ключи QCollatorSortKey
+ * (считаются один раз, но живут только в памяти) и ключи CollationKey, которые хранятся в базе.
+ * Для CollationKey печатается, сколько соседних пар его порядка localeAwareCompare считает
+ * перевёрнутыми: расхождения возможны только в редких знаках и зависят от ICU в сборке Qt.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <QCollator>
+#include <QElapsedTimer>
+#include <QLocale>
+#include <QString>
+
+#include "collationkey.h"
+#include "treegenerator.h"
+
+static void report(const char *name, double seconds, int count)
+{
+   printf("%-28s %10.3f %14.0f\n", name, seconds, count / seconds);
+}
+
+int main(int argc, char *argv[])
+{
+   int count = (argc > 1) ? atoi(argv[1]) : 500000;
+   QLocale::setDefault(QLocale(QLocale::Russian, QLocale::Russia));
+
+   // Нерусских фамилий больше обычного: латиница и украинские буквы - самые трудные места ключа
+   TreeGeneratorOptions options;
+   options.persons = count;
+   options.foreign = 0.3;
+   TreeGenerator generator(options);
+   std::mt19937 rng(2019);
+   std::vector<std::string> names(count);
+   QStringList qnames;
+   qnames.reserve(count);
+   for (int i = 0; i < count; i++)
+   {
+      std::string &name = names[i];
+      name = generator.name(i);
+      if ((rng() % 4) == 0)
+         for (char &c : name)
+            if ((c >= 'A') && (c <= 'Z'))
+               c = static_cast<char>(c + 'a' - 'A');
+      qnames.append(QString::fromStdString(name));
+   }
+
+   printf("%d names\n\n", count);
+   printf("%-28s %10s %14s\n", "", "seconds", "names/s");
+
+   QElapsedTimer timer;
+   QStringList byCompare = qnames;
+   timer.start();
+   std::sort(byCompare.begin(), byCompare.end(), [](const QString &a, const QString &b)
+   {
+      return QString::localeAwareCompare(a, b) < 0;
+   });
+   report("localeAwareCompare", timer.nsecsElapsed() / 1e9, count);
+
+   QCollator collator(QLocale(QLocale::Russian, QLocale::Russia));
+   std::vector<QCollatorSortKey> collatorKeys;
+   std::vector<int> byCollator(count);
+   timer.start();
+   collatorKeys.reserve(count);
+   for (const QString &name : qnames)
+      collatorKeys.push_back(collator.sortKey(name));
+   for (int i = 0; i < count; i++)
+      byCollator[i] = i;
+   std::sort(byCollator.begin(), byCollator.end(), [&collatorKeys](int a, int b)
+   {
+      return collatorKeys[a].compare(collatorKeys[b]) < 0;
+   });
+   report("QCollatorSortKey", timer.nsecsElapsed() / 1e9, count);
+
+   timer.start();
+   std::vector<int> byKey = CollationKey::order(names);
+   report("CollationKey", timer.nsecsElapsed() / 1e9, count);
+
+   // Ключи уже посчитаны (лежат в базе) - остаётся только сортировка
+   std::vector<std::string> keys;
+   keys.reserve(count);
+   for (const std::string &name : names)
+      keys.push_back(CollationKey::of(name));
+   std::vector<int> stored(count);
+   for (int i = 0; i < count; i++)
+      stored[i] = i;
+   timer.start();
+   std::sort(stored.begin(), stored.end(), [&keys](int a, int b) { return keys[a] < keys[b]; });
+   report("CollationKey, stored keys", timer.nsecsElapsed() / 1e9, count);
+
+   int inversions = 0;
+   for (int i = 1; i < count; i++)
+      inversions += (QString::localeAwareCompare(qnames[byKey[i - 1]], qnames[byKey[i]]) > 0);
+   printf("\nadjacent pairs out of localeAwareCompare order: %d\n", inversions);
+   return 0;
+}
@@ -0,0 +1,23 @@
+#-------------------------------------------------
+#
+# Benchmark: DB layer at 1k, 100k and 1M rows
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = db_bench
+TEMPLATE = app
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+        main.cpp
+
+# Ядро берётся готовой библиотекой: по умолчанию из сборки FamilyTree_ver2 двумя уровнями выше
+isEmpty(FAMILYTREE_CORE_DIR): FAMILYTREE_CORE_DIR = $$OUT_PWD/../..
+include(../../FamilyTreeCore.pri)
@@ -0,0 +1,215 @@
+/*
+ * Замеры слоя базы данных для сравнения до и после правок db.cpp.
+ *    db_bench [размеры через запятую] [файл JSON] [каталог для баз]
+ * На каждый размер (по умолчанию 1000, 100000, 1000000 людей) создаётся новая база из TreeGenerator,
+ * затем замеряются createRoot, addPerson по одному и пачкой, getListOfRoots, поиск по ID,
+ * предки (рекурсивный запрос против обхода поиском по ID) и полные просмотры таблицы.
+ * Таблица печатается в консоль, те же числа пишутся в JSON: по объекту на замер
+ * с полями name, rows, iterations, seconds, us_per_op, ops_per_s.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <QDir>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+
+#include "treegenerator.h"
+#include "db.h"
+
+#define BENCH_ROOTS          20      // createRoot на размер
+#define BENCH_SINGLE_ROWS    1000    // addPerson по одному, не больше размера
+#define BENCH_LIST_ROOTS     1000
+#define BENCH_LOOKUPS        10000
+#define BENCH_ANCESTORS      1000
+#define BENCH_COUNTS         10
+
+static const char *TABLE = "T_BENCH";
+
+static void report(QJsonArray &results, const char *name, int rows, int iterations, double seconds)
+{
+   double perOp = seconds * 1e6 / iterations;
+   double perSecond = (seconds > 0) ? iterations / seconds : 0.0;
+   printf("%-28s %10d %10d %14.2f %14.0f\n", name, rows, iterations, perOp, perSecond);
+
+   QJsonObject result;
+   result["name"] = name;
+   result["rows"] = rows;
+   result["iterations"] = iterations;
+   result["seconds"] = seconds;
+   result["us_per_op"] = perOp;
+   result["ops_per_s"] = perSecond;
+   results.append(result);
+}
+
+// Прежний способ: родители по одному поиском по ID
+static int walkAncestors(DB &db, uint32_t id)
+{
+   std::vector<uint32_t> queue(1, id);
+   std::unordered_set<uint32_t> seen;
+   for (size_t i = 0; i < queue.size(); i++)
+   {
+      PersonRow row;
+      bool found;
+      if (db.getPerson(TABLE, queue[i], row, found) || !found)
+         continue;
+      for (uint32_t parent : { row.fatherId, row.motherId })
+      {
+         if ((parent == static_cast<uint32_t>(-1)) || !seen.insert(parent).second)
+            continue;
+         queue.push_back(parent);
+      }
+   }
+   return static_cast<int>(seen.size());
+}
+
+static int runSize(int size, const QString &dir, QJsonArray &results)
+{
+   QString fileName = QDir(dir).filePath(QString("db_bench_%1.db").arg(size));
+   QFile::remove(fileName);
+   DB db(fileName.toLocal8Bit().constData());
+   if (db.openDB() || db.createTables())
+   {
+      printf("Could not open %s\n", fileName.toLocal8Bit().constData());
+      return -1;
+   }
+
+   TreeGeneratorOptions options;
+   options.persons = size;
+   TreeGenerator generator(options);
+   std::mt19937 rng(2019);
+   QElapsedTimer timer;
+   int ret = 0;
+
+   printf("%d persons\n", size);
+   printf("%-28s %10s %10s %14s %14s\n", "", "rows", "iterations", "us/op", "ops/s");
+
+   timer.start();
+   ret |= db.createRoot("db_bench", TABLE);
+   for (int i = 1; i < BENCH_ROOTS; i++)
+      ret |= db.createRoot("db_bench " + std::to_string(i), std::string(TABLE) + "_" + std::to_string(i));
+   report(results, "createRoot", size, BENCH_ROOTS, timer.nsecsElapsed() / 1e9);
+
+   timer.start();
+   ret |= generator.writeDB(db, TABLE);
+   report(results, "addPersons, bulk", size, size, timer.nsecsElapsed() / 1e9);
+
+   // В отдельную таблицу, чтобы не менять замеряемую
+   int single = std::min(size, BENCH_SINGLE_ROWS);
+   std::string singleTable = std::string(TABLE) + "_1";
+   timer.start();
+   for (int i = 0; i < single; i++)
+   {
+      PersonRow row;
+      generator.fillRow(i, row);
+      ret |= db.addPerson(singleTable, row.id, row.name, row.birthDate, row.isAlive, row.deathDate, row.info,
+                          row.birthPlace, row.photo, row.sex, row.fatherId, row.motherId, row.childrenCnt,
+                          row.childrenID);
+   }
+   report(results, "addPerson, single", size, single, timer.nsecsElapsed() / 1e9);
+
+   std::vector<std::string> roots, tables;
+   timer.start();
+   for (int i = 0; i < BENCH_LIST_ROOTS; i++)
+      ret |= db.getListOfRoots(roots, tables);
+   report(results, "getListOfRoots", size, BENCH_LIST_ROOTS, timer.nsecsElapsed() / 1e9);
+
+   PersonRow row;
+   bool found;
+   timer.start();
+   for (int i = 0; i < BENCH_LOOKUPS; i++)
+      ret |= db.getPerson(TABLE, generator.id(static_cast<int>(rng() % size)), row, found);
+   report(results, "getPerson by id", size, BENCH_LOOKUPS, timer.nsecsElapsed() / 1e9);
+
+   // Предки младшей половины дерева - у них самые длинные родословные
+   std::vector<uint32_t> ids(BENCH_ANCESTORS);
+   for (uint32_t &id : ids)
+      id = generator.id(size - 1 - static_cast<int>(rng() % ((size + 1) / 2)));
+   std::vector<PersonKey> keys;
+   long long viaQuery = 0, viaWalk = 0;
+   timer.start();
+   for (uint32_t id : ids)
+   {
+      ret |= db.getAncestors(TABLE, id, 0, keys);
+      viaQuery += static_cast<long long>(keys.size());
+   }
+   report(results, "getAncestors", size, BENCH_ANCESTORS, timer.nsecsElapsed() / 1e9);
+   timer.start();
+   for (uint32_t id : ids)
+      viaWalk += walkAncestors(db, id);
+   report(results, "ancestors, getPerson walk", size, BENCH_ANCESTORS, timer.nsecsElapsed() / 1e9);
+   if (viaQuery != viaWalk)
+   {
+      printf("ANCESTOR COUNTS DIFFER: %lld vs %lld\n", viaQuery, viaWalk);
+      ret = -1;
+   }
+
+   int64_t count = 0;
+   timer.start();
+   for (int i = 0; i < BENCH_COUNTS; i++)
+      ret |= db.countPersons(TABLE, count);
+   report(results, "countPersons", size, BENCH_COUNTS, timer.nsecsElapsed() / 1e9);
+
+   std::vector<PersonRow> rows;
+   timer.start();
+   ret |= db.getPersonRows(TABLE, rows);
+   report(results, "scan, getPersonRows", size, 1, timer.nsecsElapsed() / 1e9);
+   rows.clear();
+   rows.shrink_to_fit();
+
+   PersonColumns columns;
+   timer.start();
+   ret |= db.getPersonColumns(TABLE, columns);
+   report(results, "scan, getPersonColumns", size, 1, timer.nsecsElapsed() / 1e9);
+   columns.clear();
+
+   std::vector<Person> persons;
+   timer.start();
+   ret |= db.getListOfPersons(TABLE, persons);
+   report(results, "scan, getListOfPersons", size, 1, timer.nsecsElapsed() / 1e9);
+   printf("\n");
+
+   db.closeDB();
+   QFile::remove(fileName);
+   return ret ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+   QString sizeList = (argc > 1) ? QString(argv[1]) : QString("1000,100000,1000000");
+   QString jsonName = (argc > 2) ? QString(argv[2]) : QString("db_bench.json");
+   QString dir = (argc > 3) ? QString(argv[3]) : QDir::temp().path();
+
+   QJsonArray results;
+   int ret = 0;
+   for (const QString &size : sizeList.split(',', QString::SkipEmptyParts))
+      if ((size.toInt() > 0) && runSize(size.toInt(), dir, results))
+         ret = -1;
+
+   QJsonObject root;
+   root["benchmark"] = "db_bench";
+   root["sqlite"] = sqlite3_libversion();
+   root["qt"] = qVersion();
+   root["seed"] = static_cast<double>(TreeGeneratorOptions().seed);
+   root["results"] = results;
+
+   QFile json(jsonName);
+   if (!json.open(QIODevice::WriteOnly | QIODevice::Truncate))
+   {
+      printf("Could not write %s\n", jsonName.toLocal8Bit().constData());
+      return -1;
+   }
+   json.write(QJsonDocument(root).toJson());
+   printf("%s\n", jsonName.toLocal8Bit().constData());
+   return ret;
+}
@@ -0,0 +1,91 @@
+/*
+ * Нечёткий поиск по именам: полная матрица Дамерау-Левенштейна на каждого кандидата
+ * против NameMatcher по одному и по дорожкам. Найденные совпадения у всех способов
+ * должны быть одинаковыми. Дорожки стоит мерить и в сборке с -mavx2:
+ *    qmake "QMAKE_CXXFLAGS += -mavx2"
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <QElapsedTimer>
+
+#include "namematcher.h"
+#include "treegenerator.h"
+
+// Нормализованное имя с 0-3 опечатками
+static std::string makeName(const std::string &source, std::mt19937 &rng)
+{
+   std::string name = NameMatcher::normalize(source);
+   int typos = rng() % 4;
+   for (int t = 0; (t < typos) && (name.size() > 2); t++)
+   {
+      size_t pos = rng() % (name.size() - 1);
+      switch (rng() % 4)
+      {
+      case 0: name.erase(pos, 1); break;
+      case 1: name.insert(name.begin() + pos, name[rng() % name.size()]); break;
+      case 2: name[pos] = name[rng() % name.size()]; break;
+      default: std::swap(name[pos], name[pos + 1]); break;
+      }
+   }
+   return name;
+}
+
+static void report(const char *name, double seconds, int count, int matches)
+{
+   printf("%-24s %10.3f %14.0f %10d\n", name, seconds, count / seconds, matches);
+}
+
+int main(int argc, char *argv[])
+{
+   int count = (argc > 1) ? atoi(argv[1]) : 1000000;
+   int maxDistance = (argc > 2) ? atoi(argv[2]) : 2;
+
+   TreeGeneratorOptions options;
+   options.persons = count;
+   TreeGenerator generator(options);
+   std::mt19937 rng(2019);
+   std::vector<std::string> names(generator.size());
+   for (int i = 0; i < generator.size(); i++)
+      names[i] = makeName(generator.name(i), rng);
+
+   NameMatcher matcher("Смирнов Иван Петрович", maxDistance);
+   std::string pattern = NameMatcher::normalize("Смирнов Иван Петрович");
+   printf("%d names, max distance %d\n\n", count, maxDistance);
+   printf("%-24s %10s %14s %10s\n", "", "seconds", "names/s", "matches");
+
+   QElapsedTimer timer;
+   std::vector<int> naive(count);
+   int naiveMatches = 0;
+   timer.start();
+   for (int i = 0; i < count; i++)
+   {
+      naive[i] = std::min(NameMatcher::naiveDistance(pattern, names[i], true), maxDistance + 1);
+      naiveMatches += (naive[i] <= maxDistance);
+   }
+   report("full matrix", timer.nsecsElapsed() / 1e9, count, naiveMatches);
+
+   std::vector<int> scalar, lanes;
+   struct { const char *name; std::vector<int> *result; bool lanes; } runs[] = {
+      { "bit-parallel", &scalar, false },
+      { "bit-parallel, lanes", &lanes, true }
+   };
+   for (const auto &run : runs)
+   {
+      timer.start();
+      matcher.distances(names, *run.result, run.lanes);
+      double seconds = timer.nsecsElapsed() / 1e9;
+      int matches = 0;
+      for (int d : *run.result)
+         matches += (d <= maxDistance);
+      report(run.name, seconds, count, matches);
+   }
+
+   bool same = (naive == scalar) && (naive == lanes);
+   printf("\n%s\n", same ? "results match" : "RESULTS DIFFER");
+   return same ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+#-------------------------------------------------
+#
+# Benchmark: sequential vs parallel GEDCOM parsing
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = gedcom_bench
+TEMPLATE = app
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+        main.cpp
+
+# Ядро берётся готовой библиотекой: по умолчанию из сборки FamilyTree_ver2 двумя уровнями выше
+isEmpty(FAMILYTREE_CORE_DIR): FAMILYTREE_CORE_DIR = $$OUT_PWD/../..
+include(../../FamilyTreeCore.pri)
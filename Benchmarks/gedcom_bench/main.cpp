@@ -0,0 +1,70 @@
+/*
+ * Скорость разбора GEDCOM: последовательное чтение против параллельного по кускам.
+ * Генерируется синтетический файл заданного размера (по умолчанию 1 ГБ), затем он
+ * разбирается с разным числом потоков. Выводятся МБ/с и контрольная сумма порядка записей -
+ * она должна совпадать во всех прогонах.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QThread>
+
+#include "gedcomparser.h"
+#include "treegenerator.h"
+
+#define GEDCOM_PERSON_BYTES   200   // в среднем на человека вместе с его долей семей
+
+int main(int argc, char *argv[])
+{
+   long long megabytes = (argc > 1) ? atoll(argv[1]) : 1024;
+   QString fileName = (argc > 2) ? QString(argv[2]) : QDir::temp().filePath("gedcom_bench.ged");
+
+   QElapsedTimer timer;
+   timer.start();
+   TreeGeneratorOptions options;
+   options.persons = static_cast<int>(megabytes * 1024 * 1024 / GEDCOM_PERSON_BYTES);
+   if (TreeGenerator(options).writeGedcom(fileName))
+   {
+      printf("Could not write %s\n", fileName.toLocal8Bit().constData());
+      return -1;
+   }
+   double size = QFileInfo(fileName).size() / (1024.0 * 1024.0);
+   printf("generated %.0f MB in %.1f s: %s\n\n", size, timer.elapsed() / 1000.0, fileName.toLocal8Bit().constData());
+
+   printf("%8s %10s %10s %10s %18s\n", "threads", "seconds", "MB/s", "records", "order checksum");
+
+   int ideal = QThread::idealThreadCount();
+   std::vector<int> threads = { 1, 2, 4 };
+   if (ideal > 4)
+      threads.push_back(ideal);
+
+   for (int count : threads)
+   {
+      long long records = 0;
+      unsigned long long checksum = 0;
+
+      GedcomParser parser;
+      parser.onRecord = [&](const GedcomRecord &record)
+      {
+         records++;
+         checksum = checksum * 1000003 + std::hash<std::string>()(record.xref + record.name + record.birthDate);
+      };
+
+      timer.start();
+      parser.parseFile(fileName, count);
+      double seconds = timer.nsecsElapsed() / 1e9;
+
+      printf("%8d %10.2f %10.1f %10lld %18llx\n", count, seconds, size / seconds, records, checksum);
+   }
+
+   QFile::remove(fileName);
+   return 0;
+}
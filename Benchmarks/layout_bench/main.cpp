@@ -0,0 +1,140 @@
+/*
+ * Сравнение полной и точечной перекладки дерева.
+ * Для каждого размера дерева выполняется серия правок (ребёнок, ребёнок с новым супругом,
+ * новый родитель), после каждой замеряется TreeLayout::update() и TreeLayout::run()
+ * и проверяется, что обе дают одни и те же положения карточек.
+ *
+ * Деревья генератора устроены просто: мать - супруга, добавленная вместе с ребёнком, родители раньше детей.
+ * На произвольных данных (мать или отец - любой более ранний человек) update() тоже совпадает с run(),
+ * кроме одного случая: семья, которую отцепили к корню, чтобы разорвать цикл семей (супруги объединяются
+ * в одну семью, и семья может оказаться своим предком), не прицепляется обратно, когда правка цикл убирает.
+ * До следующей полной раскладки такая семья стоит отдельным деревом.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include <QElapsedTimer>
+
+#include "treegraph.h"
+#include "treelayout.h"
+#include "treegenerator.h"
+
+#define POSITION_EPS 1e-6   // update() складывает смещения по пути от корня, run() - по-своему
+
+static TreeGraph makeTree(int count)
+{
+   TreeGeneratorOptions options;
+   options.persons = count;
+   TreeGenerator generator(options);
+
+   // Родители у генератора всегда раньше детей, номера узлов совпадают с номерами людей
+   TreeGraph graph;
+   graph.reserve(count);
+   for (int i = 0; i < generator.size(); i++)
+      graph.addNode(generator.id(i), generator.father(i), generator.mother(i));
+   graph.finalize();
+   return graph;
+}
+
+// Карточки сравниваются относительно левого края: полная раскладка может сдвинуть всё дерево целиком
+static bool samePositions(const TreeLayout &a, const TreeLayout &b)
+{
+   if (a.size() != b.size())
+      return false;
+   for (int node = 0; node < a.size(); node++)
+      if ((std::fabs((a.x(node) - a.left()) - (b.x(node) - b.left())) > POSITION_EPS) || (a.y(node) != b.y(node)))
+         return false;
+   return true;
+}
+
+static std::vector<int> randomEdit(TreeGraph &graph, std::mt19937 &rng, uint32_t id)
+{
+   std::vector<int> changed;
+   int n = graph.size();
+   int node = rng() % n;
+
+   switch (rng() % 3)
+   {
+   case 0:
+      changed.push_back(graph.addNode(id, node, -1));
+      break;
+   case 1:
+   {
+      int spouse = graph.addNode(id);
+      changed.push_back(spouse);
+      changed.push_back(graph.addNode(id + 1, node, spouse));
+      break;
+   }
+   default:
+      for (int tries = 0; tries < 100; tries++, node = rng() % n)
+      {
+         if ((graph.father[node] < 0) && (graph.mother[node] < 0))
+         {
+            int parent = graph.addNode(id);
+            graph.setParents(node, parent, -1);
+            changed.push_back(parent);
+            changed.push_back(node);
+            break;
+         }
+      }
+      break;
+   }
+
+   graph.finalize();
+   return changed;
+}
+
+int main(int argc, char *argv[])
+{
+   int edits = (argc > 1) ? atoi(argv[1]) : 100;
+   const int sizes[] = { 1000, 10000, 100000, 1000000 };
+
+   printf("%10s %8s %14s %14s %10s\n", "persons", "edits", "full, ms", "update, ms", "speedup");
+
+   for (int count : sizes)
+   {
+      std::mt19937 rng(12345);
+      TreeGraph graph = makeTree(count);
+
+      TreeLayout layout;
+      layout.run(graph);
+
+      qint64 fullNs = 0, updateNs = 0;
+      int applied = 0;
+      QElapsedTimer timer;
+      uint32_t id = 100000000;
+      for (int e = 0; e < edits; e++, id += 2)
+      {
+         std::vector<int> changed = randomEdit(graph, rng, id);
+         if (changed.empty())
+            continue;
+         applied++;
+
+         timer.start();
+         layout.update(graph, changed);
+         updateNs += timer.nsecsElapsed();
+
+         TreeLayout full;
+         timer.start();
+         full.run(graph);
+         fullNs += timer.nsecsElapsed();
+
+         if (!samePositions(layout, full))
+         {
+            fprintf(stderr, "%d persons, edit %d: update() differs from run()\n", count, e);
+            return EXIT_FAILURE;
+         }
+      }
+
+      // Пропущенные правки (не нашлось человека без родителей) в среднее не входят
+      double fullMs = applied ? fullNs / 1e6 / applied : 0.0;
+      double updateMs = applied ? updateNs / 1e6 / applied : 0.0;
+      printf("%10d %8d %14.3f %14.3f %9.1fx\n", count, applied, fullMs, updateMs,
+             updateMs > 0 ? fullMs / updateMs : 0.0);
+   }
+
+   return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * Сохранение дерева: прежний путь save_pure (файл открывается на каждого человека,
+ * endl сбрасывает поток на каждой строке) против TreeWriter без сжатия и с deflate,
+ * плюс чтение обратно через TreeReader. Контрольная сумма прочитанного должна совпасть
+ * с исходной.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QElapsedTimer>
+
+#include "person.h"
+#include "treewriter.h"
+#include "treegenerator.h"
+
+// Прежний формат и прежний способ записи: как Person::save_pure
+static void savePure(const Person &pers, const QString &fileName)
+{
+   QFile ofile;
+   ofile.setFileName(fileName);
+   ofile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Append);
+   if (!ofile.isOpen())
+      return;
+
+   QTextStream out(&ofile);
+   out << pers.id << endl << 0 << ' ' << 0 << endl;
+   out << endl << pers.name << endl;
+   out << pers.bIsAlive << ' ' << pers.birthDate.toString("dd.MM.yyyy")
+       << ' ' << pers.deathDate.toString("dd.MM.yyyy") << endl;
+   out << pers.sex << endl;
+   out << ((pers.mother != nullptr) ? static_cast<long long>(pers.mother->id) : -1) << ' ';
+   out << ((pers.father != nullptr) ? static_cast<long long>(pers.father->id) : -1) << endl;
+   out << pers.children.size() << ' ';
+   for (auto it : pers.children)
+      out << it->id << ' ';
+   out << endl;
+   out << pers.birthPlace << endl;
+   out << "/!info!\\" << endl;
+   out << pers.info << endl;
+   out << "\\!info!/" << endl;
+
+   ofile.close();
+}
+
+static unsigned long long checksum(const std::vector<Person> &persons, bool withPhotos)
+{
+   unsigned long long sum = 0;
+   for (const Person &pers : persons)
+   {
+      std::string key = pers.name.toStdString() + pers.info.toStdString() + pers.sex.toStdString();
+      sum = sum * 1000003 + std::hash<std::string>()(key) + pers.id + pers.children.size();
+      sum += pers.father ? pers.father->id : 0;
+      if (withPhotos)
+         sum += static_cast<unsigned long long>(pers.photoData.size());
+   }
+   return sum;
+}
+
+static void report(const char *name, double seconds, const QString &fileName, int count)
+{
+   double size = QFileInfo(fileName).size() / (1024.0 * 1024.0);
+   printf("%-24s %10.3f %10.1f %14.0f\n", name, seconds, size, count / seconds);
+}
+
+int main(int argc, char *argv[])
+{
+   int count = (argc > 1) ? atoi(argv[1]) : 100000;
+   QString dir = (argc > 2) ? QString(argv[2]) : QDir::temp().path();
+
+   TreeGeneratorOptions options;
+   options.persons = count;
+   std::vector<Person> persons;
+   TreeGenerator(options).makePersons(persons);
+   QVector<Person*> pointers;
+   for (Person &pers : persons)
+      pointers.append(&pers);
+
+   printf("%d persons\n\n", count);
+   printf("%-24s %10s %10s %14s\n", "", "seconds", "MB", "persons/s");
+
+   QElapsedTimer timer;
+   QString pureFile = QDir(dir).filePath("save_bench_pure.txt");
+   QFile::remove(pureFile);
+   timer.start();
+   for (const Person &pers : persons)
+      savePure(pers, pureFile);
+   report("save_pure per person", timer.nsecsElapsed() / 1e9, pureFile, count);
+
+   QString plainFile = QDir(dir).filePath("save_bench_plain.tree");
+   TreeWriter writer;
+   timer.start();
+   writer.write(plainFile, pointers);
+   report("TreeWriter plain", timer.nsecsElapsed() / 1e9, plainFile, count);
+
+   QString packedFile = QDir(dir).filePath("save_bench_deflate.tree");
+   writer.setCompression(TREE_DEFLATE, 1);
+   timer.start();
+   writer.write(packedFile, pointers);
+   report("TreeWriter deflate(1)", timer.nsecsElapsed() / 1e9, packedFile, count);
+
+   writer.setCompression(TREE_DEFLATE, 6);
+   timer.start();
+   writer.write(packedFile, pointers);
+   report("TreeWriter deflate(6)", timer.nsecsElapsed() / 1e9, packedFile, count);
+
+   printf("\n");
+   TreeReader reader;
+   struct { const char *name; QString file; bool photos; } reads[] = {
+      { "TreeReader save_pure", pureFile, false },
+      { "TreeReader plain", plainFile, true },
+      { "TreeReader deflate(6)", packedFile, true }
+   };
+   for (const auto &read : reads)
+   {
+      std::vector<Person> loaded;
+      timer.start();
+      reader.read(read.file, loaded);
+      report(read.name, timer.nsecsElapsed() / 1e9, read.file, count);
+      bool same = (loaded.size() == persons.size()) && (checksum(loaded, read.photos) == checksum(persons, read.photos));
+      printf("%-24s %s\n", "", same ? "round trip ok" : "ROUND TRIP MISMATCH");
+   }
+
+   QFile::remove(pureFile);
+   QFile::remove(plainFile);
+   QFile::remove(packedFile);
+   return 0;
+}
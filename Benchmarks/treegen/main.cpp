@@ -0,0 +1,149 @@
+/*
+ * Синтетическое дерево для замеров, одно и то же при одинаковых параметрах:
+ *    treegen <db|snapshot|tree|gedcom> <файл> [людей] [параметр=значение ...]
+ * Параметры - поля TreeGeneratorOptions: seed, generations, founders, children, marriage,
+ * remarriage, collapse, foreign, photos, photoSize, notes, firstYear. Для db ещё table (таблица,
+ * по умолчанию T_GEN), для tree - deflate (уровень сжатия, 0 - без сжатия).
+ * В базу и в GEDCOM люди пишутся потоком; снимок и файл дерева строятся из Person в памяти.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QElapsedTimer>
+
+#include "treegenerator.h"
+#include "treesnapshot.h"
+#include "treewriter.h"
+#include "db.h"
+
+static int usage()
+{
+   printf("treegen <db|snapshot|tree|gedcom> <file> [persons] [option=value ...]\n");
+   return -1;
+}
+
+static bool setOption(TreeGeneratorOptions &options, const std::string &key, const char *value)
+{
+   if (key == "seed")
+      options.seed = strtoull(value, nullptr, 10);
+   else if (key == "generations")
+      options.generations = atoi(value);
+   else if (key == "founders")
+      options.founders = atoi(value);
+   else if (key == "children")
+      options.children = atof(value);
+   else if (key == "marriage")
+      options.marriage = atof(value);
+   else if (key == "remarriage")
+      options.remarriage = atof(value);
+   else if (key == "collapse")
+      options.collapse = atof(value);
+   else if (key == "foreign")
+      options.foreign = atof(value);
+   else if (key == "photos")
+      options.photos = atof(value);
+   else if (key == "photoSize")
+      options.photoSize = atoi(value);
+   else if (key == "notes")
+      options.notes = atof(value);
+   else if (key == "firstYear")
+      options.firstYear = atoi(value);
+   else
+      return false;
+   return true;
+}
+
+static int writeDB(const TreeGenerator &generator, const QString &fileName, const std::string &tableName)
+{
+   QFile::remove(fileName);
+   DB db(fileName.toLocal8Bit().constData());
+   if (db.openDB() || db.checkDB() || db.createTables() || db.createRoot("treegen", tableName))
+   {
+      printf("Could not prepare %s\n", fileName.toLocal8Bit().constData());
+      return -1;
+   }
+   int ret = generator.writeDB(db, tableName);
+   db.closeDB();
+   return ret;
+}
+
+static int writeInMemory(const TreeGenerator &generator, const QString &format, const QString &fileName, int deflate)
+{
+   std::vector<Person> persons;
+   generator.makePersons(persons);
+   QVector<Person*> pointers;
+   pointers.reserve(static_cast<int>(persons.size()));
+   for (Person &pers : persons)
+      pointers.append(&pers);
+
+   if (format == "snapshot")
+      return TreeSnapshot::write(fileName, pointers);
+
+   TreeWriter writer;
+   if (deflate > 0)
+      writer.setCompression(TREE_DEFLATE, deflate);
+   return writer.write(fileName, pointers);
+}
+
+int main(int argc, char *argv[])
+{
+   if (argc < 3)
+      return usage();
+   QString format = argv[1];
+   QString fileName = argv[2];
+   if ((format != "db") && (format != "snapshot") && (format != "tree") && (format != "gedcom"))
+      return usage();
+
+   TreeGeneratorOptions options;
+   std::string tableName = "T_GEN";
+   int deflate = 0;
+   for (int i = 3; i < argc; i++)
+   {
+      const char *eq = strchr(argv[i], '=');
+      if (!eq)
+      {
+         options.persons = atoi(argv[i]);
+         continue;
+      }
+      std::string key(argv[i], eq - argv[i]);
+      if (key == "table")
+         tableName = eq + 1;
+      else if (key == "deflate")
+         deflate = atoi(eq + 1);
+      else if (!setOption(options, key, eq + 1))
+      {
+         printf("Unknown option %s\n", key.c_str());
+         return usage();
+      }
+   }
+
+   QElapsedTimer timer;
+   timer.start();
+   TreeGenerator generator(options);
+   printf("%d persons generated in %.2f s\n", generator.size(), timer.nsecsElapsed() / 1e9);
+
+   timer.start();
+   int ret;
+   if (format == "db")
+      ret = writeDB(generator, fileName, tableName);
+   else if (format == "gedcom")
+      ret = generator.writeGedcom(fileName);
+   else
+      ret = writeInMemory(generator, format, fileName, deflate);
+   double seconds = timer.nsecsElapsed() / 1e9;
+
+   if (ret)
+   {
+      printf("Could not write %s\n", fileName.toLocal8Bit().constData());
+      return -1;
+   }
+   printf("%s: %.1f MB in %.2f s\n", fileName.toLocal8Bit().constData(),
+          QFileInfo(fileName).size() / (1024.0 * 1024.0), seconds);
+   return 0;
+}
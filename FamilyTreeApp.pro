@@ -0,0 +1,49 @@
+#-------------------------------------------------
+#
+# Project created by QtCreator 2019-03-02T20:03:32
+#
+# Qt GUI on top of FamilyTreeCore: only the widget, rendering and export code lives here
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent svg
+
+TARGET = FamilyTree_ver2
+TEMPLATE = app
+
+# The following define makes your compiler emit warnings if you use
+# any feature of Qt which has been marked as deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# You can also make your code fail to compile if you use deprecated APIs.
+# In order to do so, uncomment the following line.
+# You can also select to disable deprecated APIs only up to a certain version of Qt.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+CONFIG += c++11
+
+SOURCES += \
+        main.cpp \
+        Source/familytreewidget.cpp \
+    Source/treerenderer.cpp \
+    Source/tilecache.cpp \
+    Source/posterexporter.cpp \
+    Source/thumbnailcache.cpp
+
+HEADERS += \
+        Source/familytreewidget.h \
+    Source/treerenderer.h \
+    Source/tilecache.h \
+    Source/posterexporter.h \
+    Source/thumbnailcache.h
+
+include(FamilyTreeCore.pri)
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
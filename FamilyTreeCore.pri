@@ -0,0 +1,34 @@
+#-------------------------------------------------
+#
+# Links FamilyTreeCore into a project built in the same build directory
+# (the subdirs project FamilyTree_ver2.pro builds both there).
+# A project built elsewhere sets FAMILYTREE_CORE_DIR to the library's build directory.
+#
+#-------------------------------------------------
+
+isEmpty(FAMILYTREE_CORE_DIR): FAMILYTREE_CORE_DIR = $$OUT_PWD
+
+QT       += concurrent
+
+INCLUDEPATH += $$PWD/Source
+INCLUDEPATH += $$PWD/Source/DB_src
+INCLUDEPATH += $$PWD/Source/DB_src/sqlite3
+DEPENDPATH += $$PWD/Source
+DEPENDPATH += $$PWD/Source/DB_src
+
+# Заголовки ядра собираются по-разному без DATABASE
+DEFINES += DATABASE
+
+win32:CONFIG(release, debug|release): LIBS += -L$$FAMILYTREE_CORE_DIR/release/ -lFamilyTreeCore
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$FAMILYTREE_CORE_DIR/debug/ -lFamilyTreeCore
+else:unix: LIBS += -L$$FAMILYTREE_CORE_DIR/ -lFamilyTreeCore
+
+win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$FAMILYTREE_CORE_DIR/release/libFamilyTreeCore.a
+else:win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$FAMILYTREE_CORE_DIR/debug/libFamilyTreeCore.a
+else:win32:!win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$FAMILYTREE_CORE_DIR/release/FamilyTreeCore.lib
+else:win32:!win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$FAMILYTREE_CORE_DIR/debug/FamilyTreeCore.lib
+else:unix: PRE_TARGETDEPS += $$FAMILYTREE_CORE_DIR/libFamilyTreeCore.a
+
+# zlib for compressed tree files and the poster PNG encoder: Windows builds of Qt ship it inside QtCore
+win32: INCLUDEPATH += $$[QT_INSTALL_HEADERS]/QtZlib
+else: LIBS += -lz
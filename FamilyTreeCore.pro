@@ -0,0 +1,79 @@
+#-------------------------------------------------
+#
+# Headless core: DB, Person model, graph algorithms and file I/O.
+# Static library on QtCore (and QtConcurrent, which needs only QtCore),
+# for the GUI app, benchmarks, command line tools and batch jobs.
+# Consumers link it through FamilyTreeCore.pri.
+#
+#-------------------------------------------------
+
+QT       = core concurrent
+
+TARGET = FamilyTreeCore
+TEMPLATE = lib
+
+CONFIG += c++11 staticlib
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+    Source/DB_src/db.cpp \
+    Source/DB_src/componentindex.cpp \
+    Source/DB_src/duplicatefinder.cpp \
+    Source/DB_src/persontablemodel.cpp \
+    Source/DB_src/gedcomimporter.cpp \
+    Source/DB_src/gedcomexporter.cpp \
+    Source/DB_src/sqlite3/sqlite3.c \
+    Source/person.cpp \
+    Source/writelog.cpp \
+    Source/treegraph.cpp \
+    Source/treelayout.cpp \
+    Source/spatialindex.cpp \
+    Source/treescene.cpp \
+    Source/connectorrouter.cpp \
+    Source/treesnapshot.cpp \
+    Source/treewriter.cpp \
+    Source/changetracker.cpp \
+    Source/phonetickey.cpp \
+    Source/namematcher.cpp \
+    Source/collationkey.cpp \
+    Source/treestatistics.cpp \
+    Source/editlog.cpp \
+    Source/treegenerator.cpp \
+    Source/gedcomparser.cpp
+
+HEADERS += \
+    Source/DB_src/db.h \
+    Source/DB_src/componentindex.h \
+    Source/DB_src/duplicatefinder.h \
+    Source/DB_src/persontablemodel.h \
+    Source/DB_src/gedcomimporter.h \
+    Source/DB_src/gedcomexporter.h \
+    Source/DB_src/sqlite3/sqlite3.h \
+    Source/person.h \
+    Source/writelog.h \
+    Source/treegraph.h \
+    Source/treelayout.h \
+    Source/spatialindex.h \
+    Source/treescene.h \
+    Source/connectorrouter.h \
+    Source/treesnapshot.h \
+    Source/treewriter.h \
+    Source/changetracker.h \
+    Source/phonetickey.h \
+    Source/namematcher.h \
+    Source/collationkey.h \
+    Source/treestatistics.h \
+    Source/editlog.h \
+    Source/treegenerator.h \
+    Source/gedcomparser.h
+
+INCLUDEPATH += Source
+INCLUDEPATH += Source/DB_src
+INCLUDEPATH += Source/DB_src/sqlite3
+
+# zlib for compressed tree files: Windows builds of Qt ship it inside QtCore
+win32: INCLUDEPATH += $$[QT_INSTALL_HEADERS]/QtZlib
+
+DEFINES += DATABASE
+DEFINES +="DEBUG_LOG=true"
@@ -2,51 +2,17 @@
 #
 # Project created by QtCreator 2019-03-02T20:03:32
 #
+# core - FamilyTreeCore.pro, static library on QtCore only: DB, Person model,
+#        graph and layout algorithms, file and GEDCOM I/O
+# app  - FamilyTreeApp.pro, the Qt GUI linked against it
+# Headless tools link the core through FamilyTreeCore.pri.
+#
 #-------------------------------------------------
 
-QT       += core gui
-
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
-
-TARGET = FamilyTree_ver2
-TEMPLATE = app
-
-# The following define makes your compiler emit warnings if you use
-# any feature of Qt which has been marked as deprecated (the exact warnings
-# depend on your compiler). Please consult the documentation of the
-# deprecated API in order to know how to port your code away from it.
-DEFINES += QT_DEPRECATED_WARNINGS
-
-# You can also make your code fail to compile if you use deprecated APIs.
-# In order to do so, uncomment the following line.
-# You can also select to disable deprecated APIs only up to a certain version of Qt.
-#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
-
-CONFIG += c++11
-
-SOURCES += \
-        main.cpp \
-        Source/familytreewidget.cpp \
-    Source/DB_src/db.cpp \
-    Source/DB_src/sqlite3/sqlite3.c \
-    Source/person.cpp \
-    Source/writelog.cpp
-
-HEADERS += \
-        Source/familytreewidget.h \
-    Source/DB_src/db.h \
-    Source/DB_src/sqlite3/sqlite3.h \
-    Source/person.h \
-    Source/writelog.h
-
-INCLUDEPATH += Source
-INCLUDEPATH += Source/DB_src
-INCLUDEPATH += Source/DB_src/sqlite3
+TEMPLATE = subdirs
 
-DEFINES += DATABASE
-DEFINES +="DEBUG_LOG=true"
+SUBDIRS = core app
 
-# Default rules for deployment.
-qnx: target.path = /tmp/$${TARGET}/bin
-else: unix:!android: target.path = /opt/$${TARGET}/bin
-!isEmpty(target.path): INSTALLS += target
+core.file = FamilyTreeCore.pro
+app.file = FamilyTreeApp.pro
+app.depends = core
@@ -0,0 +1,247 @@
+#ifdef DATABASE
+
+#include "componentindex.h"
+
+#include <QDate>
+
+#include "writelog.h"
+
+ComponentIndex::ComponentIndex()
+{
+
+}
+
+void ComponentIndex::clear()
+{
+   _parent.clear();
+   _size.clear();
+   _tables.clear();
+   _tableNodes.clear();
+   _personNodes.clear();
+   _personTables.clear();
+   _componentIds.clear();
+   _componentTables.clear();
+}
+
+std::string ComponentIndex::identityKey(const std::string &name, const std::string &birthDate)
+{
+   // ID назначается в рамках одного сеанса (Person::global_id) и не уникален между деревьями,
+   // поэтому человек опознаётся по ФИО и дате рождения. Без даты тёзки неотличимы - такой человек
+   // не опознаётся вовсе, иначе одно распространённое имя склеило бы чужие деревья
+   if (birthDate.empty() || !QDate::fromString(QString::fromStdString(birthDate), "dd.MM.yyyy").isValid())
+      return std::string();
+   return name + '\x1f' + birthDate;
+}
+
+int ComponentIndex::addNode()
+{
+   _parent.push_back(static_cast<int>(_parent.size()));
+   _size.push_back(1);
+   return _parent.back();
+}
+
+int ComponentIndex::findRoot(int node) const
+{
+   while (_parent[node] != node)
+   {
+      _parent[node] = _parent[_parent[node]];
+      node = _parent[node];
+   }
+   return node;
+}
+
+void ComponentIndex::unite(int a, int b)
+{
+   a = findRoot(a);
+   b = findRoot(b);
+   if (a == b)
+      return;
+   if (_size[a] < _size[b])
+      std::swap(a, b);
+   _parent[b] = a;
+   _size[a] += _size[b];
+}
+
+int ComponentIndex::build(DB &db)
+{
+   clear();
+
+   std::vector<std::string> roots;
+   int ret = db.getListOfRoots(roots, _tables);
+   if (ret)
+   {
+      writeDebugLog("ComponentIndex::build Failed to get list of roots");
+      return ret;
+   }
+
+   for (size_t t = 0; t < _tables.size(); t++)
+   {
+      addNode();
+      _tableNodes[_tables[t]] = static_cast<int>(t);
+   }
+
+   std::vector<PersonKey> keys;
+   for (size_t t = 0; t < _tables.size(); t++)
+   {
+      ret = db.getPersonKeys(_tables[t], keys);
+      if (ret)
+      {
+         writeDebugLog(QString("ComponentIndex::build Failed to read ") + _tables[t].c_str());
+         clear();
+         return ret;
+      }
+
+      for (const PersonKey &key : keys)
+      {
+         std::string identity = identityKey(key.name, key.birthDate);
+         if (identity.empty())
+            continue;
+
+         auto it = _personNodes.emplace(identity, 0);
+         if (it.second)
+         {
+            it.first->second = addNode();
+            _personTables.emplace_back();
+         }
+
+         int node = it.first->second;
+         std::vector<int> &tables = _personTables[node - _tables.size()];
+         if (tables.empty() || tables.back() != static_cast<int>(t))
+            tables.push_back(static_cast<int>(t));
+
+         unite(static_cast<int>(t), node);
+      }
+   }
+
+   for (size_t t = 0; t < _tables.size(); t++)
+   {
+      int root = findRoot(static_cast<int>(t));
+      auto it = _componentIds.emplace(root, static_cast<int>(_componentTables.size()));
+      if (it.second)
+         _componentTables.emplace_back();
+      _componentTables[it.first->second].push_back(static_cast<int>(t));
+   }
+
+   writeDebugLog(QString("ComponentIndex::build ") + QString::number(_tables.size()) + " tables, "
+                 + QString::number(_componentTables.size()) + " components");
+   return 0;
+}
+
+int ComponentIndex::componentCount() const
+{
+   return static_cast<int>(_componentTables.size());
+}
+
+int ComponentIndex::componentOfTable(const std::string &tableName) const
+{
+   auto it = _tableNodes.find(tableName);
+   if (it == _tableNodes.end())
+      return -1;
+   return _componentIds.at(findRoot(it->second));
+}
+
+int ComponentIndex::componentOfPerson(const std::string &name, const std::string &birthDate) const
+{
+   auto it = _personNodes.find(identityKey(name, birthDate));
+   if (it == _personNodes.end())
+      return -1;
+   return _componentIds.at(findRoot(it->second));
+}
+
+std::vector<std::string> ComponentIndex::componentTables(int component) const
+{
+   std::vector<std::string> tables;
+   if ((component < 0) || (component >= componentCount()))
+      return tables;
+
+   for (int t : _componentTables[component])
+      tables.push_back(_tables[t]);
+   return tables;
+}
+
+std::vector<std::string> ComponentIndex::tablesOfPerson(const std::string &name, const std::string &birthDate) const
+{
+   std::vector<std::string> tables;
+   auto it = _personNodes.find(identityKey(name, birthDate));
+   if (it == _personNodes.end())
+      return tables;
+
+   for (int t : _personTables[it->second - _tables.size()])
+      tables.push_back(_tables[t]);
+   return tables;
+}
+
+std::vector<std::string> ComponentIndex::connectedTables(const std::string &name, const std::string &birthDate) const
+{
+   return componentTables(componentOfPerson(name, birthDate));
+}
+
+int ComponentIndex::loadComponent(DB &db, int component, std::vector<Person> &persList) const
+{
+   persList.clear();
+
+   std::vector<std::string> tables = componentTables(component);
+   if (tables.empty())
+      return -1;
+
+   std::vector<std::vector<Person>> parts(tables.size());
+   size_t total = 0;
+   for (size_t i = 0; i < tables.size(); i++)
+   {
+      int ret = db.getListOfPersons(tables[i], parts[i]);
+      if (ret)
+         return ret;
+      total += parts[i].size();
+   }
+
+   // Люди, встречающиеся в нескольких деревьях, сливаются в одну запись
+   std::unordered_map<std::string, size_t> seen;
+   std::unordered_map<const Person*, size_t> remap;
+   seen.reserve(total);
+   remap.reserve(total);
+   persList.reserve(total);
+
+   for (const std::vector<Person> &part : parts)
+   {
+      for (const Person &pers : part)
+      {
+         std::string key = identityKey(pers.name.toStdString(), pers.birthDate.toString("dd.MM.yyyy").toStdString());
+         size_t index = persList.size();
+         if (!key.empty())
+         {
+            auto it = seen.emplace(key, index);
+            index = it.first->second;
+         }
+         if (index == persList.size())
+         {
+            persList.push_back(pers);
+            persList.back().father = nullptr;
+            persList.back().mother = nullptr;
+            persList.back().children.clear();
+         }
+         remap[&pers] = index;
+      }
+   }
+
+   for (const std::vector<Person> &part : parts)
+   {
+      for (const Person &pers : part)
+      {
+         Person &dst = persList[remap[&pers]];
+         if (pers.father && !dst.father)
+            dst.father = &persList[remap[pers.father]];
+         if (pers.mother && !dst.mother)
+            dst.mother = &persList[remap[pers.mother]];
+         for (const Person *child : pers.children)
+         {
+            Person *merged = &persList[remap[child]];
+            if (!dst.children.contains(merged))
+               dst.children.append(merged);
+         }
+      }
+   }
+
+   return 0;
+}
+
+#endif
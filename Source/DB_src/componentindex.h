@@ -0,0 +1,54 @@
+/*
+ * Индекс связных компонент по всем деревьям из ROOTTABLE.
+ * Один и тот же человек может входить в несколько деревьев (браки между семьями),
+ * такие деревья объединяются через систему непересекающихся множеств (union-find).
+ */
+
+#ifdef DATABASE
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "db.h"
+
+class ComponentIndex
+{
+public:
+   ComponentIndex();
+
+   int build(DB &db);
+   void clear();
+
+   int componentCount() const;
+   int componentOfTable(const std::string &tableName) const;
+   int componentOfPerson(const std::string &name, const std::string &birthDate) const;
+
+   std::vector<std::string> componentTables(int component) const;
+   std::vector<std::string> tablesOfPerson(const std::string &name, const std::string &birthDate) const;
+   std::vector<std::string> connectedTables(const std::string &name, const std::string &birthDate) const;
+
+   int loadComponent(DB &db, int component, std::vector<Person> &persList) const;
+
+   // Пустая строка - без даты рождения человек не опознаётся и деревья не связывает
+   static std::string identityKey(const std::string &name, const std::string &birthDate);
+
+private:
+   int addNode();
+   int findRoot(int node) const;
+   void unite(int a, int b);
+
+   mutable std::vector<int> _parent;
+   std::vector<int> _size;
+
+   std::vector<std::string> _tables;                        // узлы 0.._tables.size()-1
+   std::unordered_map<std::string, int> _tableNodes;
+   std::unordered_map<std::string, int> _personNodes;       // identityKey -> узел
+   std::vector<std::vector<int>> _personTables;             // узел - _tables.size() -> индексы таблиц
+   std::unordered_map<int, int> _componentIds;              // корень -> номер компоненты
+   std::vector<std::vector<int>> _componentTables;
+};
+
+#endif
@@ -8,11 +8,34 @@
 #include <sys/stat.h>
 #include <cerrno>
 #include <cstdlib>
+#include <unordered_map>
+#include <algorithm>
+
+#include <QStringList>
 
 #include <sqlite3.h>
 #include <db.h>
 
 #include "writelog.h"
+#include "phonetickey.h"
+#include "namematcher.h"
+#include "collationkey.h"
+
+// PHONETIC_KEY(NAME) для INSERT и для заполнения старых таблиц
+static void phoneticKeyFunction(sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+   const unsigned char *name = (argc == 1) ? sqlite3_value_text(argv[0]) : nullptr;
+   std::string key = name ? PhoneticKey::ofName(reinterpret_cast<const char*>(name)) : std::string();
+   sqlite3_result_text(context, key.c_str(), static_cast<int>(key.size()), SQLITE_TRANSIENT);
+}
+
+// COLLATION_KEY(NAME) и COLLATION_KEY(BIRTHPLACE) - ключи сортировки NAMEKEY и PLACEKEY
+static void collationKeyFunction(sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+   const unsigned char *text = (argc == 1) ? sqlite3_value_text(argv[0]) : nullptr;
+   std::string key = text ? CollationKey::of(std::string(reinterpret_cast<const char*>(text))) : std::string();
+   sqlite3_result_blob(context, key.data(), static_cast<int>(key.size()), SQLITE_TRANSIENT);
+}
 
 DB::DB(const char *dbpath)
    : _dbPath(dbpath),
@@ -89,12 +112,18 @@ int DB::endTransaction(sqlite3 *db)
    return sqlite3_exec(db, "END TRANSACTION;", nullptr, nullptr, nullptr); // == COMMIT
 }
 
+int DB::rollbackTransaction(sqlite3 *db)
+{
+   return sqlite3_exec(db, "ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
+}
+
 void DB::setDBPath(const char *dbpath)
 {
    _dbPath = dbpath;
+   _preparedTables.clear();
 }
 
-int DB::openDB()
+int DB::openDB(bool readOnly)
 {
    int ret;
 
@@ -105,8 +134,7 @@ int DB::openDB()
    }
 
    ret = sqlite3_open_v2(_dbPath.c_str(), &_db,
-                              SQLITE_OPEN_READWRITE |
-                              SQLITE_OPEN_CREATE |
+                              (readOnly ? SQLITE_OPEN_READONLY : (SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE)) |
                               SQLITE_OPEN_MAIN_DB,
                               nullptr );
 
@@ -120,6 +148,13 @@ int DB::openDB()
         return -1;
    }
    _bOpened = true;
+   _preparedTables.clear();
+   if (readOnly)
+      sqlite3_busy_timeout(_db, READER_BUSY_TIMEOUT);
+   sqlite3_create_function_v2(_db, "PHONETIC_KEY", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+                              phoneticKeyFunction, nullptr, nullptr, nullptr);
+   sqlite3_create_function_v2(_db, "COLLATION_KEY", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+                              collationKeyFunction, nullptr, nullptr, nullptr);
    return 0;
 }
 
@@ -163,10 +198,10 @@ int DB::createRoot(std::string rootName, std::string tableName)
 {
    writeDebugLog(QString("Create logTable: ") + tableName.c_str());
    int ret;
-   char request[1224] = { 0 };
+   char request[2048] = { 0 };   // с запасом под INSERT_ROOT_TABLE_FORMAT
    sqlite3_stmt *_pStmt;
 
-   snprintf(request, 1224, "INSERT INTO ROOTTABLE (NAME,TABLENAME) VALUES(?, ?)");
+   snprintf(request, sizeof(request), "INSERT INTO ROOTTABLE (NAME,TABLENAME) VALUES(?, ?)");
 
    ret = sqlite3_prepare(_db, request, -1, &_pStmt, nullptr);
 
@@ -197,9 +232,9 @@ int DB::createRoot(std::string rootName, std::string tableName)
          ret = 0;
 }
    _pStmt = 0;
-   memset(request, 0, 1224);
+   memset(request, 0, sizeof(request));
 
-   snprintf(request, 1224, INSERT_ROOT_TABLE_FORMAT, tableName.c_str());
+   snprintf(request, sizeof(request), INSERT_ROOT_TABLE_FORMAT, tableName.c_str());
 
    ret = sqlite3_prepare(_db, request, -1, &_pStmt, nullptr);
 
@@ -224,7 +259,97 @@ int DB::createRoot(std::string rootName, std::string tableName)
         return ret;
    }
 
-   return ret;
+   return prepareTable(tableName);
+}
+
+int DB::removeRoot(std::string tableName)
+{
+   writeDebugLog(QString("Remove logTable: ") + tableName.c_str());
+
+   sqlite3_stmt *_pStmt;
+   int ret = sqlite3_prepare_v2(_db, "DELETE FROM ROOTTABLE WHERE TABLENAME = ?", -1, &_pStmt, nullptr);
+
+   if (ret != SQLITE_OK)
+   {
+      databaseError();
+      return ret;
+   }
+
+   dbTransactor trans(this,_pStmt);
+
+   sqlite3_bind_text(_pStmt, 1, tableName.c_str(), -1, SQLITE_STATIC);
+   ret = sqlite3_step(_pStmt);
+   sqlite3_reset(_pStmt);
+   if (ret == SQLITE_DONE)
+   {
+      // Индексы таблицы удаляются вместе с ней
+      std::string request = "DROP TABLE IF EXISTS `" + tableName + "`";
+      ret = sqlite3_exec(_db, request.c_str(), nullptr, nullptr, nullptr);
+   }
+
+   if (ret != SQLITE_OK)
+   {
+      databaseError();
+      trans.rollback();
+      return ret;
+   }
+
+   _preparedTables.erase(tableName);
+   return 0;
+}
+
+int DB::prepareTable(const std::string &tableName)
+{
+   if (_preparedTables.count(tableName))
+      return 0;
+
+   // Вычисляемые столбцы появились позже: в старых таблицах они добавляются и заполняются
+   static const struct
+   {
+      const char *name;
+      const char *definition;
+      const char *value;
+   } DERIVED_COLUMNS[] = {
+      { "PHONETIC", "TEXT NOT NULL DEFAULT ''", "PHONETIC_KEY(NAME)" },
+      { "NAMEKEY", "BLOB NOT NULL DEFAULT X''", "COLLATION_KEY(NAME)" },
+      { "PLACEKEY", "BLOB NOT NULL DEFAULT X''", "COLLATION_KEY(BIRTHPLACE)" }
+   };
+
+   std::string request = "PRAGMA table_info(`" + tableName + "`)";
+   sqlite3_stmt *stmt = nullptr;
+   int ret = sqlite3_prepare_v2(_db, request.c_str(), -1, &stmt, nullptr);
+   if (ret != SQLITE_OK)
+   {
+      databaseError();
+      return ret;
+   }
+   std::unordered_set<std::string> columns;
+   while (sqlite3_step(stmt) == SQLITE_ROW)
+      columns.insert(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+   finalizeSTMT(stmt);
+
+   request.clear();
+   for (const auto &column : DERIVED_COLUMNS)
+   {
+      if (columns.count(column.name))
+         continue;
+      writeDebugLog(QString("DB::prepareTable Adding ") + column.name + " to " + tableName.c_str());
+      request += "ALTER TABLE `" + tableName + "` ADD COLUMN `" + column.name + "` " + column.definition + ";";
+      request += "UPDATE `" + tableName + "` SET " + column.name + " = " + column.value + ";";
+   }
+
+   // Точечные UPDATE/DELETE по ID и поиск "звучит похоже" без индексов просматривали бы всю таблицу
+   request += "CREATE INDEX IF NOT EXISTS `" + tableName + "_ID` ON `" + tableName + "` (ID);";
+   request += "CREATE INDEX IF NOT EXISTS `" + tableName + "_PHONETIC` ON `" + tableName + "` (PHONETIC);";
+
+   ret = sqlite3_exec(_db, request.c_str(), nullptr, nullptr, nullptr);
+   if (ret != SQLITE_OK)
+   {
+      databaseError();
+      return ret;
+   }
+   _preparedTables.insert(tableName);
+   return 0;
 }
 
 int DB::addPerson(std::string tableName, uint32_t id, std::string name, std::string birthDate,
@@ -241,13 +366,16 @@ int DB::addPerson(std::string tableName, uint32_t id, std::string name, std::str
       return -1;
    }
 
-   int ret;
+   int ret = prepareTable(tableName);
+   if (ret)
+      return ret;
    sqlite3_stmt *_pStmt;
 
    std::string request = "INSERT INTO ";
    request += tableName;
    request += " (ID, NAME, DATEOFBIRTH, ISALIVE, DATEOFDEATH, INFO, BIRTHPLACE, PHOTO, SEX, FATHERID,\
- MOTHERID, CHILDRENCNT, CHILDRENID) VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+ MOTHERID, CHILDRENCNT, CHILDRENID, PHONETIC, NAMEKEY, PLACEKEY) VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?,\
+ PHONETIC_KEY(?2), COLLATION_KEY(?2), COLLATION_KEY(?7))";
 
    ret = sqlite3_prepare(_db, request.c_str(), -1, &_pStmt, nullptr);
 
@@ -297,6 +425,215 @@ int DB::addPerson(std::string tableName, uint32_t id, std::string name, std::str
    return ret;
 }
 
+int DB::addPersons(std::string tableName, const std::vector<PersonRow> &rows)
+{
+   if (tableName.empty())
+      return -1;
+   if (rows.empty())
+      return 0;
+   if (prepareTable(tableName))
+      return -1;
+
+   std::string request = "INSERT INTO ";
+   request += tableName;
+   request += " (ID, NAME, DATEOFBIRTH, ISALIVE, DATEOFDEATH, INFO, BIRTHPLACE, PHOTO, SEX, FATHERID,\
+ MOTHERID, CHILDRENCNT, CHILDRENID, PHONETIC, NAMEKEY, PLACEKEY) VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?,\
+ PHONETIC_KEY(?2), COLLATION_KEY(?2), COLLATION_KEY(?7))";
+
+   sqlite3_stmt *_pStmt;
+   int ret = sqlite3_prepare_v2(_db, request.c_str(), -1, &_pStmt, nullptr);
+
+   if (ret != SQLITE_OK)
+   {
+      databaseError();
+      return ret;
+   }
+
+   // Один подготовленный запрос и одна транзакция на всю пачку вместо транзакции на строку
+   dbTransactor trans(this,_pStmt);
+
+   for (const PersonRow &row : rows)
+   {
+      bindPersonRow(_pStmt, row);
+      ret = sqlite3_step(_pStmt);
+      sqlite3_reset(_pStmt);
+      if (ret != SQLITE_DONE)
+      {
+         databaseError();
+         trans.rollback();
+         return ret;
+      }
+   }
+
+   return 0;
+}
+
+void DB::bindPersonRow(sqlite3_stmt *stmt, const PersonRow &row)
+{
+   sqlite3_bind_int(stmt, 1, row.id);
+   sqlite3_bind_text(stmt, 2, row.name.c_str(), -1, SQLITE_STATIC);
+   sqlite3_bind_text(stmt, 3, row.birthDate.c_str(), -1, SQLITE_STATIC);
+   sqlite3_bind_text(stmt, 4, row.isAlive.c_str(), -1, SQLITE_STATIC);
+   sqlite3_bind_text(stmt, 5, row.deathDate.c_str(), -1, SQLITE_STATIC);
+   sqlite3_bind_text(stmt, 6, row.info.c_str(), -1, SQLITE_STATIC);
+   sqlite3_bind_text(stmt, 7, row.birthPlace.c_str(), -1, SQLITE_STATIC);
+   sqlite3_bind_text(stmt, 8, row.photo.c_str(), -1, SQLITE_STATIC);
+   sqlite3_bind_text(stmt, 9, row.sex.c_str(), -1, SQLITE_STATIC);
+   sqlite3_bind_int(stmt, 10, row.fatherId);
+   sqlite3_bind_int(stmt, 11, row.motherId);
+   sqlite3_bind_int(stmt, 12, row.childrenCnt);
+   sqlite3_bind_text(stmt, 13, row.childrenID.c_str(), -1, SQLITE_STATIC);
+}
+
+// Столбцы таблицы для каждого поля PersonField
+static const struct
+{
+   unsigned field;
+   const char *columns;
+} PERSON_COLUMNS[] = {
+   { FIELD_NAME, "NAME = ?, PHONETIC = PHONETIC_KEY(?), NAMEKEY = COLLATION_KEY(?)" },
+   { FIELD_BIRTH_DATE, "DATEOFBIRTH = ?" },
+   { FIELD_DEATH, "ISALIVE = ?, DATEOFDEATH = ?" },
+   { FIELD_INFO, "INFO = ?" },
+   { FIELD_BIRTH_PLACE, "BIRTHPLACE = ?, PLACEKEY = COLLATION_KEY(?)" },
+   { FIELD_PHOTO, "PHOTO = ?" },
+   { FIELD_SEX, "SEX = ?" },
+   { FIELD_PARENTS, "FATHERID = ?, MOTHERID = ?" },
+   { FIELD_CHILDREN, "CHILDRENCNT = ?, CHILDRENID = ?" }
+};
+
+int DB::savePersonDelta(std::string tableName, const PersonDelta &delta)
+{
+   if (tableName.empty() || (delta.changed.size() != delta.changedFields.size()))
+      return -1;
+   if (delta.added.empty() && delta.changed.empty() && delta.removed.empty())
+      return 0;
+
+   int ret = prepareTable(tableName);
+   if (ret != SQLITE_OK)
+      return ret;
+
+   // Подготовленные запросы: вставка, удаление и по одному UPDATE на каждый набор полей
+   sqlite3_stmt *insertStmt = nullptr;
+   sqlite3_stmt *deleteStmt = nullptr;
+   std::unordered_map<unsigned, sqlite3_stmt*> updateStmts;
+
+   beginTransaction(_db);
+
+   if (!delta.removed.empty())
+   {
+      std::string request = "DELETE FROM " + tableName + " WHERE ID = ?";
+      ret = sqlite3_prepare_v2(_db, request.c_str(), -1, &deleteStmt, nullptr);
+      for (size_t i = 0; (ret == SQLITE_OK) && (i < delta.removed.size()); i++)
+      {
+         sqlite3_bind_int(deleteStmt, 1, delta.removed[i]);
+         ret = sqlite3_step(deleteStmt);
+         sqlite3_reset(deleteStmt);
+         if (ret == SQLITE_DONE)
+            ret = SQLITE_OK;
+      }
+   }
+
+   if ((ret == SQLITE_OK) && !delta.added.empty())
+   {
+      std::string request = "INSERT INTO " + tableName + " (ID, NAME, DATEOFBIRTH, ISALIVE, DATEOFDEATH, INFO, BIRTHPLACE,\
+ PHOTO, SEX, FATHERID, MOTHERID, CHILDRENCNT, CHILDRENID, PHONETIC, NAMEKEY, PLACEKEY) VALUES(?, ?, ?, ?, ?, ?, ?, ?,\
+ ?, ?, ?, ?, ?, PHONETIC_KEY(?2), COLLATION_KEY(?2), COLLATION_KEY(?7))";
+      ret = sqlite3_prepare_v2(_db, request.c_str(), -1, &insertStmt, nullptr);
+      for (size_t i = 0; (ret == SQLITE_OK) && (i < delta.added.size()); i++)
+      {
+         bindPersonRow(insertStmt, delta.added[i]);
+         ret = sqlite3_step(insertStmt);
+         sqlite3_reset(insertStmt);
+         if (ret == SQLITE_DONE)
+            ret = SQLITE_OK;
+      }
+   }
+
+   for (size_t i = 0; (ret == SQLITE_OK) && (i < delta.changed.size()); i++)
+   {
+      const PersonRow &row = delta.changed[i];
+      unsigned fields = delta.changedFields[i] & FIELD_ALL;
+      if (!fields)
+         continue;
+
+      sqlite3_stmt *&stmt = updateStmts[fields];
+      if (!stmt)
+      {
+         std::string request = "UPDATE " + tableName + " SET ";
+         bool first = true;
+         for (const auto &column : PERSON_COLUMNS)
+         {
+            if (!(fields & column.field))
+               continue;
+            if (!first)
+               request += ", ";
+            request += column.columns;
+            first = false;
+         }
+         request += " WHERE ID = ?";
+         ret = sqlite3_prepare_v2(_db, request.c_str(), -1, &stmt, nullptr);
+         if (ret != SQLITE_OK)
+            break;
+      }
+
+      int n = 1;
+      if (fields & FIELD_NAME)
+         for (int i = 0; i < 3; i++)
+            sqlite3_bind_text(stmt, n++, row.name.c_str(), -1, SQLITE_STATIC);
+      if (fields & FIELD_BIRTH_DATE)
+         sqlite3_bind_text(stmt, n++, row.birthDate.c_str(), -1, SQLITE_STATIC);
+      if (fields & FIELD_DEATH)
+      {
+         sqlite3_bind_text(stmt, n++, row.isAlive.c_str(), -1, SQLITE_STATIC);
+         sqlite3_bind_text(stmt, n++, row.deathDate.c_str(), -1, SQLITE_STATIC);
+      }
+      if (fields & FIELD_INFO)
+         sqlite3_bind_text(stmt, n++, row.info.c_str(), -1, SQLITE_STATIC);
+      if (fields & FIELD_BIRTH_PLACE)
+      {
+         sqlite3_bind_text(stmt, n++, row.birthPlace.c_str(), -1, SQLITE_STATIC);
+         sqlite3_bind_text(stmt, n++, row.birthPlace.c_str(), -1, SQLITE_STATIC);
+      }
+      if (fields & FIELD_PHOTO)
+         sqlite3_bind_text(stmt, n++, row.photo.c_str(), -1, SQLITE_STATIC);
+      if (fields & FIELD_SEX)
+         sqlite3_bind_text(stmt, n++, row.sex.c_str(), -1, SQLITE_STATIC);
+      if (fields & FIELD_PARENTS)
+      {
+         sqlite3_bind_int(stmt, n++, row.fatherId);
+         sqlite3_bind_int(stmt, n++, row.motherId);
+      }
+      if (fields & FIELD_CHILDREN)
+      {
+         sqlite3_bind_int(stmt, n++, row.childrenCnt);
+         sqlite3_bind_text(stmt, n++, row.childrenID.c_str(), -1, SQLITE_STATIC);
+      }
+      sqlite3_bind_int(stmt, n, row.id);
+
+      ret = sqlite3_step(stmt);
+      sqlite3_reset(stmt);
+      if (ret == SQLITE_DONE)
+         ret = SQLITE_OK;
+   }
+
+   if (ret != SQLITE_OK)
+      databaseError();
+
+   finalizeSTMT(insertStmt);
+   finalizeSTMT(deleteStmt);
+   for (auto &it : updateStmts)
+      finalizeSTMT(it.second);
+
+   // Дельта ложится целиком или не ложится вовсе
+   if (ret != SQLITE_OK)
+   {
+      rollbackTransaction(_db);
+      return ret;
+   }
+   return endTransaction(_db);
+}
+
 int DB::getListOfRoots(std::vector<std::string> & rootList, std::vector<std::string> &tableList, std::string format )
 {
    int ret = 0;
@@ -357,4 +694,810 @@ int DB::getListOfRoots(std::vector<std::string> & rootList, std::vector<std::str
    return ret;
 }
 
+int DB::getListOfPersons(std::string tableName, std::vector<Person> &persList, std::string format)
+{
+   int ret = 0;
+
+   persList.clear();
+
+   std::string request = "SELECT ID, NAME, DATEOFBIRTH, ISALIVE, DATEOFDEATH, INFO, BIRTHPLACE, PHOTO, SEX, \
+FATHERID, MOTHERID, CHILDRENID FROM ";
+   request += tableName;
+   request += " WHERE NAME LIKE ";
+   request += format;
+
+   sqlite3_stmt *_pStmt;
+
+   ret = sqlite3_prepare(_db, request.c_str(), -1, &_pStmt, nullptr);
+
+   if(ret != SQLITE_OK)
+   {
+        writeDebugLog("DB::getListOfPersons Prepare failed");
+        databaseError();
+        return -1;
+   }
+
+   std::vector<int> fatherIds, motherIds;
+   std::vector<QString> childrenIds;
+
+   {
+   dbTransactor trans(this,_pStmt);
+
+   while (1)
+   {
+        int s;
+
+        s = sqlite3_step (_pStmt);
+        if (s == SQLITE_ROW)
+        {
+             Person pers;
+             pers.id = static_cast<uint32_t>(sqlite3_column_int(_pStmt, 0));
+             pers.name = QString::fromUtf8((const char*)sqlite3_column_text(_pStmt, 1));
+             pers.birthDate = QDate::fromString((const char*)sqlite3_column_text(_pStmt, 2), "dd.MM.yyyy");
+             pers.bIsAlive = (strcmp((const char*)sqlite3_column_text(_pStmt, 3), "Alive") == 0);
+             pers.deathDate = QDate::fromString((const char*)sqlite3_column_text(_pStmt, 4), "dd.MM.yyyy");
+             pers.info = QString::fromUtf8((const char*)sqlite3_column_text(_pStmt, 5));
+             pers.birthPlace = QString::fromUtf8((const char*)sqlite3_column_text(_pStmt, 6));
+             pers.photoData = QByteArray::fromBase64((const char*)sqlite3_column_text(_pStmt, 7));
+             pers.sex = QString::fromUtf8((const char*)sqlite3_column_text(_pStmt, 8));
+             fatherIds.push_back(sqlite3_column_int(_pStmt, 9));
+             motherIds.push_back(sqlite3_column_int(_pStmt, 10));
+             childrenIds.push_back(QString::fromUtf8((const char*)sqlite3_column_text(_pStmt, 11)));
+             persList.push_back(pers);
+        }
+        else if (s == SQLITE_DONE)
+        {
+             break;
+        }
+        else
+        {
+             ret = -1;
+             break;
+        }
+   }
+   }
+
+   if (ret)
+   {
+      databaseError();
+      persList.clear();
+      return ret;
+   }
+
+   // Связи восстанавливаются после заполнения вектора, чтобы указатели не поплыли
+   std::unordered_map<uint32_t, Person*> byId;
+   byId.reserve(persList.size());
+   for (Person &pers : persList)
+   {
+      byId[pers.id] = &pers;
+      if (pers.id > Person::global_id)
+         Person::global_id = pers.id;
+   }
+
+   auto find = [&byId](int id) -> Person*
+   {
+      if (id <= 0)
+         return nullptr;
+      auto it = byId.find(static_cast<uint32_t>(id));
+      return (it != byId.end()) ? it->second : nullptr;
+   };
+
+   for (size_t i = 0; i < persList.size(); i++)
+   {
+      Person &pers = persList[i];
+      pers.father = find(fatherIds[i]);
+      pers.mother = find(motherIds[i]);
+      if (pers.father)
+         pers.father->children.append(&pers);
+      if (pers.mother)
+         pers.mother->children.append(&pers);
+   }
+
+   for (size_t i = 0; i < persList.size(); i++)
+   {
+      Person &pers = persList[i];
+      for (const QString &childId : childrenIds[i].split(' ', QString::SkipEmptyParts))
+      {
+         Person *child = find(childId.toInt());
+         if (child && !pers.children.contains(child))
+            pers.children.append(child);
+      }
+   }
+
+   return ret;
+}
+
+int DB::getPersonKeys(std::string tableName, std::vector<PersonKey> &keyList)
+{
+   int ret = 0;
+
+   keyList.clear();
+
+   std::string request = "SELECT ID, NAME, DATEOFBIRTH FROM ";
+   request += tableName;
+
+   sqlite3_stmt *_pStmt;
+
+   ret = sqlite3_prepare(_db, request.c_str(), -1, &_pStmt, nullptr);
+
+   if(ret != SQLITE_OK)
+   {
+        writeDebugLog("DB::getPersonKeys Prepare failed");
+        databaseError();
+        return -1;
+   }
+
+   dbTransactor trans(this,_pStmt);
+
+   while (1)
+   {
+        int s;
+
+        s = sqlite3_step (_pStmt);
+        if (s == SQLITE_ROW)
+        {
+             PersonKey key;
+             key.id = static_cast<uint32_t>(sqlite3_column_int(_pStmt, 0));
+             key.name = (const char*)sqlite3_column_text(_pStmt, 1);
+             key.birthDate = (const char*)sqlite3_column_text(_pStmt, 2);
+             keyList.push_back(key);
+        }
+        else if (s == SQLITE_DONE)
+        {
+             break;
+        }
+        else
+        {
+             databaseError();
+             ret = -1;
+             break;
+        }
+   }
+
+   return ret;
+}
+
+int DB::findSoundsLike(std::string tableName, std::string name, std::vector<PersonKey> &keyList)
+{
+   keyList.clear();
+
+   std::string key = PhoneticKey::ofName(name);
+   if (tableName.empty() || key.empty())
+      return 0;
+   int ret = prepareTable(tableName);
+   if (ret)
+      return ret;
+
+   // Весь ключ или его начало до пробела: "7421" находит и "7421", и "7421 0151",
+   // но не "74213". '!' - следующий символ после пробела, так что это диапазон по индексу
+   std::string request = "SELECT ID, NAME, DATEOFBIRTH FROM `" + tableName
+         + "` WHERE PHONETIC = ?1 OR (PHONETIC >= ?2 AND PHONETIC < ?3) ORDER BY NAMEKEY";
+   std::string from = key + ' ';
+   std::string to = key + '!';
+
+   sqlite3_stmt *_pStmt;
+   ret = sqlite3_prepare_v2(_db, request.c_str(), -1, &_pStmt, nullptr);
+   if (ret != SQLITE_OK)
+   {
+      writeDebugLog("DB::findSoundsLike Prepare failed");
+      databaseError();
+      return -1;
+   }
+   sqlite3_bind_text(_pStmt, 1, key.c_str(), -1, SQLITE_STATIC);
+   sqlite3_bind_text(_pStmt, 2, from.c_str(), -1, SQLITE_STATIC);
+   sqlite3_bind_text(_pStmt, 3, to.c_str(), -1, SQLITE_STATIC);
+
+   dbTransactor trans(this,_pStmt);
+
+   while (1)
+   {
+      int s = sqlite3_step(_pStmt);
+      if (s == SQLITE_ROW)
+      {
+         PersonKey pkey;
+         pkey.id = static_cast<uint32_t>(sqlite3_column_int(_pStmt, 0));
+         pkey.name = (const char*)sqlite3_column_text(_pStmt, 1);
+         pkey.birthDate = (const char*)sqlite3_column_text(_pStmt, 2);
+         keyList.push_back(pkey);
+      }
+      else if (s == SQLITE_DONE)
+      {
+         break;
+      }
+      else
+      {
+         databaseError();
+         ret = -1;
+         break;
+      }
+   }
+
+   return ret;
+}
+
+int DB::fuzzyFindPersons(std::string tableName, std::string name, int maxDistance, std::vector<PersonKey> &keyList,
+                         std::vector<int> *distances)
+{
+   keyList.clear();
+   if (distances)
+      distances->clear();
+
+   NameMatcher matcher(name, maxDistance);
+   if (tableName.empty() || !matcher.length())
+      return 0;
+
+   // LENGTH считает буквы; нормализованное имя не длиннее, так что отсев снизу безопасен
+   std::string request = "SELECT ID, NAME, DATEOFBIRTH FROM `" + tableName + "` WHERE LENGTH(NAME) >= ?";
+
+   sqlite3_stmt *_pStmt;
+   int ret = sqlite3_prepare_v2(_db, request.c_str(), -1, &_pStmt, nullptr);
+   if (ret != SQLITE_OK)
+   {
+      writeDebugLog("DB::fuzzyFindPersons Prepare failed");
+      databaseError();
+      return -1;
+   }
+   sqlite3_bind_int(_pStmt, 1, matcher.length() - matcher.maxDistance());
+
+   std::vector<std::pair<int, PersonKey>> found;
+   std::vector<PersonKey> batch;
+   std::vector<std::string> names;
+   std::vector<int> result;
+   batch.reserve(FUZZY_BATCH);
+   names.reserve(FUZZY_BATCH);
+
+   // Имена сравниваются пачками: ядро NameMatcher считает несколько кандидатов разом
+   auto flush = [&]()
+   {
+      matcher.distances(names, result);
+      for (size_t i = 0; i < batch.size(); i++)
+         if (result[i] <= maxDistance)
+            found.emplace_back(result[i], std::move(batch[i]));
+      batch.clear();
+      names.clear();
+   };
+
+   {
+      dbTransactor trans(this,_pStmt);
+
+      while (1)
+      {
+         int s = sqlite3_step(_pStmt);
+         if (s == SQLITE_ROW)
+         {
+            PersonKey key;
+            key.id = static_cast<uint32_t>(sqlite3_column_int(_pStmt, 0));
+            key.name = (const char*)sqlite3_column_text(_pStmt, 1);
+            key.birthDate = (const char*)sqlite3_column_text(_pStmt, 2);
+            names.push_back(NameMatcher::normalize(key.name));
+            batch.push_back(std::move(key));
+            if (batch.size() == FUZZY_BATCH)
+               flush();
+         }
+         else if (s == SQLITE_DONE)
+         {
+            break;
+         }
+         else
+         {
+            databaseError();
+            ret = -1;
+            break;
+         }
+      }
+   }
+   if (ret)
+      return ret;
+   flush();
+
+   // Равные по расстоянию - по алфавиту; ключ сортировки считается один раз на имя
+   std::vector<std::string> sortKeys;
+   std::vector<size_t> order(found.size());
+   sortKeys.reserve(found.size());
+   for (size_t i = 0; i < found.size(); i++)
+   {
+      sortKeys.push_back(CollationKey::of(found[i].second.name));
+      order[i] = i;
+   }
+   std::sort(order.begin(), order.end(), [&found, &sortKeys](size_t a, size_t b)
+   {
+      if (found[a].first != found[b].first)
+         return found[a].first < found[b].first;
+      return (sortKeys[a] != sortKeys[b]) ? (sortKeys[a] < sortKeys[b]) : (a < b);
+   });
+   for (size_t i : order)
+   {
+      keyList.push_back(std::move(found[i].second));
+      if (distances)
+         distances->push_back(found[i].first);
+   }
+   return 0;
+}
+
+int DB::getPersonRows(std::string tableName, std::vector<PersonRow> &rows)
+{
+   rows.clear();
+
+   std::string request = "SELECT ID, NAME, DATEOFBIRTH, ISALIVE, DATEOFDEATH, BIRTHPLACE, SEX, FATHERID, MOTHERID FROM `"
+         + tableName + "`";
+
+   sqlite3_stmt *_pStmt;
+   int ret = sqlite3_prepare_v2(_db, request.c_str(), -1, &_pStmt, nullptr);
+   if (ret != SQLITE_OK)
+   {
+      writeDebugLog("DB::getPersonRows Prepare failed");
+      databaseError();
+      return -1;
+   }
+
+   auto text = [&_pStmt](int column)
+   {
+      const unsigned char *value = sqlite3_column_text(_pStmt, column);
+      return value ? std::string(reinterpret_cast<const char*>(value)) : std::string();
+   };
+
+   dbTransactor trans(this,_pStmt);
+
+   while (1)
+   {
+      int s = sqlite3_step(_pStmt);
+      if (s == SQLITE_ROW)
+      {
+         PersonRow row;
+         row.id = static_cast<uint32_t>(sqlite3_column_int(_pStmt, 0));
+         row.name = text(1);
+         row.birthDate = text(2);
+         row.isAlive = text(3);
+         row.deathDate = text(4);
+         row.birthPlace = text(5);
+         row.sex = text(6);
+         row.fatherId = static_cast<uint32_t>(sqlite3_column_int(_pStmt, 7));
+         row.motherId = static_cast<uint32_t>(sqlite3_column_int(_pStmt, 8));
+         row.childrenCnt = 0;
+         rows.push_back(std::move(row));
+      }
+      else if (s == SQLITE_DONE)
+      {
+         break;
+      }
+      else
+      {
+         databaseError();
+         ret = -1;
+         break;
+      }
+   }
+
+   return ret;
+}
+
+int DB::getPerson(std::string tableName, uint32_t id, PersonRow &row, bool &found)
+{
+   found = false;
+   if (prepareTable(tableName))
+      return -1;
+
+   std::string request = "SELECT ID, NAME, DATEOFBIRTH, ISALIVE, DATEOFDEATH, BIRTHPLACE, SEX, FATHERID, MOTHERID FROM `"
+         + tableName + "` WHERE ID = ? LIMIT 1";
+
+   sqlite3_stmt *_pStmt;
+   int ret = sqlite3_prepare_v2(_db, request.c_str(), -1, &_pStmt, nullptr);
+   if (ret != SQLITE_OK)
+   {
+      writeDebugLog("DB::getPerson Prepare failed");
+      databaseError();
+      return -1;
+   }
+
+   auto text = [&_pStmt](int column)
+   {
+      const unsigned char *value = sqlite3_column_text(_pStmt, column);
+      return value ? std::string(reinterpret_cast<const char*>(value)) : std::string();
+   };
+
+   sqlite3_bind_int(_pStmt, 1, id);
+   ret = sqlite3_step(_pStmt);
+   if (ret == SQLITE_ROW)
+   {
+      row.id = static_cast<uint32_t>(sqlite3_column_int(_pStmt, 0));
+      row.name = text(1);
+      row.birthDate = text(2);
+      row.isAlive = text(3);
+      row.deathDate = text(4);
+      row.birthPlace = text(5);
+      row.sex = text(6);
+      row.fatherId = static_cast<uint32_t>(sqlite3_column_int(_pStmt, 7));
+      row.motherId = static_cast<uint32_t>(sqlite3_column_int(_pStmt, 8));
+      row.childrenCnt = 0;
+      found = true;
+      ret = 0;
+   }
+   else if (ret == SQLITE_DONE)
+   {
+      ret = 0;
+   }
+   else
+   {
+      databaseError();
+      ret = -1;
+   }
+
+   finalizeSTMT(_pStmt);
+   return ret;
+}
+
+int DB::getAncestors(std::string tableName, uint32_t id, int maxDepth, std::vector<PersonKey> &keyList,
+                     std::vector<int> *depths)
+{
+   keyList.clear();
+   if (depths)
+      depths->clear();
+   if (prepareTable(tableName))
+      return -1;
+
+   // Шаг рекурсии - к отцу и к матери через индекс ID; "нет родителя" (-1) ни с чем не соединяется.
+   // Предел глубины защищает и от циклов в повреждённых данных
+   std::string request = "WITH RECURSIVE UP(ID, DEPTH) AS (VALUES(?1, 0) UNION SELECT CASE PARENT.SIDE WHEN 0 \
+THEN P.FATHERID ELSE P.MOTHERID END, UP.DEPTH + 1 FROM UP JOIN `" + tableName + "` P ON P.ID = UP.ID \
+JOIN (SELECT 0 AS SIDE UNION ALL SELECT 1) PARENT WHERE UP.DEPTH < ?2) \
+SELECT A.ID, A.NAME, A.DATEOFBIRTH, MIN(UP.DEPTH) AS D FROM UP JOIN `" + tableName + "` A ON A.ID = UP.ID \
+WHERE UP.DEPTH > 0 GROUP BY A.ID ORDER BY D, A.ID";
+
+   sqlite3_stmt *_pStmt;
+   int ret = sqlite3_prepare_v2(_db, request.c_str(), -1, &_pStmt, nullptr);
+   if (ret != SQLITE_OK)
+   {
+      writeDebugLog("DB::getAncestors Prepare failed");
+      databaseError();
+      return -1;
+   }
+
+   sqlite3_bind_int(_pStmt, 1, id);
+   sqlite3_bind_int(_pStmt, 2, ((maxDepth > 0) && (maxDepth < ANCESTOR_MAX_DEPTH)) ? maxDepth : ANCESTOR_MAX_DEPTH);
+
+   ret = 0;
+   while (1)
+   {
+      int s = sqlite3_step(_pStmt);
+      if (s == SQLITE_ROW)
+      {
+         PersonKey key;
+         key.id = static_cast<uint32_t>(sqlite3_column_int(_pStmt, 0));
+         const unsigned char *name = sqlite3_column_text(_pStmt, 1);
+         const unsigned char *birthDate = sqlite3_column_text(_pStmt, 2);
+         key.name = name ? reinterpret_cast<const char*>(name) : "";
+         key.birthDate = birthDate ? reinterpret_cast<const char*>(birthDate) : "";
+         keyList.push_back(std::move(key));
+         if (depths)
+            depths->push_back(sqlite3_column_int(_pStmt, 3));
+      }
+      else if (s == SQLITE_DONE)
+      {
+         break;
+      }
+      else
+      {
+         databaseError();
+         ret = -1;
+         break;
+      }
+   }
+
+   finalizeSTMT(_pStmt);
+   return ret;
+}
+
+// Выражения сортировки; даты хранятся как dd.MM.yyyy и сравниваются в виде yyyyMMdd,
+// имена и места - по ключам CollationKey, побайтно
+static const struct
+{
+   const char *expression;
+   const char *index;   // суффикс имени индекса
+   int type;            // тип значения в PageAnchor
+} SORT_COLUMNS[SORT_COLUMN_COUNT] = {
+   { "ID", "ID", SQLITE_INTEGER },
+   { "NAMEKEY", "NAMEKEY", SQLITE_BLOB },
+   { "substr(DATEOFBIRTH, 7, 4) || substr(DATEOFBIRTH, 4, 2) || substr(DATEOFBIRTH, 1, 2)", "BIRTH", SQLITE_TEXT },
+   { "substr(DATEOFDEATH, 7, 4) || substr(DATEOFDEATH, 4, 2) || substr(DATEOFDEATH, 1, 2)", "DEATH", SQLITE_TEXT },
+   { "PLACEKEY", "PLACEKEY", SQLITE_BLOB },
+   { "SEX", "SEX", SQLITE_TEXT }
+};
+
+int DB::prepareSortIndex(const std::string &tableName, int sortColumn)
+{
+   std::string name = tableName + "_SORT_" + SORT_COLUMNS[sortColumn].index;
+   if (_preparedTables.count(name))
+      return 0;
+   // NAMEKEY и PLACEKEY в старых таблицах появляются здесь
+   int ret = prepareTable(tableName);
+   if (ret)
+      return ret;
+
+   // Индекс по выражению с ENTRYID в конце: и ORDER BY, и переход к следующей странице идут по нему
+   std::string request = "CREATE INDEX IF NOT EXISTS `" + name + "` ON `" + tableName + "` ("
+         + SORT_COLUMNS[sortColumn].expression + ", ENTRYID)";
+   ret = sqlite3_exec(_db, request.c_str(), nullptr, nullptr, nullptr);
+   if (ret != SQLITE_OK)
+   {
+      databaseError();
+      return ret;
+   }
+   _preparedTables.insert(name);
+   return 0;
+}
+
+int DB::getPersonColumns(std::string tableName, PersonColumns &columns)
+{
+   columns.clear();
+
+   // dd.MM.yyyy разбирается запросом: год и месяц * 100 + день приходят целыми
+   std::string request = "SELECT CAST(substr(DATEOFBIRTH, 7, 4) AS INTEGER),"
+         " CAST(substr(DATEOFBIRTH, 4, 2) || substr(DATEOFBIRTH, 1, 2) AS INTEGER),"
+         " CASE WHEN ISALIVE = 'Alive' THEN 0 ELSE CAST(substr(DATEOFDEATH, 7, 4) AS INTEGER) END,"
+         " CASE WHEN ISALIVE = 'Alive' THEN 0 ELSE CAST(substr(DATEOFDEATH, 4, 2) || substr(DATEOFDEATH, 1, 2) AS INTEGER) END,"
+         " BIRTHPLACE, SEX, CHILDRENCNT FROM `" + tableName + "`";
+
+   sqlite3_stmt *_pStmt;
+   int ret = sqlite3_prepare_v2(_db, request.c_str(), -1, &_pStmt, nullptr);
+   if (ret != SQLITE_OK)
+   {
+      writeDebugLog("DB::getPersonColumns Prepare failed");
+      databaseError();
+      return -1;
+   }
+
+   dbTransactor trans(this,_pStmt);
+
+   std::unordered_map<std::string, int> placeIndex;
+   std::string place, sex;
+   while (1)
+   {
+      int s = sqlite3_step(_pStmt);
+      if (s == SQLITE_ROW)
+      {
+         columns.birthYear.push_back(sqlite3_column_int(_pStmt, 0));
+         columns.birthMonthDay.push_back(sqlite3_column_int(_pStmt, 1));
+         columns.deathYear.push_back(sqlite3_column_int(_pStmt, 2));
+         columns.deathMonthDay.push_back(sqlite3_column_int(_pStmt, 3));
+         columns.children.push_back(sqlite3_column_int(_pStmt, 6));
+
+         const char *value = reinterpret_cast<const char*>(sqlite3_column_text(_pStmt, 5));
+         sex = value ? value : "";
+         columns.sex.push_back(Person::sexOf(sex));
+
+         value = reinterpret_cast<const char*>(sqlite3_column_text(_pStmt, 4));
+         place = value ? value : "";
+         size_t first = place.find_first_not_of(" \t\r\n");
+         int index = -1;
+         if (first != std::string::npos)
+         {
+            place = place.substr(first, place.find_last_not_of(" \t\r\n") + 1 - first);
+            auto it = placeIndex.emplace(place, static_cast<int>(columns.places.size())).first;
+            if (it->second == static_cast<int>(columns.places.size()))
+               columns.places.push_back(QString::fromStdString(place));
+            index = it->second;
+         }
+         columns.place.push_back(index);
+      }
+      else if (s == SQLITE_DONE)
+      {
+         break;
+      }
+      else
+      {
+         databaseError();
+         ret = -1;
+         break;
+      }
+   }
+   if (ret)
+      columns.clear();
+   return ret;
+}
+
+int DB::countPersons(std::string tableName, int64_t &count)
+{
+   count = 0;
+   std::string request = "SELECT COUNT(*) FROM `" + tableName + "`";
+
+   sqlite3_stmt *_pStmt;
+   int ret = sqlite3_prepare_v2(_db, request.c_str(), -1, &_pStmt, nullptr);
+   if (ret != SQLITE_OK)
+   {
+      writeDebugLog("DB::countPersons Prepare failed");
+      databaseError();
+      return -1;
+   }
+
+   ret = sqlite3_step(_pStmt);
+   if (ret == SQLITE_ROW)
+   {
+      count = sqlite3_column_int64(_pStmt, 0);
+      ret = 0;
+   }
+   else
+   {
+      databaseError();
+      ret = -1;
+   }
+   finalizeSTMT(_pStmt);
+   return ret;
+}
+
+int DB::getPersonPage(std::string tableName, int sortColumn, bool descending, const PageAnchor &after, int limit,
+                      PersonPage &page)
+{
+   page.rows.clear();
+   page.last = after;
+   if (tableName.empty() || (sortColumn < 0) || (sortColumn >= SORT_COLUMN_COUNT) || (limit <= 0))
+      return -1;
+
+   int ret = prepareSortIndex(tableName, sortColumn);
+   if (ret)
+      return ret;
+
+   std::string expression = SORT_COLUMNS[sortColumn].expression;
+   std::string direction = descending ? " DESC" : "";
+   std::string select = "SELECT ENTRYID, " + expression + ", ID, NAME, DATEOFBIRTH, ISALIVE, DATEOFDEATH, BIRTHPLACE,"
+         " SEX, FATHERID, MOTHERID FROM `" + tableName + "`";
+   std::string request;
+   if (!after.valid)
+   {
+      request = select + " ORDER BY " + expression + direction + ", ENTRYID" + direction + " LIMIT ?3";
+   }
+   else
+   {
+      // Продолжение после якоря - два поиска по индексу (expr, ENTRYID): остаток строк с тем же
+      // значением и строки дальше. Одно условие "expr >= ? AND (expr > ? OR ENTRYID > ?)"
+      // на столбце с немногими значениями (пол, место) просматривало бы всю группу равных
+      std::string op = descending ? " < " : " > ";
+      request = "SELECT * FROM (" + select + " WHERE " + expression + " = ?1 AND ENTRYID" + op + "?2"
+            " ORDER BY ENTRYID" + direction + " LIMIT ?3)"
+            " UNION ALL SELECT * FROM (" + select + " WHERE " + expression + op + "?1"
+            " ORDER BY " + expression + direction + ", ENTRYID" + direction + " LIMIT ?3)"
+            " ORDER BY 2" + direction + ", 1" + direction + " LIMIT ?3";
+   }
+
+   sqlite3_stmt *_pStmt;
+   ret = sqlite3_prepare_v2(_db, request.c_str(), -1, &_pStmt, nullptr);
+   if (ret != SQLITE_OK)
+   {
+      writeDebugLog("DB::getPersonPage Prepare failed");
+      databaseError();
+      return -1;
+   }
+   if (after.valid)
+   {
+      int size = static_cast<int>(after.value.size());
+      if (SORT_COLUMNS[sortColumn].type == SQLITE_INTEGER)
+         sqlite3_bind_int64(_pStmt, 1, atoll(after.value.c_str()));
+      else if (SORT_COLUMNS[sortColumn].type == SQLITE_BLOB)
+         sqlite3_bind_blob(_pStmt, 1, after.value.data(), size, SQLITE_STATIC);
+      else
+         sqlite3_bind_text(_pStmt, 1, after.value.data(), size, SQLITE_STATIC);
+      sqlite3_bind_int64(_pStmt, 2, after.entryId);
+   }
+   sqlite3_bind_int(_pStmt, 3, limit);
+
+   auto text = [&_pStmt](int column)
+   {
+      const unsigned char *value = sqlite3_column_text(_pStmt, column);
+      return value ? std::string(reinterpret_cast<const char*>(value)) : std::string();
+   };
+
+   page.rows.reserve(limit);
+   while (1)
+   {
+      int s = sqlite3_step(_pStmt);
+      if (s == SQLITE_ROW)
+      {
+         PersonRow row;
+         row.id = static_cast<uint32_t>(sqlite3_column_int(_pStmt, 2));
+         row.name = text(3);
+         row.birthDate = text(4);
+         row.isAlive = text(5);
+         row.deathDate = text(6);
+         row.birthPlace = text(7);
+         row.sex = text(8);
+         row.fatherId = static_cast<uint32_t>(sqlite3_column_int(_pStmt, 9));
+         row.motherId = static_cast<uint32_t>(sqlite3_column_int(_pStmt, 10));
+         row.childrenCnt = 0;
+         page.rows.push_back(std::move(row));
+
+         page.last.valid = true;
+         page.last.entryId = sqlite3_column_int64(_pStmt, 0);
+         // Байты как есть: ключ сортировки - BLOB, и сравнивать его с якорем надо как BLOB
+         const char *value = static_cast<const char*>(sqlite3_column_blob(_pStmt, 1));
+         page.last.value.assign(value ? value : "", sqlite3_column_bytes(_pStmt, 1));
+      }
+      else if (s == SQLITE_DONE)
+      {
+         break;
+      }
+      else
+      {
+         databaseError();
+         ret = -1;
+         break;
+      }
+   }
+   finalizeSTMT(_pStmt);
+   return ret;
+}
+
+int DB::getThumbnail(std::string photoHash, int size, std::string &data)
+{
+   // Вызывается из потоков декодирования фото через отдельное соединение только для чтения,
+   // поэтому без явной транзакции
+   data.clear();
+
+   sqlite3_stmt *_pStmt;
+   int ret = sqlite3_prepare_v2(_db, "SELECT DATA FROM THUMBNAILTABLE WHERE PHOTOHASH = ? AND SIZE = ?", -1, &_pStmt, nullptr);
+
+   if (ret != SQLITE_OK)
+   {
+      databaseError();
+      return -1;
+   }
+
+   sqlite3_bind_text(_pStmt, 1, photoHash.c_str(), -1, SQLITE_STATIC);
+   sqlite3_bind_int(_pStmt, 2, size);
+
+   ret = sqlite3_step(_pStmt);
+   if (ret == SQLITE_ROW)
+   {
+      const char *blob = static_cast<const char*>(sqlite3_column_blob(_pStmt, 0));
+      data.assign(blob, sqlite3_column_bytes(_pStmt, 0));
+      ret = 0;
+   }
+   else if (ret == SQLITE_DONE)
+   {
+      ret = 0;
+   }
+   else
+   {
+      databaseError();
+      ret = -1;
+   }
+
+   finalizeSTMT(_pStmt);
+   return ret;
+}
+
+int DB::putThumbnails(const std::vector<ThumbnailRecord> &records)
+{
+   if (records.empty())
+      return 0;
+
+   sqlite3_stmt *_pStmt;
+   int ret = sqlite3_prepare_v2(_db, "INSERT OR REPLACE INTO THUMBNAILTABLE (PHOTOHASH, SIZE, DATA) VALUES(?, ?, ?)", -1, &_pStmt, nullptr);
+
+   if (ret != SQLITE_OK)
+   {
+      databaseError();
+      return ret;
+   }
+
+   // Все записи пачки - одной транзакцией
+   dbTransactor trans(this,_pStmt);
+
+   for (const ThumbnailRecord &rec : records)
+   {
+      sqlite3_bind_text(_pStmt, 1, rec.photoHash.c_str(), -1, SQLITE_STATIC);
+      sqlite3_bind_int(_pStmt, 2, rec.size);
+      sqlite3_bind_blob(_pStmt, 3, rec.data.data(), static_cast<int>(rec.data.size()), SQLITE_STATIC);
+
+      ret = sqlite3_step(_pStmt);
+      sqlite3_reset(_pStmt);
+      if (ret != SQLITE_DONE)
+      {
+         databaseError();
+         trans.rollback();
+         return ret;
+      }
+   }
+
+   return 0;
+}
+
 #endif
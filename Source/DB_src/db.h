@@ -11,6 +11,7 @@
 #include <ctime>
 #include <assert.h>
 #include <vector>
+#include <unordered_set>
 
 #include "sqlite3.h"
 #include "person.h"
@@ -20,6 +21,12 @@
         `ROOTID`        INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT,     \
         `NAME`          TEXT NOT NULL,                                  \
         `TABLENAME`     TEXT NOT NULL                                   \
+        );                                                              \
+        CREATE TABLE IF NOT EXISTS `THUMBNAILTABLE` (                   \
+        `PHOTOHASH`     TEXT NOT NULL,                                  \
+        `SIZE`          INTEGER NOT NULL,                               \
+        `DATA`          BLOB NOT NULL,                                  \
+        PRIMARY KEY (`PHOTOHASH`, `SIZE`)                               \
         );"
 
 #define INSERT_ROOT_TABLE_FORMAT     "CREATE TABLE IF NOT EXISTS `%s` (  \
@@ -36,13 +43,19 @@
         `FATHERID`        INTEGER NOT NULL,                               \
         `MOTHERID`        INTEGER NOT NULL,                               \
         `CHILDRENCNT`     INTEGER NOT NULL,                               \
-        `CHILDRENID`      TEXT NOT NULL                               \
+        `CHILDRENID`      TEXT NOT NULL,                              \
+        `PHONETIC`        TEXT NOT NULL DEFAULT '',                       \
+        `NAMEKEY`         BLOB NOT NULL DEFAULT X'',                      \
+        `PLACEKEY`        BLOB NOT NULL DEFAULT X''                       \
         );"
 
 //SELECT * FROM LOGLIST WHERE Tablename LIKE 'adminlog%'
 //SELECT * FROM LOGLIST WHERE Tablename LIKE '%21122018%'
 
 #define DB_PATH                         "family.db"
+#define FUZZY_BATCH                     1024    // имён на пачку нечёткого поиска
+#define ANCESTOR_MAX_DEPTH              256     // предел поколений, если глубина не задана
+#define READER_BUSY_TIMEOUT             200     // мс, сколько читающее соединение ждёт конца записи
 
 #ifndef F_OK
 # define F_OK 0
@@ -63,6 +76,77 @@
 
 #pragma pack(pop)
 
+// Уменьшенная копия фото, хранится по хэшу исходных данных и размеру
+struct ThumbnailRecord
+{
+   std::string photoHash;
+   int size;
+   std::string data;
+};
+
+// Строка таблицы людей для пакетной вставки (поля в том же виде, что и у addPerson)
+struct PersonRow
+{
+   uint32_t id;
+   std::string name;
+   std::string birthDate;
+   std::string isAlive;
+   std::string deathDate;
+   std::string info;
+   std::string birthPlace;
+   std::string photo;
+   std::string sex;
+   uint32_t fatherId;
+   uint32_t motherId;
+   uint32_t childrenCnt;
+   std::string childrenID;
+};
+
+// Изменения одного дерева для записи одной транзакцией.
+// changedFields[i] - маска PersonField для changed[i]: обновляются только эти столбцы
+struct PersonDelta
+{
+   std::vector<PersonRow> added;
+   std::vector<PersonRow> changed;
+   std::vector<unsigned> changedFields;
+   std::vector<uint32_t> removed;
+};
+
+// Лёгкая запись о человеке без фото и текстов - для построения индексов
+struct PersonKey
+{
+   uint32_t id;
+   std::string name;
+   std::string birthDate;
+};
+
+// Столбцы, по которым таблица людей листается постранично
+enum PersonSortColumn
+{
+   SORT_ID,
+   SORT_NAME,
+   SORT_BIRTH_DATE,
+   SORT_DEATH_DATE,
+   SORT_BIRTH_PLACE,
+   SORT_SEX,
+   SORT_COLUMN_COUNT
+};
+
+// Позиция в отсортированной таблице: значение столбца сортировки и ENTRYID последней строки.
+// Следующая страница начинается строго после неё - без OFFSET, по индексу.
+// value - байты значения как есть: для ключей сортировки NAMEKEY/PLACEKEY это BLOB
+struct PageAnchor
+{
+   bool valid;
+   std::string value;
+   int64_t entryId;
+};
+
+struct PersonPage
+{
+   std::vector<PersonRow> rows;   // без фото, заметок и списка детей
+   PageAnchor last;
+};
 
 class DB
 {
@@ -71,7 +155,9 @@ public:
     virtual ~DB();
 
     void setDBPath(const char *dbpath);
-    int openDB();
+    const std::string &dbPath() const { return _dbPath; }
+    // readOnly - отдельное соединение для чтения из других потоков, база должна уже существовать
+    int openDB(bool readOnly = false);
     int closeDB();
     int checkDB();
 
@@ -81,11 +167,38 @@ public:
 
     int beginTransaction(sqlite3 *db);
     int endTransaction(sqlite3 *db);
+    int rollbackTransaction(sqlite3 *db);
 
     int createRoot(std::string rootName, std::string tableName);
+    // Таблица дерева и её строка в ROOTTABLE - одной транзакцией
+    int removeRoot(std::string tableName);
     int addPerson(std::string tableName, uint32_t id, std::string name, std::string birthDate, std::string isAlive, std::string deathDate, std::string info, std::string birthPlace, std::string photo, std::string sex, uint32_t fatherId, uint32_t motherId, uint32_t childrenCnt, std::string childrenID);
+    int addPersons(std::string tableName, const std::vector<PersonRow> &rows);
+    int savePersonDelta(std::string tableName, const PersonDelta &delta);
     int getListOfRoots(std::vector<std::string> &rootList, std::vector<std::string> &tableList, std::string format = "'%'");
     int getListOfPersons(std::string tableName, std::vector<Person> &persList, std::string format = "'%'");
+    int getPersonKeys(std::string tableName, std::vector<PersonKey> &keyList);
+    // По алфавиту
+    int findSoundsLike(std::string tableName, std::string name, std::vector<PersonKey> &keyList);
+    // По возрастанию расстояния, равные - по алфавиту; distances - расстояния в том же порядке
+    int fuzzyFindPersons(std::string tableName, std::string name, int maxDistance, std::vector<PersonKey> &keyList,
+                         std::vector<int> *distances = nullptr);
+    // Без фото, заметок и списка детей - для сравнения людей между собой
+    int getPersonRows(std::string tableName, std::vector<PersonRow> &rows);
+    // Одна строка по индексу ID, поля как у getPersonRows; found == false - такого ID нет
+    int getPerson(std::string tableName, uint32_t id, PersonRow &row, bool &found);
+    // Все предки одним рекурсивным запросом, ближние первыми; maxDepth 0 - до ANCESTOR_MAX_DEPTH.
+    // Общий предок по нескольким линиям входит один раз; depths - поколение в том же порядке
+    int getAncestors(std::string tableName, uint32_t id, int maxDepth, std::vector<PersonKey> &keyList,
+                     std::vector<int> *depths = nullptr);
+    // Даты числами, места - индексами в словаре: для отчётов TreeStatistics
+    int getPersonColumns(std::string tableName, PersonColumns &columns);
+    int countPersons(std::string tableName, int64_t &count);
+    // after.valid == false - с начала таблицы
+    int getPersonPage(std::string tableName, int sortColumn, bool descending, const PageAnchor &after, int limit,
+                      PersonPage &page);
+    int getThumbnail(std::string photoHash, int size, std::string &data);
+    int putThumbnails(const std::vector<ThumbnailRecord> &records);
 
     int finalizeSTMT(sqlite3_stmt *_pStmt)
     {
@@ -101,7 +214,12 @@ public:
 
     sqlite3 *_db;
 private:
+    static void bindPersonRow(sqlite3_stmt *stmt, const PersonRow &row);
+    int prepareTable(const std::string &tableName);
+    int prepareSortIndex(const std::string &tableName, int sortColumn);
+
     std::string _dbPath;
+    std::unordered_set<std::string> _preparedTables;   // уже с индексами и столбцами PHONETIC, NAMEKEY, PLACEKEY
     bool _bOpened;
 //    sqlite3_stmt *_pStmt;
 };
@@ -111,18 +229,24 @@ class dbTransactor
 {
    DB * _db;
    sqlite3_stmt *_pStmt;
+   bool _bRollback;
 public:
-   dbTransactor(DB * db, sqlite3_stmt * pStmt) : _db(db), _pStmt(pStmt)
+   dbTransactor(DB * db, sqlite3_stmt * pStmt) : _db(db), _pStmt(pStmt), _bRollback(false)
    {
       if (_db)
          _db->beginTransaction(_db->_db);
    }
+   // Перед выходом по ошибке: транзакция откатывается, а не фиксирует сделанное до неё
+   void rollback() { _bRollback = true; }
    ~dbTransactor()
    {
       if ((_db) && (_pStmt))
       {
          _db->finalizeSTMT(_pStmt);
-         _db->endTransaction(_db->_db);
+         if (_bRollback)
+            _db->rollbackTransaction(_db->_db);
+         else
+            _db->endTransaction(_db->_db);
       }
    }
 };
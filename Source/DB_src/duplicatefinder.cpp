@@ -0,0 +1,456 @@
+#ifdef DATABASE
+
+#include "duplicatefinder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <unordered_map>
+
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
+
+#include "componentindex.h"
+#include "phonetickey.h"
+#include "writelog.h"
+
+// Веса полей в оценке пары
+static const double WEIGHT_NAME = 0.40;
+static const double WEIGHT_BIRTH = 0.25;
+static const double WEIGHT_DEATH = 0.10;
+static const double WEIGHT_PLACE = 0.10;
+static const double WEIGHT_PARENTS = 0.15;
+
+// Сумма весов, на которую делится оценка, даже если известно меньше полей:
+// совпадение одного имени без дат не должно выглядеть как уверенный дубль
+static const double MIN_EVIDENCE = 0.75;
+
+static const int MAX_NAME_WORDS = 4;
+static const int NORMALIZE_CHUNK = 4096;
+
+DuplicateFinder::DuplicateFinder()
+{
+
+}
+
+void DuplicateFinder::clear()
+{
+   _tables.clear();
+   _records.clear();
+}
+
+void DuplicateFinder::parseDate(const std::string &date, int &year, int &day)
+{
+   // dd.MM.yyyy; дата из GEDCOM только с годом хранится как 01.01.yyyy
+   year = day = 0;
+   if (date.size() < 10)
+      return;
+   year = atoi(date.c_str() + 6);
+   if (year <= 0)
+   {
+      year = 0;
+      return;
+   }
+   day = year * 372 + (atoi(date.c_str() + 3) - 1) * 31 + atoi(date.c_str());
+}
+
+void DuplicateFinder::normalize(const PersonRow &row, Record &rec)
+{
+   rec.id = row.id;
+   std::string identity = ComponentIndex::identityKey(row.name, row.birthDate);
+   rec.identity = identity.empty() ? 0 : std::hash<std::string>()(identity);
+
+   rec.words.clear();
+   rec.codes.clear();
+   size_t pos = 0;
+   while ((pos < row.name.size()) && (rec.words.size() < static_cast<size_t>(MAX_NAME_WORDS)))
+   {
+      size_t next = row.name.find_first_of(" \t,.-()/", pos);
+      if (next == std::string::npos)
+         next = row.name.size();
+      std::string word = row.name.substr(pos, next - pos);
+      pos = next + 1;
+
+      std::string latin = PhoneticKey::transliterate(word);
+      if (latin.empty())
+         continue;
+      rec.words.push_back(latin);
+      std::string code = PhoneticKey::ofWord(word);
+      if (!code.empty() && (std::find(rec.codes.begin(), rec.codes.end(), code) == rec.codes.end()))
+         rec.codes.push_back(code);
+   }
+
+   rec.place = PhoneticKey::transliterate(row.birthPlace.substr(0, row.birthPlace.find(',')));
+   parseDate(row.birthDate, rec.birthYear, rec.birthDay);
+   parseDate(row.deathDate, rec.deathYear, rec.deathDay);
+
+   rec.sex = Person::sexOf(row.sex);
+
+   rec.father = rec.mother = -1;
+}
+
+int DuplicateFinder::build(DB &db, int threads)
+{
+   clear();
+
+   std::vector<std::string> roots;
+   int ret = db.getListOfRoots(roots, _tables);
+   if (ret)
+   {
+      writeDebugLog("DuplicateFinder::build Failed to get list of roots");
+      return ret;
+   }
+
+   if (threads <= 0)
+      threads = QThread::idealThreadCount();
+   QThreadPool pool;
+   pool.setMaxThreadCount(threads);
+
+   std::vector<PersonRow> rows;
+   std::unordered_map<uint32_t, int> byId;
+   for (size_t t = 0; t < _tables.size(); t++)
+   {
+      ret = db.getPersonRows(_tables[t], rows);
+      if (ret)
+      {
+         writeDebugLog(QString("DuplicateFinder::build Failed to read ") + _tables[t].c_str());
+         clear();
+         return ret;
+      }
+
+      // Транслитерация и фонетические коды считаются кусками в пуле
+      size_t base = _records.size();
+      _records.resize(base + rows.size());
+      std::vector<QFuture<void>> futures;
+      for (size_t begin = 0; begin < rows.size(); begin += NORMALIZE_CHUNK)
+      {
+         size_t end = std::min(rows.size(), begin + NORMALIZE_CHUNK);
+         futures.push_back(QtConcurrent::run(&pool, [this, &rows, base, begin, end, t]()
+         {
+            for (size_t i = begin; i < end; i++)
+            {
+               normalize(rows[i], _records[base + i]);
+               _records[base + i].table = static_cast<int>(t);
+            }
+         }));
+      }
+      for (QFuture<void> &future : futures)
+         future.waitForFinished();
+
+      // Родители ищутся в той же таблице; "нет родителя" хранится как -1
+      byId.clear();
+      byId.reserve(rows.size());
+      for (size_t i = 0; i < rows.size(); i++)
+         byId[rows[i].id] = static_cast<int>(base + i);
+      for (size_t i = 0; i < rows.size(); i++)
+      {
+         auto father = byId.find(rows[i].fatherId);
+         auto mother = byId.find(rows[i].motherId);
+         _records[base + i].father = (father != byId.end()) ? father->second : -1;
+         _records[base + i].mother = (mother != byId.end()) ? mother->second : -1;
+      }
+   }
+
+   writeDebugLog(QString("DuplicateFinder::build ") + QString::number(_records.size()) + " persons in "
+                 + QString::number(_tables.size()) + " tables");
+   return 0;
+}
+
+double DuplicateFinder::jaroWinkler(const std::string &a, const std::string &b)
+{
+   const int MAX_LEN = 64;
+   int la = std::min(static_cast<int>(a.size()), MAX_LEN);
+   int lb = std::min(static_cast<int>(b.size()), MAX_LEN);
+   if (!la || !lb)
+      return 0.0;
+
+   int range = std::max(0, std::max(la, lb) / 2 - 1);
+   bool matchedA[MAX_LEN] = {}, matchedB[MAX_LEN] = {};
+   int matches = 0;
+   for (int i = 0; i < la; i++)
+   {
+      for (int j = std::max(0, i - range); j < std::min(lb, i + range + 1); j++)
+      {
+         if (!matchedB[j] && (a[i] == b[j]))
+         {
+            matchedA[i] = matchedB[j] = true;
+            matches++;
+            break;
+         }
+      }
+   }
+   if (!matches)
+      return 0.0;
+
+   int transpositions = 0;
+   for (int i = 0, j = 0; i < la; i++)
+   {
+      if (!matchedA[i])
+         continue;
+      while (!matchedB[j])
+         j++;
+      if (a[i] != b[j])
+         transpositions++;
+      j++;
+   }
+
+   double m = matches;
+   double jaro = (m / la + m / lb + (m - transpositions / 2.0) / m) / 3.0;
+
+   int prefix = 0;
+   while ((prefix < 4) && (prefix < la) && (prefix < lb) && (a[prefix] == b[prefix]))
+      prefix++;
+   return jaro + prefix * 0.1 * (1.0 - jaro);
+}
+
+double DuplicateFinder::nameSimilarity(const std::vector<std::string> &a, const std::vector<std::string> &b)
+{
+   if (a.empty() || b.empty())
+      return 0.0;
+
+   // Слова сравниваются без учёта порядка; недостающее отчество лишь немного снижает оценку
+   const std::vector<std::string> &shorter = (a.size() <= b.size()) ? a : b;
+   const std::vector<std::string> &longer = (a.size() <= b.size()) ? b : a;
+   double sum = 0.0;
+   for (const std::string &word : shorter)
+   {
+      double best = 0.0;
+      for (const std::string &other : longer)
+         best = std::max(best, jaroWinkler(word, other));
+      sum += best;
+   }
+   return sum / shorter.size() * (0.9 + 0.1 * shorter.size() / longer.size());
+}
+
+double DuplicateFinder::dateSimilarity(int yearA, int dayA, int yearB, int dayB)
+{
+   if (dayA == dayB)
+      return 1.0;
+   switch (abs(yearA - yearB))
+   {
+   case 0: return 0.8;
+   case 1: return 0.5;
+   case 2: return 0.25;
+   default: return 0.0;
+   }
+}
+
+double DuplicateFinder::score(int a, int b, double minScore) const
+{
+   const Record &ra = _records[a];
+   const Record &rb = _records[b];
+
+   if ((ra.sex != SEX_UNKNOWN) && (rb.sex != SEX_UNKNOWN) && (ra.sex != rb.sex))
+      return 0.0;
+   if (ra.table == rb.table)
+   {
+      if ((ra.father == b) || (ra.mother == b) || (rb.father == a) || (rb.mother == a))
+         return 0.0;
+   }
+   else if (ra.identity && (ra.identity == rb.identity))
+   {
+      // Одинаковые ФИО и дата в разных деревьях ComponentIndex уже считает одним человеком;
+      // тёзки без даты им не связаны и сравниваются как обычно
+      return 0.0;
+   }
+
+   // Сначала дешёвые даты: если даже при полном совпадении остального порог не набрать,
+   // имена не сравниваются
+   double total = 0.0, weight = 0.0;
+   if (ra.birthYear && rb.birthYear)
+   {
+      total += WEIGHT_BIRTH * dateSimilarity(ra.birthYear, ra.birthDay, rb.birthYear, rb.birthDay);
+      weight += WEIGHT_BIRTH;
+   }
+   if (ra.deathYear && rb.deathYear)
+   {
+      total += WEIGHT_DEATH * dateSimilarity(ra.deathYear, ra.deathDay, rb.deathYear, rb.deathDay);
+      weight += WEIGHT_DEATH;
+   }
+
+   bool hasPlace = !ra.place.empty() && !rb.place.empty();
+   bool hasParents = ((ra.father >= 0) && (rb.father >= 0)) || ((ra.mother >= 0) && (rb.mother >= 0));
+   double rest = WEIGHT_NAME + (hasPlace ? WEIGHT_PLACE : 0.0) + (hasParents ? WEIGHT_PARENTS : 0.0);
+   if ((total + rest) / std::max(weight + rest, MIN_EVIDENCE) < minScore)
+      return 0.0;
+
+   total += WEIGHT_NAME * nameSimilarity(ra.words, rb.words);
+   weight += WEIGHT_NAME;
+   if (hasPlace)
+   {
+      total += WEIGHT_PLACE * jaroWinkler(ra.place, rb.place);
+      weight += WEIGHT_PLACE;
+   }
+
+   double parents = 0.0;
+   int known = 0;
+   if ((ra.father >= 0) && (rb.father >= 0))
+   {
+      parents += nameSimilarity(_records[ra.father].words, _records[rb.father].words);
+      known++;
+   }
+   if ((ra.mother >= 0) && (rb.mother >= 0))
+   {
+      parents += nameSimilarity(_records[ra.mother].words, _records[rb.mother].words);
+      known++;
+   }
+   if (known)
+   {
+      total += WEIGHT_PARENTS * parents / known;
+      weight += WEIGHT_PARENTS;
+   }
+
+   return total / std::max(weight, MIN_EVIDENCE);
+}
+
+void DuplicateFinder::appendEntries(int record, int pass, std::vector<BlockEntry> &entries) const
+{
+   const Record &rec = _records[record];
+   uint64_t salt;
+   switch (pass)
+   {
+   case PASS_WORD_YEAR:
+      salt = rec.birthYear ? static_cast<uint64_t>(rec.birthYear / DUPLICATE_YEAR_BUCKET) + 1 : 0;
+      break;
+   case PASS_WORD_YEAR_SHIFTED:
+      // Без года сетка со сдвигом ничего не добавляет
+      if (!rec.birthYear)
+         return;
+      salt = static_cast<uint64_t>((rec.birthYear + DUPLICATE_YEAR_BUCKET / 2) / DUPLICATE_YEAR_BUCKET) + 1;
+      break;
+   default:
+      if (rec.place.empty())
+         return;
+      salt = std::hash<std::string>()(rec.place);
+      break;
+   }
+
+   for (const std::string &code : rec.codes)
+   {
+      uint64_t key = std::hash<std::string>()(code);
+      key ^= salt * 0x9E3779B97F4A7C15ull + (key << 6) + (key >> 2);
+      entries.push_back(BlockEntry{ key, rec.birthDay, record });
+   }
+}
+
+std::vector<DuplicateFinder::Candidate> DuplicateFinder::compareBlocks(const std::vector<BlockEntry> *entries,
+                                                                       const std::vector<size_t> *bounds,
+                                                                       size_t first, size_t last, double minScore) const
+{
+   std::vector<Candidate> found;
+   for (size_t block = first; block < last; block++)
+   {
+      size_t begin = (*bounds)[block], end = (*bounds)[block + 1];
+      for (size_t i = begin; i < end; i++)
+      {
+         size_t stop = std::min(end, i + 1 + DUPLICATE_WINDOW);
+         for (size_t j = i + 1; j < stop; j++)
+         {
+            int a = (*entries)[i].record, b = (*entries)[j].record;
+            double s = score(a, b, minScore);
+            if (s >= minScore)
+               found.push_back(Candidate{ std::min(a, b), std::max(a, b), s });
+         }
+      }
+   }
+   return found;
+}
+
+std::vector<DuplicateFinder::Suggestion> DuplicateFinder::find(double minScore, int threads) const
+{
+   if (threads <= 0)
+      threads = QThread::idealThreadCount();
+   QThreadPool pool;
+   pool.setMaxThreadCount(threads);
+
+   std::vector<Candidate> candidates;
+   std::vector<BlockEntry> entries;
+   std::vector<size_t> bounds;
+   size_t compared = 0;
+
+   for (int pass = 0; pass < PASS_COUNT; pass++)
+   {
+      entries.clear();
+      for (size_t i = 0; i < _records.size(); i++)
+         appendEntries(static_cast<int>(i), pass, entries);
+      std::sort(entries.begin(), entries.end(), [](const BlockEntry &x, const BlockEntry &y)
+      {
+         if (x.key != y.key)
+            return x.key < y.key;
+         if (x.order != y.order)
+            return x.order < y.order;
+         return x.record < y.record;
+      });
+
+      // Одиночки выбрасываются, блоки остаются подряд: блок k - [bounds[k], bounds[k + 1])
+      bounds.assign(1, 0);
+      size_t kept = 0;
+      for (size_t i = 0; i < entries.size(); )
+      {
+         size_t j = i + 1;
+         while ((j < entries.size()) && (entries[j].key == entries[i].key))
+            j++;
+         if (j - i > 1)
+         {
+            std::move(entries.begin() + i, entries.begin() + j, entries.begin() + kept);
+            kept += j - i;
+            bounds.push_back(kept);
+         }
+         i = j;
+      }
+      entries.resize(kept);
+
+      // Задачи по DUPLICATE_TASK_PAIRS сравнений
+      std::vector<QFuture<std::vector<Candidate>>> futures;
+      size_t first = 0, pairs = 0;
+      size_t blocks = bounds.size() - 1;
+      for (size_t block = 0; block < blocks; block++)
+      {
+         size_t size = bounds[block + 1] - bounds[block];
+         pairs += size * std::min(size - 1, static_cast<size_t>(DUPLICATE_WINDOW));
+         if ((pairs >= DUPLICATE_TASK_PAIRS) || (block + 1 == blocks))
+         {
+            futures.push_back(QtConcurrent::run(&pool, this, &DuplicateFinder::compareBlocks, &entries, &bounds,
+                                                first, block + 1, minScore));
+            compared += pairs;
+            first = block + 1;
+            pairs = 0;
+         }
+      }
+      for (QFuture<std::vector<Candidate>> &future : futures)
+      {
+         std::vector<Candidate> found = future.result();
+         candidates.insert(candidates.end(), found.begin(), found.end());
+      }
+   }
+
+   // Одна пара могла попасть в несколько блоков
+   std::sort(candidates.begin(), candidates.end(), [](const Candidate &x, const Candidate &y)
+   {
+      return (x.a != y.a) ? (x.a < y.a) : (x.b < y.b);
+   });
+   candidates.erase(std::unique(candidates.begin(), candidates.end(), [](const Candidate &x, const Candidate &y)
+   {
+      return (x.a == y.a) && (x.b == y.b);
+   }), candidates.end());
+   std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate &x, const Candidate &y)
+   {
+      return x.score > y.score;
+   });
+
+   std::vector<Suggestion> suggestions;
+   suggestions.reserve(candidates.size());
+   for (const Candidate &c : candidates)
+   {
+      const Record &ra = _records[c.a];
+      const Record &rb = _records[c.b];
+      suggestions.push_back(Suggestion{ _tables[ra.table], ra.id, _tables[rb.table], rb.id, c.score });
+   }
+
+   writeDebugLog(QString("DuplicateFinder::find ") + QString::number(compared) + " pairs compared, "
+                 + QString::number(suggestions.size()) + " suggestions");
+   return suggestions;
+}
+
+#endif
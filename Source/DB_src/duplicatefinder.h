@@ -0,0 +1,111 @@
+/*
+ * Поиск дублей людей после слияния GEDCOM и между деревьями.
+ * Сравнивать всех со всеми - O(n²), поэтому пары-кандидаты берутся только внутри блоков
+ * с общим ключом. Порядок слов в имени разный ("Иванов Иван" из программы, "Иван Петрович Иванов"
+ * из GEDCOM без косых черт у фамилии), поэтому ключ строится от фонетического кода каждого слова
+ * имени (PhoneticKey):
+ *  - код слова + интервал года рождения (две сетки со сдвигом на полинтервала,
+ *    чтобы соседние годы на границе интервала не разошлись по разным блокам);
+ *  - код слова + место рождения - для тех, у кого год не указан или записан с ошибкой.
+ * По имени и отчеству находятся и дубли со сменившейся после замужества фамилией.
+ * Большой блок (Иванов, 1900-1903) сортируется по дате рождения, и каждый сравнивается
+ * только с DUPLICATE_WINDOW следующими. Пара оценивается взвешенной суммой сходства
+ * имени, дат, места и имён родителей по тем полям, что известны у обоих.
+ * Блоки делятся на задачи и сравниваются в пуле потоков.
+ */
+
+#ifdef DATABASE
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "db.h"
+
+#define DUPLICATE_YEAR_BUCKET   4       // лет в интервале блока
+#define DUPLICATE_WINDOW        32      // соседей по дате рождения в большом блоке
+#define DUPLICATE_TASK_PAIRS    65536   // сравнений на задачу пула
+#define DUPLICATE_MIN_SCORE     0.85
+
+class DuplicateFinder
+{
+public:
+   struct Suggestion
+   {
+      std::string tableA;
+      uint32_t idA;
+      std::string tableB;
+      uint32_t idB;
+      double score;
+   };
+
+   DuplicateFinder();
+
+   // threads: 0 - по числу ядер
+   int build(DB &db, int threads = 0);
+   void clear();
+   int recordCount() const { return static_cast<int>(_records.size()); }
+
+   // По убыванию оценки
+   std::vector<Suggestion> find(double minScore = DUPLICATE_MIN_SCORE, int threads = 0) const;
+
+   static double jaroWinkler(const std::string &a, const std::string &b);
+
+private:
+   enum BlockPass
+   {
+      PASS_WORD_YEAR,
+      PASS_WORD_YEAR_SHIFTED,
+      PASS_WORD_PLACE,
+      PASS_COUNT
+   };
+
+   struct Record
+   {
+      int table;
+      uint32_t id;
+      size_t identity;                 // хеш ComponentIndex::identityKey, 0 - не опознаётся
+      std::vector<std::string> words;  // слова имени латиницей
+      std::vector<std::string> codes;  // различные фонетические коды слов
+      std::string place;               // первая часть места рождения латиницей
+      int birthYear;                   // 0 - неизвестен
+      int birthDay;                    // порядковый день, 0 - неизвестен
+      int deathYear;
+      int deathDay;
+      int8_t sex;                      // PersonSex
+      int father;                      // индекс в _records, -1 - нет
+      int mother;
+   };
+
+   struct BlockEntry
+   {
+      uint64_t key;
+      int order;
+      int record;
+   };
+
+   struct Candidate
+   {
+      int a;
+      int b;
+      double score;
+   };
+
+   static void normalize(const PersonRow &row, Record &rec);
+   static void parseDate(const std::string &date, int &year, int &day);
+   static double nameSimilarity(const std::vector<std::string> &a, const std::vector<std::string> &b);
+   static double dateSimilarity(int yearA, int dayA, int yearB, int dayB);
+
+   void appendEntries(int record, int pass, std::vector<BlockEntry> &entries) const;
+   // Ниже minScore может вернуть 0, не досчитав
+   double score(int a, int b, double minScore) const;
+   std::vector<Candidate> compareBlocks(const std::vector<BlockEntry> *entries, const std::vector<size_t> *bounds,
+                                        size_t first, size_t last, double minScore) const;
+
+   std::vector<std::string> _tables;
+   std::vector<Record> _records;
+};
+
+#endif
@@ -0,0 +1,429 @@
+#ifdef DATABASE
+
+#include "gedcomexporter.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <QSaveFile>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDate>
+
+#include "writelog.h"
+
+static const char *MONTHS[12] = { "JAN", "FEB", "MAR", "APR", "MAY", "JUN", "JUL", "AUG", "SEP", "OCT", "NOV", "DEC" };
+
+// Буферизованная запись строк GEDCOM: длинные значения режутся на CONC, переводы строк - на CONT
+class GedcomExporter::Writer
+{
+public:
+   explicit Writer(QSaveFile &file)
+      : m_file(file),
+      m_ok(true)
+   {
+      m_buffer.reserve(GEDCOM_WRITE_BUFFER);
+   }
+
+   void line(int level, const char *tag, const char *value = nullptr, int length = -1)
+   {
+      if (value && (length < 0))
+         length = static_cast<int>(strlen(value));
+
+      int part = value ? split(value, length) : 0;
+      put(level, tag, value, part);
+      while (part < length)
+      {
+         value += part;
+         length -= part;
+         part = split(value, length);
+         put(level + 1, "CONC", value, part);
+      }
+   }
+
+   void line(int level, const char *tag, const std::string &value)
+   {
+      line(level, tag, value.data(), static_cast<int>(value.size()));
+   }
+
+   // Многострочный текст (NOTE): каждая следующая строка - CONT
+   void text(int level, const char *tag, const char *value)
+   {
+      const char *eol = strchr(value, '\n');
+      line(level, tag, value, eol ? static_cast<int>(eol - value) : -1);
+      while (eol)
+      {
+         value = eol + 1;
+         eol = strchr(value, '\n');
+         int length = eol ? static_cast<int>(eol - value) : static_cast<int>(strlen(value));
+         if (length && (value[length - 1] == '\r'))
+            length--;
+         line(level + 1, "CONT", value, length);
+      }
+   }
+
+   bool flush()
+   {
+      if (!m_buffer.empty())
+      {
+         qint64 size = static_cast<qint64>(m_buffer.size());
+         m_ok = m_ok && (m_file.write(m_buffer.data(), size) == size);
+         m_buffer.clear();
+      }
+      return m_ok;
+   }
+
+private:
+   void put(int level, const char *tag, const char *value, int length)
+   {
+      char prefix[8];
+      int n = snprintf(prefix, sizeof(prefix), "%d ", level);
+      m_buffer.append(prefix, n);
+      m_buffer.append(tag);
+      if (length > 0)
+      {
+         m_buffer += ' ';
+         m_buffer.append(value, length);
+      }
+      m_buffer += "\r\n";
+      if (m_buffer.size() >= GEDCOM_WRITE_BUFFER)
+         flush();
+   }
+
+   // Не режет посреди символа UTF-8
+   static int split(const char *value, int length)
+   {
+      if (length <= GEDCOM_LINE_LIMIT)
+         return length;
+      int part = GEDCOM_LINE_LIMIT;
+      while ((part > 1) && ((static_cast<unsigned char>(value[part]) & 0xC0) == 0x80))
+         part--;
+      return part;
+   }
+
+   QSaveFile &m_file;
+   std::string m_buffer;
+   bool m_ok;
+};
+
+// Ссылка на родителя, которого нет в таблице, считается пустой, иначе FAM указывал бы в никуда
+static std::string parentColumn(const char *column, const std::string &tableName)
+{
+   return std::string("(CASE WHEN ") + column + " > 0 AND " + column + " IN (SELECT ID FROM " + tableName
+         + ") THEN " + column + " ELSE 0 END)";
+}
+
+static sqlite3_stmt *prepare(DB &db, const std::string &request)
+{
+   sqlite3_stmt *stmt = nullptr;
+   if (sqlite3_prepare_v2(db._db, request.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+   {
+      writeDebugLog("GedcomExporter Prepare failed");
+      db.databaseError();
+      sqlite3_finalize(stmt);
+      return nullptr;
+   }
+   return stmt;
+}
+
+static const char *columnText(sqlite3_stmt *stmt, int column)
+{
+   const char *text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+   return text ? text : "";
+}
+
+GedcomExporter::GedcomExporter()
+   : _personCount(0),
+   _familyCount(0)
+{
+
+}
+
+int GedcomExporter::exportTree(DB &db, const std::string &tableName, const QString &fileName, bool withPhotos)
+{
+   writeDebugLog("GedcomExporter::exportTree " + QString::fromStdString(tableName) + " -> " + fileName);
+
+   _personCount = 0;
+   _familyCount = 0;
+   _mediaDir.clear();
+   _mediaName.clear();
+   if (withPhotos)
+   {
+      QFileInfo info(fileName);
+      _mediaName = info.completeBaseName() + "_media";
+      _mediaDir = info.absoluteDir().filePath(_mediaName);
+   }
+
+   QSaveFile file(fileName);
+   if (!file.open(QIODevice::WriteOnly))
+   {
+      writeDebugLog("GedcomExporter::exportTree Could not open " + fileName);
+      return -1;
+   }
+
+   Writer out(file);
+   out.line(0, "HEAD");
+   out.line(1, "SOUR", "FamilyTree");
+   out.line(1, "DATE", convertDate(QDate::currentDate().toString("dd.MM.yyyy").toLatin1().constData()));
+   out.line(1, "GEDC");
+   out.line(2, "VERS", "5.5.1");
+   out.line(2, "FORM", "LINEAGE-LINKED");
+   out.line(1, "CHAR", "UTF-8");
+
+   // Все курсоры читают один снимок базы
+   db.beginTransaction(db._db);
+   int ret = writePersons(db, tableName, out);
+   if (!ret)
+      ret = writeFamilies(db, tableName, out);
+   db.endTransaction(db._db);
+
+   out.line(0, "TRLR");
+   if (ret || !out.flush() || !file.commit())
+   {
+      writeDebugLog("GedcomExporter::exportTree Export failed: " + file.errorString());
+      file.cancelWriting();
+      return ret ? ret : -1;
+   }
+   return 0;
+}
+
+int GedcomExporter::writePersons(DB &db, const std::string &tableName, Writer &out)
+{
+   std::string father = parentColumn("FATHERID", tableName);
+   std::string mother = parentColumn("MOTHERID", tableName);
+
+   // Ключи сортируются отдельно от строк, чтобы фото не гонялись через сортировку
+   sqlite3_stmt *keys = prepare(db, "SELECT ENTRYID, ID, " + father + ", " + mother + " FROM " + tableName
+                                + " ORDER BY ID, ENTRYID");
+   sqlite3_stmt *row = prepare(db, "SELECT NAME, DATEOFBIRTH, ISALIVE, DATEOFDEATH, INFO, BIRTHPLACE, PHOTO, SEX FROM "
+                               + tableName + " WHERE ENTRYID = ?");
+   // Семьи, где человек - отец, и где мать, в порядке его ID
+   sqlite3_stmt *asFather = prepare(db, "SELECT DISTINCT F, M FROM (SELECT " + father + " AS F, " + mother + " AS M FROM "
+                                    + tableName + ") WHERE F > 0 ORDER BY F, M");
+   sqlite3_stmt *asMother = prepare(db, "SELECT DISTINCT M, F FROM (SELECT " + father + " AS F, " + mother + " AS M FROM "
+                                    + tableName + ") WHERE M > 0 ORDER BY M, F");
+
+   int ret = (keys && row && asFather && asMother) ? 0 : -1;
+   int fatherState = asFather ? sqlite3_step(asFather) : SQLITE_DONE;
+   int motherState = asMother ? sqlite3_step(asMother) : SQLITE_DONE;
+
+   while (!ret)
+   {
+      int s = sqlite3_step(keys);
+      if (s == SQLITE_DONE)
+         break;
+      if (s != SQLITE_ROW)
+      {
+         ret = s;
+         break;
+      }
+
+      int id = sqlite3_column_int(keys, 1);
+      sqlite3_bind_int64(row, 1, sqlite3_column_int64(keys, 0));
+      s = sqlite3_step(row);
+      if (s != SQLITE_ROW)
+      {
+         ret = s;
+         break;
+      }
+
+      char xref[24];
+      snprintf(xref, sizeof(xref), "@I%d@", id);
+      out.line(0, xref, "INDI");
+
+      const char *name = columnText(row, 0);
+      out.line(1, "NAME", *name ? convertName(name) : std::string("Unknown"));
+
+      static const char *SEXES[SEX_COUNT] = { "U", "M", "F" };
+      out.line(1, "SEX", SEXES[Person::sexOf(std::string(columnText(row, 7)))]);
+
+      std::string birthDate = convertDate(columnText(row, 1));
+      const char *birthPlace = columnText(row, 5);
+      if (!birthDate.empty() || *birthPlace)
+      {
+         out.line(1, "BIRT");
+         if (!birthDate.empty())
+            out.line(2, "DATE", birthDate);
+         if (*birthPlace)
+            out.line(2, "PLAC", birthPlace);
+      }
+
+      std::string deathDate = convertDate(columnText(row, 3));
+      if (!deathDate.empty())
+      {
+         out.line(1, "DEAT");
+         out.line(2, "DATE", deathDate);
+      }
+      else if (!strcmp(columnText(row, 2), "Dead"))
+         out.line(1, "DEAT", "Y");
+
+      const char *info = columnText(row, 4);
+      if (*info)
+         out.text(1, "NOTE", info);
+
+      if (!_mediaDir.isEmpty())
+      {
+         std::string photo = savePhoto(reinterpret_cast<const char*>(sqlite3_column_text(row, 6)), sqlite3_column_bytes(row, 6), id);
+         if (!photo.empty())
+         {
+            out.line(1, "OBJE");
+            out.line(2, "FILE", photo);
+            out.line(3, "FORM", photo.substr(photo.rfind('.') + 1));
+         }
+      }
+
+      int f = sqlite3_column_int(keys, 2);
+      int m = sqlite3_column_int(keys, 3);
+      if (f || m)
+         out.line(1, "FAMC", familyXref(f, m));
+
+      while ((fatherState == SQLITE_ROW) && (sqlite3_column_int(asFather, 0) <= id))
+      {
+         if (sqlite3_column_int(asFather, 0) == id)
+            out.line(1, "FAMS", familyXref(id, sqlite3_column_int(asFather, 1)));
+         fatherState = sqlite3_step(asFather);
+      }
+      while ((motherState == SQLITE_ROW) && (sqlite3_column_int(asMother, 0) <= id))
+      {
+         if (sqlite3_column_int(asMother, 0) == id)
+            out.line(1, "FAMS", familyXref(sqlite3_column_int(asMother, 1), id));
+         motherState = sqlite3_step(asMother);
+      }
+
+      sqlite3_reset(row);
+      _personCount++;
+   }
+
+   if (ret)
+      db.databaseError();
+   sqlite3_finalize(keys);
+   sqlite3_finalize(row);
+   sqlite3_finalize(asFather);
+   sqlite3_finalize(asMother);
+   return ret;
+}
+
+int GedcomExporter::writeFamilies(DB &db, const std::string &tableName, Writer &out)
+{
+   // Дети одной пары родителей идут подряд - одна запись FAM на серию
+   sqlite3_stmt *stmt = prepare(db, "SELECT F, M, ID FROM (SELECT ID, " + parentColumn("FATHERID", tableName) + " AS F, "
+                                + parentColumn("MOTHERID", tableName) + " AS M FROM " + tableName
+                                + ") WHERE F > 0 OR M > 0 ORDER BY F, M, ID");
+   if (!stmt)
+      return -1;
+
+   int ret = 0;
+   int father = 0, mother = 0;
+   bool open = false;
+   while (true)
+   {
+      int s = sqlite3_step(stmt);
+      if (s == SQLITE_DONE)
+         break;
+      if (s != SQLITE_ROW)
+      {
+         db.databaseError();
+         ret = s;
+         break;
+      }
+
+      int f = sqlite3_column_int(stmt, 0);
+      int m = sqlite3_column_int(stmt, 1);
+      if (!open || (f != father) || (m != mother))
+      {
+         father = f;
+         mother = m;
+         open = true;
+
+         char ref[24];
+         out.line(0, familyXref(f, m).c_str(), "FAM");
+         if (f)
+         {
+            snprintf(ref, sizeof(ref), "@I%d@", f);
+            out.line(1, "HUSB", ref);
+         }
+         if (m)
+         {
+            snprintf(ref, sizeof(ref), "@I%d@", m);
+            out.line(1, "WIFE", ref);
+         }
+         _familyCount++;
+      }
+
+      char child[24];
+      snprintf(child, sizeof(child), "@I%d@", sqlite3_column_int(stmt, 2));
+      out.line(1, "CHIL", child);
+   }
+
+   sqlite3_finalize(stmt);
+   return ret;
+}
+
+std::string GedcomExporter::savePhoto(const char *base64, int length, int id)
+{
+   if (!base64 || (length <= 0))
+      return std::string();
+
+   QByteArray data = QByteArray::fromBase64(QByteArray::fromRawData(base64, length));
+   const char *ext = "jpg";
+   if (data.startsWith("\x89PNG"))
+      ext = "png";
+   else if (data.startsWith("GIF8"))
+      ext = "gif";
+   else if (data.startsWith("BM"))
+      ext = "bmp";
+
+   if (!QDir().mkpath(_mediaDir))
+      return std::string();
+
+   QString name = QString("%1.%2").arg(id).arg(ext);
+   QFile file(QDir(_mediaDir).filePath(name));
+   if (!file.open(QIODevice::WriteOnly) || (file.write(data) != data.size()))
+   {
+      writeDebugLog("GedcomExporter::savePhoto Could not write " + file.fileName());
+      return std::string();
+   }
+   return (_mediaName + '/' + name).toStdString();
+}
+
+std::string GedcomExporter::convertDate(const char *date)
+{
+   // В базе даты хранятся как dd.MM.yyyy
+   int day = 0, month = 0, year = 0;
+   if (sscanf(date, "%d.%d.%d", &day, &month, &year) != 3)
+      return std::string();
+   if ((month < 1) || (month > 12) || (year <= 0))
+      return std::string();
+
+   char buffer[24];
+   if (day > 0)
+      snprintf(buffer, sizeof(buffer), "%d %s %d", day, MONTHS[month - 1], year);
+   else
+      snprintf(buffer, sizeof(buffer), "%s %d", MONTHS[month - 1], year);
+   return buffer;
+}
+
+std::string GedcomExporter::convertName(const char *name)
+{
+   // Фамилия - первое слово, как во всей программе; одно слово остаётся как есть
+   std::string full(name);
+   size_t first = full.find_first_not_of(' ');
+   if (first == std::string::npos)
+      return std::string();
+   size_t space = full.find(' ', first);
+   size_t given = (space != std::string::npos) ? full.find_first_not_of(' ', space) : std::string::npos;
+   if (given == std::string::npos)
+      return full.substr(first);
+   size_t last = full.find_last_not_of(' ');
+   return full.substr(given, last + 1 - given) + " /" + full.substr(first, space - first) + "/";
+}
+
+std::string GedcomExporter::familyXref(int father, int mother)
+{
+   char buffer[32];
+   snprintf(buffer, sizeof(buffer), "@F%d_%d@", father, mother);
+   return buffer;
+}
+
+#endif
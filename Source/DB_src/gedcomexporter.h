@@ -0,0 +1,53 @@
+/*
+ * Экспорт дерева из базы в GEDCOM 5.5.1 без загрузки людей в память.
+ * Строки таблицы читаются курсорами SQLite в порядке ID и сразу пишутся через буфер в файл.
+ * Семья - это пара (отец, мать) из FATHERID/MOTHERID: записи FAM строятся на лету
+ * из отдельного запроса, упорядоченного по паре родителей, а ссылки FAMS у INDI
+ * получаются слиянием с двумя такими же упорядоченными курсорами.
+ * Сортировку делает SQLite (при нехватке памяти - во временных файлах),
+ * поэтому память экспорта не зависит от размера дерева.
+ * Фото сохраняются рядом с файлом в папке <имя>_media и указываются в OBJE/FILE.
+ */
+
+#ifdef DATABASE
+
+#pragma once
+
+#include <string>
+
+#include <QString>
+
+#include "db.h"
+
+#define GEDCOM_WRITE_BUFFER     (1024 * 1024)
+#define GEDCOM_LINE_LIMIT       240     // байт значения в строке, остаток уходит в CONC
+
+class GedcomExporter
+{
+public:
+   GedcomExporter();
+
+   int exportTree(DB &db, const std::string &tableName, const QString &fileName, bool withPhotos = true);
+
+   int personCount() const { return _personCount; }
+   int familyCount() const { return _familyCount; }
+
+private:
+   class Writer;
+
+   int writePersons(DB &db, const std::string &tableName, Writer &out);
+   int writeFamilies(DB &db, const std::string &tableName, Writer &out);
+   std::string savePhoto(const char *base64, int length, int id);
+
+   static std::string convertDate(const char *date);
+   // "Фамилия Имя Отчество" -> "Имя Отчество /Фамилия/"
+   static std::string convertName(const char *name);
+   static std::string familyXref(int father, int mother);
+
+   QString _mediaDir;        // пусто - фото не выгружаются
+   QString _mediaName;
+   int _personCount;
+   int _familyCount;
+};
+
+#endif
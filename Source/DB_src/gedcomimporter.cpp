@@ -0,0 +1,231 @@
+#ifdef DATABASE
+
+#include "gedcomimporter.h"
+
+#include <cstdlib>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDate>
+
+#include "writelog.h"
+
+GedcomImporter::GedcomImporter()
+   : _firstId(0),
+   _personCount(0),
+   _familyCount(0)
+{
+
+}
+
+int GedcomImporter::nodeOf(const std::string &xref)
+{
+   auto it = _nodes.emplace(xref, static_cast<int>(_isPerson.size()));
+   if (it.second)
+   {
+      _isPerson.push_back(0);
+      _father.push_back(-1);
+      _mother.push_back(-1);
+   }
+   return it.first->second;
+}
+
+int GedcomImporter::findNode(const std::string &xref) const
+{
+   auto it = _nodes.find(xref);
+   if ((it == _nodes.end()) || !_isPerson[it->second])
+      return -1;
+   return it->second;
+}
+
+uint32_t GedcomImporter::idOf(int node) const
+{
+   return (node >= 0) ? _firstId + static_cast<uint32_t>(node) : static_cast<uint32_t>(-1);
+}
+
+int GedcomImporter::import(DB &db, const QString &fileName, const std::string &rootName, const std::string &tableName)
+{
+   writeDebugLog("GedcomImporter::import " + fileName);
+
+   _nodes.clear();
+   _isPerson.clear();
+   _father.clear();
+   _mother.clear();
+   _personCount = 0;
+   _familyCount = 0;
+
+   int ret = indexPass(fileName);
+   if (ret)
+      return ret;
+   buildChildren();
+
+   // ID продолжают сквозную нумерацию сеанса
+   _firstId = Person::global_id + 1;
+   Person::global_id += static_cast<uint32_t>(_isPerson.size());
+
+   ret = db.createRoot(rootName, tableName);
+   if (ret)
+   {
+      writeDebugLog("GedcomImporter::import Could not create tree " + QString::fromStdString(tableName));
+      return ret;
+   }
+
+   // Пачки фиксируются по отдельности: при ошибке недозагруженное дерево убирается целиком
+   ret = loadPass(db, fileName, tableName);
+   if (ret)
+   {
+      writeDebugLog("GedcomImporter::import Removing incomplete tree " + QString::fromStdString(tableName));
+      db.removeRoot(tableName);
+   }
+   return ret;
+}
+
+int GedcomImporter::indexPass(const QString &fileName)
+{
+   GedcomParser parser;
+   parser.onRecord = [this](const GedcomRecord &record)
+   {
+      if (record.type == GedcomRecord::INDI)
+      {
+         _isPerson[nodeOf(record.xref)] = 1;
+         _personCount++;
+      }
+      else if (record.type == GedcomRecord::FAM)
+      {
+         _familyCount++;
+         int husband = record.husband.empty() ? -1 : nodeOf(record.husband);
+         int wife = record.wife.empty() ? -1 : nodeOf(record.wife);
+
+         // Ребёнок из нескольких семей (усыновление) остаётся в первой
+         for (const std::string &child : record.children)
+         {
+            int node = nodeOf(child);
+            if ((_father[node] < 0) && (_mother[node] < 0))
+            {
+               _father[node] = husband;
+               _mother[node] = wife;
+            }
+         }
+      }
+   };
+
+   int ret = parser.parseFile(fileName, 0);
+   if (parser.errorCount())
+      writeDebugLog(QString("GedcomImporter::indexPass Malformed lines: %1").arg(parser.errorCount()));
+   return ret;
+}
+
+void GedcomImporter::buildChildren()
+{
+   // Ссылки на отсутствующие INDI отбрасываются
+   int n = static_cast<int>(_isPerson.size());
+   for (int i = 0; i < n; i++)
+   {
+      if ((_father[i] >= 0) && !_isPerson[_father[i]])
+         _father[i] = -1;
+      if ((_mother[i] >= 0) && !_isPerson[_mother[i]])
+         _mother[i] = -1;
+   }
+
+   _childStart.assign(n + 1, 0);
+   for (int i = 0; i < n; i++)
+   {
+      if (_father[i] >= 0)
+         _childStart[_father[i] + 1]++;
+      if ((_mother[i] >= 0) && (_mother[i] != _father[i]))
+         _childStart[_mother[i] + 1]++;
+   }
+   for (int i = 0; i < n; i++)
+      _childStart[i + 1] += _childStart[i];
+
+   _childList.resize(_childStart[n]);
+   std::vector<int> fill(_childStart.begin(), _childStart.end() - 1);
+   for (int i = 0; i < n; i++)
+   {
+      if (_father[i] >= 0)
+         _childList[fill[_father[i]]++] = i;
+      if ((_mother[i] >= 0) && (_mother[i] != _father[i]))
+         _childList[fill[_mother[i]]++] = i;
+   }
+}
+
+std::string GedcomImporter::loadPhoto(const QString &baseDir, const std::string &path) const
+{
+   if (path.empty())
+      return std::string();
+
+   // Пути в GEDCOM обычно относительно самого файла
+   QFileInfo info(QDir(baseDir), QString::fromStdString(path));
+   if (!info.isFile() || (info.size() > GEDCOM_MAX_PHOTO_SIZE))
+      return std::string();
+
+   QFile file(info.filePath());
+   if (!file.open(QIODevice::ReadOnly))
+      return std::string();
+   return file.readAll().toBase64().toStdString();
+}
+
+int GedcomImporter::loadPass(DB &db, const QString &fileName, const std::string &tableName)
+{
+   QString baseDir = QFileInfo(fileName).absolutePath();
+   int lastAliveYear = QDate::currentDate().year() - GEDCOM_MAX_AGE;
+
+   std::vector<PersonRow> rows;
+   rows.reserve(GEDCOM_BATCH_SIZE);
+   int ret = 0;
+
+   GedcomParser parser;
+   parser.onRecord = [&](const GedcomRecord &record)
+   {
+      if (ret || (record.type != GedcomRecord::INDI))
+         return;
+      int node = findNode(record.xref);
+      if (node < 0)
+         return;
+
+      PersonRow row;
+      row.id = idOf(node);
+      row.name = record.name;
+      row.birthDate = record.birthDate;
+      bool dead = record.dead || !record.deathDate.empty()
+            || (!record.birthDate.empty() && (atoi(record.birthDate.c_str() + 6) < lastAliveYear));
+      row.isAlive = dead ? "Dead" : "Alive";
+      row.deathDate = record.deathDate;
+      row.info = record.info;
+      row.birthPlace = record.birthPlace;
+      row.photo = loadPhoto(baseDir, record.photo);
+      row.sex = record.sex;
+      row.fatherId = idOf(_father[node]);
+      row.motherId = idOf(_mother[node]);
+      row.childrenCnt = static_cast<uint32_t>(_childStart[node + 1] - _childStart[node]);
+      for (int k = _childStart[node]; k < _childStart[node + 1]; k++)
+      {
+         if (!row.childrenID.empty())
+            row.childrenID += ' ';
+         row.childrenID += std::to_string(idOf(_childList[k]));
+      }
+
+      // Имя в таблице обязательно
+      if (row.name.empty())
+         row.name = record.xref;
+
+      rows.push_back(std::move(row));
+      if (rows.size() >= GEDCOM_BATCH_SIZE)
+      {
+         ret = db.addPersons(tableName, rows);
+         rows.clear();
+      }
+   };
+
+   int parsed = parser.parseFile(fileName, 0);
+   if (!ret && !rows.empty())
+      ret = db.addPersons(tableName, rows);
+   if (parsed)
+      return parsed;
+   if (ret)
+      writeDebugLog("GedcomImporter::loadPass Bulk insert failed");
+   return ret;
+}
+
+#endif
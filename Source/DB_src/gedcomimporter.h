@@ -0,0 +1,56 @@
+/*
+ * Импорт GEDCOM в новое дерево базы.
+ * Два прохода по файлу с постоянной памятью на записи:
+ * первый собирает только ссылки (@I1@ -> номер) и родителей из FAM,
+ * второй снова читает INDI и сразу складывает готовые строки в пачки для DB::addPersons.
+ * В памяти держатся лишь массивы номеров, а не тексты, поэтому размер файла не важен.
+ */
+
+#ifdef DATABASE
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <QString>
+
+#include "db.h"
+#include "gedcomparser.h"
+
+#define GEDCOM_BATCH_SIZE       10000
+#define GEDCOM_MAX_PHOTO_SIZE   (16 * 1024 * 1024)
+#define GEDCOM_MAX_AGE          110     // без записи о смерти старше этого считается умершим
+
+class GedcomImporter
+{
+public:
+   GedcomImporter();
+
+   int import(DB &db, const QString &fileName, const std::string &rootName, const std::string &tableName);
+
+   int personCount() const { return _personCount; }
+   int familyCount() const { return _familyCount; }
+
+private:
+   int indexPass(const QString &fileName);
+   int loadPass(DB &db, const QString &fileName, const std::string &tableName);
+   void buildChildren();
+   int nodeOf(const std::string &xref);
+   int findNode(const std::string &xref) const;
+   uint32_t idOf(int node) const;
+   std::string loadPhoto(const QString &baseDir, const std::string &path) const;
+
+   std::unordered_map<std::string, int> _nodes;   // xref -> номер
+   std::vector<char> _isPerson;
+   std::vector<int> _father;
+   std::vector<int> _mother;
+   std::vector<int> _childStart;                  // дети в виде CSR
+   std::vector<int> _childList;
+   uint32_t _firstId;
+   int _personCount;
+   int _familyCount;
+};
+
+#endif
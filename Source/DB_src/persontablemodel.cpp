@@ -0,0 +1,199 @@
+#ifdef DATABASE
+
+#include "persontablemodel.h"
+
+#include "writelog.h"
+
+// Столбцы модели в порядке PersonSortColumn
+static const int SORT_OF_COLUMN[PersonTableModel::COLUMN_COUNT] = {
+   SORT_ID, SORT_NAME, SORT_BIRTH_DATE, SORT_DEATH_DATE, SORT_BIRTH_PLACE, SORT_SEX
+};
+
+static const char *COLUMN_TITLES[PersonTableModel::COLUMN_COUNT] = {
+   "ID", "ФИО", "Дата рождения", "Дата смерти", "Место рождения", "Пол"
+};
+
+PersonTableModel::PersonTableModel(DB *db, QObject *parent)
+   : QAbstractTableModel(parent), _db(db), _sortColumn(SORT_NAME), _descending(false), _total(0), _loaded(0)
+{
+
+}
+
+int PersonTableModel::setTable(const std::string &tableName)
+{
+   beginResetModel();
+   _tableName = tableName;
+   _anchors.clear();
+   _cache.clear();
+   _lru.clear();
+   _loaded = 0;
+   _total = 0;
+
+   int ret = (_db && !tableName.empty()) ? _db->countPersons(tableName, _total) : -1;
+   if (ret)
+      writeDebugLog(QString("PersonTableModel::setTable Failed to count ") + tableName.c_str());
+   endResetModel();
+
+   fetchMore(QModelIndex());
+   return ret;
+}
+
+void PersonTableModel::refresh()
+{
+   setTable(_tableName);
+}
+
+int PersonTableModel::rowCount(const QModelIndex &parent) const
+{
+   return parent.isValid() ? 0 : _loaded;
+}
+
+int PersonTableModel::columnCount(const QModelIndex &parent) const
+{
+   return parent.isValid() ? 0 : COLUMN_COUNT;
+}
+
+bool PersonTableModel::canFetchMore(const QModelIndex &parent) const
+{
+   return !parent.isValid() && (_loaded < _total);
+}
+
+void PersonTableModel::fetchMore(const QModelIndex &parent)
+{
+   if (!canFetchMore(parent))
+      return;
+
+   int number = static_cast<int>(_anchors.size());
+   PageAnchor after = number ? _anchors.back() : PageAnchor{ false, std::string(), 0 };
+   PersonPage next;
+   if (_db->getPersonPage(_tableName, _sortColumn, _descending, after, PERSON_PAGE_SIZE, next) || next.rows.empty())
+   {
+      // Таблица укоротилась или база недоступна - дальше не листаем
+      _total = _loaded;
+      return;
+   }
+
+   int count = static_cast<int>(next.rows.size());
+   beginInsertRows(QModelIndex(), _loaded, _loaded + count - 1);
+   _anchors.push_back(next.last);
+   storePage(number, std::move(next.rows));
+   _loaded += count;
+   if (count < PERSON_PAGE_SIZE)
+      _total = _loaded;
+   endInsertRows();
+}
+
+void PersonTableModel::sort(int column, Qt::SortOrder order)
+{
+   if ((column < 0) || (column >= COLUMN_COUNT))
+      return;
+
+   // Строки заново читаются в новом порядке
+   beginResetModel();
+   _sortColumn = SORT_OF_COLUMN[column];
+   _descending = (order == Qt::DescendingOrder);
+   _anchors.clear();
+   _cache.clear();
+   _lru.clear();
+   _loaded = 0;
+   if (_db && !_tableName.empty())
+      _db->countPersons(_tableName, _total);
+   endResetModel();
+
+   fetchMore(QModelIndex());
+}
+
+void PersonTableModel::storePage(int number, std::vector<PersonRow> &&rows) const
+{
+   auto it = _cache.find(number);
+   if (it != _cache.end())
+   {
+      _lru.erase(it->second.lru);
+      _cache.erase(it);
+   }
+
+   _lru.push_front(number);
+   CachedPage &cached = _cache[number];
+   cached.rows = std::move(rows);
+   cached.lru = _lru.begin();
+
+   while (_cache.size() > PERSON_CACHE_PAGES)
+   {
+      _cache.erase(_lru.back());
+      _lru.pop_back();
+   }
+}
+
+const std::vector<PersonRow> *PersonTableModel::page(int number) const
+{
+   auto it = _cache.find(number);
+   if (it != _cache.end())
+   {
+      _lru.splice(_lru.begin(), _lru, it->second.lru);
+      return &it->second.rows;
+   }
+
+   if ((number < 0) || (number >= static_cast<int>(_anchors.size())))
+      return nullptr;
+
+   // Вытесненная страница: читается от последней строки предыдущей
+   PageAnchor after = number ? _anchors[number - 1] : PageAnchor{ false, std::string(), 0 };
+   PersonPage loaded;
+   if (_db->getPersonPage(_tableName, _sortColumn, _descending, after, PERSON_PAGE_SIZE, loaded))
+   {
+      writeDebugLog(QString("PersonTableModel::page Failed to read page ") + QString::number(number));
+      return nullptr;
+   }
+   storePage(number, std::move(loaded.rows));
+   return &_cache[number].rows;
+}
+
+const PersonRow *PersonTableModel::rowAt(int row) const
+{
+   if ((row < 0) || (row >= _loaded))
+      return nullptr;
+   const std::vector<PersonRow> *rows = page(row / PERSON_PAGE_SIZE);
+   size_t offset = static_cast<size_t>(row % PERSON_PAGE_SIZE);
+   return (rows && (offset < rows->size())) ? &(*rows)[offset] : nullptr;
+}
+
+uint32_t PersonTableModel::personId(int row) const
+{
+   const PersonRow *pers = rowAt(row);
+   return pers ? pers->id : 0;
+}
+
+QVariant PersonTableModel::data(const QModelIndex &index, int role) const
+{
+   if (!index.isValid())
+      return QVariant();
+
+   const PersonRow *pers = rowAt(index.row());
+   if (!pers)
+      return QVariant();
+
+   if (role == Qt::UserRole)
+      return pers->id;
+   if (role != Qt::DisplayRole)
+      return QVariant();
+
+   switch (index.column())
+   {
+   case COLUMN_ID:          return pers->id;
+   case COLUMN_NAME:        return QString::fromStdString(pers->name);
+   case COLUMN_BIRTH_DATE:  return QString::fromStdString(pers->birthDate);
+   case COLUMN_DEATH_DATE:  return QString::fromStdString(pers->deathDate);
+   case COLUMN_BIRTH_PLACE: return QString::fromStdString(pers->birthPlace);
+   case COLUMN_SEX:         return QString::fromStdString(pers->sex);
+   default:                 return QVariant();
+   }
+}
+
+QVariant PersonTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+   if ((role != Qt::DisplayRole) || (orientation != Qt::Horizontal) || (section < 0) || (section >= COLUMN_COUNT))
+      return QAbstractTableModel::headerData(section, orientation, role);
+   return QString::fromUtf8(COLUMN_TITLES[section]);
+}
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * Таблица людей одного дерева для QTableView без загрузки всей таблицы в память.
+ * Строки подгружаются страницами по PERSON_PAGE_SIZE: представление само просит следующую
+ * страницу через canFetchMore/fetchMore, когда долистывает до конца. От каждой страницы
+ * запоминается только её последняя строка (PageAnchor), а сами строки держатся в кэше
+ * последних PERSON_CACHE_PAGES страниц; вытесненная страница при возврате к ней читается
+ * заново по якорю предыдущей - одним запросом по индексу, без OFFSET.
+ * Сортировка выполняется базой: ORDER BY по выражению, для которого заведён индекс.
+ */
+
+#ifdef DATABASE
+
+#pragma once
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <QAbstractTableModel>
+
+#include "db.h"
+
+#define PERSON_PAGE_SIZE     256
+#define PERSON_CACHE_PAGES   64
+
+class PersonTableModel : public QAbstractTableModel
+{
+   Q_OBJECT
+
+public:
+   enum Column
+   {
+      COLUMN_ID,
+      COLUMN_NAME,
+      COLUMN_BIRTH_DATE,
+      COLUMN_DEATH_DATE,
+      COLUMN_BIRTH_PLACE,
+      COLUMN_SEX,
+      COLUMN_COUNT
+   };
+
+   explicit PersonTableModel(DB *db, QObject *parent = nullptr);
+
+   int setTable(const std::string &tableName);
+   const std::string &tableName() const { return _tableName; }
+   // Перечитать с начала, например после правок в базе
+   void refresh();
+
+   int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+   int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+   QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+   QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+   bool canFetchMore(const QModelIndex &parent) const override;
+   void fetchMore(const QModelIndex &parent) override;
+   void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+   // id человека в строке, 0 - строка недоступна
+   uint32_t personId(int row) const;
+
+private:
+   struct CachedPage
+   {
+      std::vector<PersonRow> rows;
+      std::list<int>::iterator lru;
+   };
+
+   const std::vector<PersonRow> *page(int number) const;
+   void storePage(int number, std::vector<PersonRow> &&rows) const;
+   const PersonRow *rowAt(int row) const;
+
+   DB *_db;
+   std::string _tableName;
+   int _sortColumn;
+   bool _descending;
+   int64_t _total;
+   int _loaded;                              // строк отдано представлению
+
+   std::vector<PageAnchor> _anchors;         // последняя строка каждой загруженной страницы
+   mutable std::unordered_map<int, CachedPage> _cache;
+   mutable std::list<int> _lru;              // номера страниц, недавние в начале
+};
+
+#endif
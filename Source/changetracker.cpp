@@ -0,0 +1,196 @@
+#include "changetracker.h"
+
+#include <algorithm>
+
+#include <QFileInfo>
+
+#include "writelog.h"
+
+ChangeTracker::ChangeTracker()
+   : _generation(0)
+{
+
+}
+
+void ChangeTracker::markChanged(Person *pers, unsigned fields)
+{
+   if (!pers || !fields)
+      return;
+   _generation++;
+   auto it = _dirty.emplace(pers->id, Dirty{ pers, 0, false }).first;
+   it->second.pers = pers;
+   it->second.fields |= fields;
+}
+
+void ChangeTracker::markLinked(Person *parent, Person *child)
+{
+   markChanged(parent, FIELD_CHILDREN);
+   markChanged(child, FIELD_PARENTS);
+}
+
+void ChangeTracker::markAdded(Person *pers)
+{
+   if (!pers)
+      return;
+   _generation++;
+   Dirty &entry = _dirty[pers->id];
+   entry.pers = pers;
+   entry.fields = FIELD_ALL;
+
+   // Тот же id мог быть удалён в этой же серии правок (отмена удаления): запись в хранилище
+   // ещё есть, поэтому она переписывается целиком, а не вставляется второй раз
+   auto removed = std::find(_removed.begin(), _removed.end(), pers->id);
+   entry.added = (removed == _removed.end());
+   if (!entry.added)
+      _removed.erase(removed);
+}
+
+void ChangeTracker::markRemoved(Person *pers)
+{
+   if (!pers)
+      return;
+   _generation++;
+   auto it = _dirty.find(pers->id);
+   bool added = (it != _dirty.end()) && it->second.added;
+   if (it != _dirty.end())
+      _dirty.erase(it);
+
+   // Добавленного и тут же удалённого в хранилище ещё нет
+   if (!added)
+      _removed.push_back(pers->id);
+
+   // У родителей и детей удалённого меняются связи
+   if (pers->father)
+      markChanged(pers->father, FIELD_CHILDREN);
+   if (pers->mother)
+      markChanged(pers->mother, FIELD_CHILDREN);
+   for (Person *child : pers->children)
+      markChanged(child, FIELD_PARENTS);
+}
+
+void ChangeTracker::clear()
+{
+   _dirty.clear();
+   _removed.clear();
+}
+
+unsigned ChangeTracker::fieldsOf(const Person *pers) const
+{
+   auto it = pers ? _dirty.find(pers->id) : _dirty.end();
+   return (it != _dirty.end()) ? it->second.fields : 0;
+}
+
+QVector<Person*> ChangeTracker::dirtyPersons() const
+{
+   QVector<Person*> persons;
+   persons.reserve(static_cast<int>(_dirty.size()));
+   for (const auto &it : _dirty)
+      persons.append(it.second.pers);
+   std::sort(persons.begin(), persons.end(), [](const Person *a, const Person *b) { return a->id < b->id; });
+   return persons;
+}
+
+#ifdef DATABASE
+
+PersonRow ChangeTracker::rowOf(const Person *pers)
+{
+   PersonRow row;
+   row.id = pers->id;
+   row.name = pers->name.toStdString();
+   row.birthDate = pers->birthDate.toString("dd.MM.yyyy").toStdString();
+   row.isAlive = pers->bIsAlive ? "Alive" : "Dead";
+   row.deathDate = pers->deathDate.toString("dd.MM.yyyy").toStdString();
+   row.info = pers->info.toStdString();
+   row.birthPlace = pers->birthPlace.toStdString();
+   row.photo = pers->photoData.toBase64().toStdString();
+   row.sex = pers->sex.toStdString();
+   fillLinks(pers, row);
+   return row;
+}
+
+void ChangeTracker::fillLinks(const Person *pers, PersonRow &row)
+{
+   row.fatherId = pers->father ? pers->father->id : static_cast<uint32_t>(-1);
+   row.motherId = pers->mother ? pers->mother->id : static_cast<uint32_t>(-1);
+   row.childrenCnt = static_cast<uint32_t>(pers->children.size());
+   row.childrenID.clear();
+   for (const Person *child : pers->children)
+   {
+      if (!row.childrenID.empty())
+         row.childrenID += ' ';
+      row.childrenID += std::to_string(child->id);
+   }
+}
+
+int ChangeTracker::saveToDB(DB &db, const std::string &tableName) const
+{
+   if (isEmpty())
+      return 0;
+
+   // Строка собирается только из нужных полей: фото не перекодируется ради правки имени
+   PersonDelta delta;
+   delta.removed = _removed;
+   for (Person *pers : dirtyPersons())
+   {
+      const Dirty &entry = _dirty.at(pers->id);
+      if (entry.added)
+      {
+         delta.added.push_back(rowOf(pers));
+         continue;
+      }
+
+      PersonRow row;
+      row.id = pers->id;
+      row.fatherId = row.motherId = row.childrenCnt = 0;
+      if (entry.fields & FIELD_NAME)
+         row.name = pers->name.toStdString();
+      if (entry.fields & FIELD_BIRTH_DATE)
+         row.birthDate = pers->birthDate.toString("dd.MM.yyyy").toStdString();
+      if (entry.fields & FIELD_DEATH)
+      {
+         row.isAlive = pers->bIsAlive ? "Alive" : "Dead";
+         row.deathDate = pers->deathDate.toString("dd.MM.yyyy").toStdString();
+      }
+      if (entry.fields & FIELD_INFO)
+         row.info = pers->info.toStdString();
+      if (entry.fields & FIELD_BIRTH_PLACE)
+         row.birthPlace = pers->birthPlace.toStdString();
+      if (entry.fields & FIELD_PHOTO)
+         row.photo = pers->photoData.toBase64().toStdString();
+      if (entry.fields & FIELD_SEX)
+         row.sex = pers->sex.toStdString();
+      if (entry.fields & (FIELD_PARENTS | FIELD_CHILDREN))
+         fillLinks(pers, row);
+      delta.changed.push_back(row);
+      delta.changedFields.push_back(entry.fields);
+   }
+
+   int ret = db.savePersonDelta(tableName, delta);
+   if (ret)
+      writeDebugLog("ChangeTracker::saveToDB Delta save failed for " + QString::fromStdString(tableName));
+   return ret;
+}
+
+#endif
+
+int ChangeTracker::saveToFile(TreeWriter &writer, const QString &fileName, const QVector<Person*> &persons) const
+{
+   // Основного файла ещё нет - журналу не на что ложиться
+   QFileInfo base(fileName);
+   if (!base.exists())
+      return writer.write(fileName, persons);
+   if (isEmpty())
+      return 0;
+
+   int ret = writer.appendJournal(fileName, dirtyPersons(), _removed);
+   if (ret)
+      return ret;
+
+   qint64 journalSize = QFileInfo(TreeWriter::journalName(fileName)).size();
+   if ((journalSize > JOURNAL_COMPACT_MIN) && (journalSize > base.size() / JOURNAL_COMPACT_RATIO))
+   {
+      writeDebugLog(QString("ChangeTracker::saveToFile Compacting journal of %1 bytes").arg(journalSize));
+      ret = writer.write(fileName, persons);
+   }
+   return ret;
+}
@@ -0,0 +1,75 @@
+#ifndef CHANGETRACKER_H
+#define CHANGETRACKER_H
+
+/*
+ * Учёт правок дерева между сохранениями.
+ * Для каждого изменённого человека копится маска полей PersonField, отдельно - добавленные
+ * и удалённые. Сохранение пишет только это: в базу - UPDATE нужных столбцов, INSERT и DELETE
+ * одной транзакцией, в файл - пачку в журнал TreeWriter. Когда журнал разрастается
+ * относительно основного файла, дерево переписывается целиком и журнал исчезает.
+ * Так время сохранения зависит от размера правки, а не дерева.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <QString>
+#include <QVector>
+
+#include "person.h"
+#include "treewriter.h"
+#ifdef DATABASE
+#include "db.h"
+#endif
+
+#define JOURNAL_COMPACT_MIN     (1024 * 1024)   // меньше этого журнал не уплотняется
+#define JOURNAL_COMPACT_RATIO   2               // уплотнение, когда журнал > файл / RATIO
+
+class ChangeTracker
+{
+public:
+   ChangeTracker();
+
+   void markChanged(Person *pers, unsigned fields = FIELD_ALL);
+   // Связь родитель-ребёнок появилась или исчезла: у ребёнка меняются родители, у родителя дети
+   void markLinked(Person *parent, Person *child);
+   void markAdded(Person *pers);
+   void markRemoved(Person *pers);
+   void clear();
+
+   bool isEmpty() const { return _dirty.empty() && _removed.empty(); }
+   int size() const { return static_cast<int>(_dirty.size() + _removed.size()); }
+   unsigned fieldsOf(const Person *pers) const;
+   QVector<Person*> dirtyPersons() const;
+   const std::vector<uint32_t> &removedIds() const { return _removed; }
+   // Растёт с каждой правкой и не сбрасывается при сохранении: по нему кэши (TreeStatistics)
+   // узнают, что дерево изменилось
+   uint64_t generation() const { return _generation; }
+
+#ifdef DATABASE
+   int saveToDB(DB &db, const std::string &tableName) const;
+   static PersonRow rowOf(const Person *pers);
+#endif
+   // persons - всё дерево, нужно только при уплотнении
+   int saveToFile(TreeWriter &writer, const QString &fileName, const QVector<Person*> &persons) const;
+
+private:
+#ifdef DATABASE
+   static void fillLinks(const Person *pers, PersonRow &row);
+#endif
+
+   struct Dirty
+   {
+      Person *pers;
+      unsigned fields;
+      bool added;
+   };
+
+   std::unordered_map<uint32_t, Dirty> _dirty;   // по id
+   std::vector<uint32_t> _removed;
+   uint64_t _generation;
+};
+
+#endif // CHANGETRACKER_H
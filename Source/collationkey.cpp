@@ -0,0 +1,228 @@
+#include "collationkey.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+
+static const char LEVEL_SEPARATOR = 0x01;
+static const unsigned char WEIGHT_SPACE = 0x03;
+static const unsigned char WEIGHT_PUNCTUATION = 0x04;
+static const unsigned char WEIGHT_DIGIT = 0x28;
+static const unsigned char WEIGHT_CYRILLIC = 0x40;
+static const unsigned char WEIGHT_LATIN = 0x70;
+static const unsigned char WEIGHT_OTHER = 0xF0;
+static const unsigned char WEIGHT_PLAIN = 0x05;   // 2 и 3 уровень: без знака / строчная
+static const unsigned char WEIGHT_MARKED = 0x06;  // с диакритикой / прописная
+
+// Знаки в порядке сортировки, все раньше цифр и букв
+static const char PUNCTUATION[] = "_-,;:!?.'\"()[]{}@*/\\&#%`^+<=>|~$";
+
+// Кириллица по алфавиту вместе с украинскими и белорусскими буквами; ё - это е со знаком
+static const uint32_t CYRILLIC_ORDER[] = {
+   0x430, 0x431, 0x432, 0x433, 0x491, 0x434, 0x435, 0x454, 0x436, 0x437, 0x438, 0x456, 0x457,
+   0x439, 0x43A, 0x43B, 0x43C, 0x43D, 0x43E, 0x43F, 0x440, 0x441, 0x442, 0x443, 0x45E, 0x444,
+   0x445, 0x446, 0x447, 0x448, 0x449, 0x44A, 0x44B, 0x44C, 0x44D, 0x44E, 0x44F
+};
+
+// à..ÿ без диакритики; ÷ не буква, æ и ß раскладываются на две буквы отдельно
+static const char LATIN1_BASE[] = "aaaaaa?ceeeeiiiidnooooo?ouuuuyty";
+
+namespace
+{
+class KeyBuilder
+{
+public:
+   void add(unsigned char primary, bool marked, bool upper)
+   {
+      _primary += static_cast<char>(primary);
+      _secondary += static_cast<char>(marked ? WEIGHT_MARKED : WEIGHT_PLAIN);
+      _tertiary += static_cast<char>(upper ? WEIGHT_MARKED : WEIGHT_PLAIN);
+   }
+
+   void addOther(uint32_t cp)
+   {
+      // Неизвестные символы - после всех букв, по коду; байты не меньше 0x80
+      add(WEIGHT_OTHER, false, false);
+      _primary += static_cast<char>(0x80 | ((cp >> 14) & 0x7F));
+      _primary += static_cast<char>(0x80 | ((cp >> 7) & 0x7F));
+      _primary += static_cast<char>(0x80 | (cp & 0x7F));
+   }
+
+   std::string key()
+   {
+      // Хвост из весов по умолчанию не меняет порядка: короче - значит раньше, как и с ними
+      trim(_secondary);
+      trim(_tertiary);
+      std::string result;
+      result.reserve(_primary.size() + _secondary.size() + _tertiary.size() + 2);
+      result += _primary;
+      result += LEVEL_SEPARATOR;
+      result += _secondary;
+      result += LEVEL_SEPARATOR;
+      result += _tertiary;
+      return result;
+   }
+
+   bool empty() const { return _primary.empty(); }
+
+private:
+   static void trim(std::string &level)
+   {
+      size_t end = level.size();
+      while (end && (static_cast<unsigned char>(level[end - 1]) == WEIGHT_PLAIN))
+         end--;
+      level.resize(end);
+   }
+
+   std::string _primary;
+   std::string _secondary;
+   std::string _tertiary;
+};
+}
+
+static uint32_t nextCodePoint(const std::string &str, size_t &pos)
+{
+   unsigned char c = static_cast<unsigned char>(str[pos++]);
+   int extra = (c >= 0xF0) ? 3 : (c >= 0xE0) ? 2 : (c >= 0xC0) ? 1 : 0;
+   uint32_t cp = (extra == 3) ? (c & 0x07) : (extra == 2) ? (c & 0x0F) : (extra == 1) ? (c & 0x1F) : c;
+   for (int i = 0; (i < extra) && (pos < str.size()); i++)
+      cp = (cp << 6) | (static_cast<unsigned char>(str[pos++]) & 0x3F);
+   return cp;
+}
+
+static bool addCyrillic(KeyBuilder &builder, uint32_t cp)
+{
+   bool upper = false;
+   if ((cp >= 0x410) && (cp <= 0x42F))
+   {
+      cp += 0x20;
+      upper = true;
+   }
+   else if ((cp >= 0x400) && (cp <= 0x40F))
+   {
+      cp += 0x50;
+      upper = true;
+   }
+   else if (cp == 0x490)
+   {
+      cp = 0x491;
+      upper = true;
+   }
+
+   if (cp == 0x451)
+   {
+      builder.add(WEIGHT_CYRILLIC + 6, true, upper);   // ё на месте е
+      return true;
+   }
+   const uint32_t *end = CYRILLIC_ORDER + sizeof(CYRILLIC_ORDER) / sizeof(CYRILLIC_ORDER[0]);
+   const uint32_t *it = std::find(CYRILLIC_ORDER, end, cp);
+   if (it == end)
+      return false;
+   builder.add(static_cast<unsigned char>(WEIGHT_CYRILLIC + (it - CYRILLIC_ORDER)), false, upper);
+   return true;
+}
+
+static bool addLatin(KeyBuilder &builder, uint32_t cp)
+{
+   if ((cp >= 'a') && (cp <= 'z'))
+   {
+      builder.add(static_cast<unsigned char>(WEIGHT_LATIN + cp - 'a'), false, false);
+      return true;
+   }
+   if ((cp >= 'A') && (cp <= 'Z'))
+   {
+      builder.add(static_cast<unsigned char>(WEIGHT_LATIN + cp - 'A'), false, true);
+      return true;
+   }
+
+   if (cp == 0xDF)   // ß
+   {
+      builder.add(WEIGHT_LATIN + 's' - 'a', true, false);
+      builder.add(WEIGHT_LATIN + 's' - 'a', true, false);
+      return true;
+   }
+   if ((cp >= 0xC0) && (cp <= 0xFF) && (cp != 0xD7) && (cp != 0xF7))
+   {
+      bool upper = (cp < 0xE0);
+      uint32_t lower = upper ? cp + 0x20 : cp;
+      if (lower == 0xE6)   // æ
+      {
+         builder.add(WEIGHT_LATIN, true, upper);
+         builder.add(WEIGHT_LATIN + 'e' - 'a', true, upper);
+         return true;
+      }
+      char base = LATIN1_BASE[lower - 0xE0];
+      builder.add(static_cast<unsigned char>(WEIGHT_LATIN + base - 'a'), true, upper);
+      return true;
+   }
+
+   // Латиница с диакритикой из фамилий: č ć š ś ž ź ż ł ń ř
+   char base = 0;
+   switch (cp)
+   {
+   case 0x106: case 0x107: case 0x10C: case 0x10D: base = 'c'; break;
+   case 0x15A: case 0x15B: case 0x160: case 0x161: base = 's'; break;
+   case 0x179: case 0x17A: case 0x17B: case 0x17C: case 0x17D: case 0x17E: base = 'z'; break;
+   case 0x141: case 0x142: base = 'l'; break;
+   case 0x143: case 0x144: base = 'n'; break;
+   case 0x158: case 0x159: base = 'r'; break;
+   default: return false;
+   }
+   // В этих блоках прописная - нечётная, в остальных - чётная
+   bool oddUpper = ((cp >= 0x139) && (cp <= 0x148)) || ((cp >= 0x179) && (cp <= 0x17E));
+   bool upper = oddUpper ? (cp & 1) : !(cp & 1);
+   builder.add(static_cast<unsigned char>(WEIGHT_LATIN + base - 'a'), true, upper);
+   return true;
+}
+
+std::string CollationKey::of(const std::string &utf8)
+{
+   KeyBuilder builder;
+   bool space = false;
+   size_t pos = 0;
+   while (pos < utf8.size())
+   {
+      uint32_t cp = nextCodePoint(utf8, pos);
+      // Пробелы схлопываются, по краям отбрасываются
+      if ((cp == ' ') || (cp == '\t') || (cp == '\r') || (cp == '\n') || (cp == 0xA0))
+      {
+         space = !builder.empty();
+         continue;
+      }
+      if (space)
+         builder.add(WEIGHT_SPACE, false, false);
+      space = false;
+
+      if ((cp >= '0') && (cp <= '9'))
+      {
+         builder.add(static_cast<unsigned char>(WEIGHT_DIGIT + cp - '0'), false, false);
+         continue;
+      }
+      if (cp == 0x2019 || cp == 0x02BC)
+         cp = '\'';
+      const char *punct = (cp && (cp < 0x80)) ? strchr(PUNCTUATION, static_cast<int>(cp)) : nullptr;
+      if (punct)
+      {
+         builder.add(static_cast<unsigned char>(WEIGHT_PUNCTUATION + (punct - PUNCTUATION)), false, false);
+         continue;
+      }
+      if (!addCyrillic(builder, cp) && !addLatin(builder, cp))
+         builder.addOther(cp);
+   }
+   return builder.key();
+}
+
+std::vector<int> CollationKey::order(const std::vector<std::string> &texts)
+{
+   std::vector<std::string> keys;
+   keys.reserve(texts.size());
+   for (const std::string &text : texts)
+      keys.push_back(of(text));
+
+   std::vector<int> result(texts.size());
+   std::iota(result.begin(), result.end(), 0);
+   // Равные ключи остаются в исходном порядке
+   std::stable_sort(result.begin(), result.end(), [&keys](int a, int b) { return keys[a] < keys[b]; });
+   return result;
+}
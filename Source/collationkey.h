@@ -0,0 +1,32 @@
+#ifndef COLLATIONKEY_H
+#define COLLATIONKEY_H
+
+/*
+ * Ключ сортировки строки по правилам русского алфавита, сравниваемый побайтно (memcmp).
+ * Сравнение QString::localeAwareCompare на каждую пару при сортировке больших списков
+ * медленное, а ключ QCollatorSortKey нельзя сохранить в базу. Здесь ключ - обычные байты:
+ * его можно держать в столбце BLOB с индексом и сортировать по нему и в памяти, и в ORDER BY.
+ * Уровни как в UCA:
+ *  1 - буква без учёта регистра и диакритики: пробел, знаки, цифры, кириллица
+ *      (а б в г ґ д е є ж з и і ї й к ... я), затем латиница;
+ *  2 - диакритика: ё после е, é после e;
+ *  3 - регистр: строчная раньше прописной.
+ * Уровни разделены байтом 0x01, в ключе нет нулевых байтов.
+ */
+
+#include <string>
+#include <vector>
+
+#include <QString>
+
+class CollationKey
+{
+public:
+   static std::string of(const std::string &utf8);
+   static std::string of(const QString &text) { return of(text.toStdString()); }
+
+   // Индексы texts по возрастанию; ключ считается один раз на строку, дальше только memcmp
+   static std::vector<int> order(const std::vector<std::string> &texts);
+};
+
+#endif // COLLATIONKEY_H
@@ -0,0 +1,207 @@
+#include "connectorrouter.h"
+
+#include <algorithm>
+
+ConnectorRouter::ConnectorRouter()
+   : _layoutVersion(0),
+   _layout(nullptr),
+   _version(0),
+   _routed(0)
+{
+
+}
+
+void ConnectorRouter::clear()
+{
+   _groups.clear();
+   _groupIndex.clear();
+   _groupOf.clear();
+   _lastX.clear();
+   _lastY.clear();
+   _segments.clear();
+   _dirty.clear();
+   _changed.clear();
+   _layout = nullptr;
+   _layoutVersion = 0;
+   _routed = 0;
+   _version++;
+}
+
+bool ConnectorRouter::moved(int node, const TreeLayout &layout) const
+{
+   return (node >= static_cast<int>(_lastX.size()))
+         || (_lastX[node] != layout.x(node)) || (_lastY[node] != layout.y(node));
+}
+
+void ConnectorRouter::markDirty(const std::vector<ConnectorSegment> &segments)
+{
+   if (segments.empty())
+      return;
+
+   ConnectorSegment box = { segments[0].x1, segments[0].y1, segments[0].x1, segments[0].y1 };
+   for (const ConnectorSegment &seg : segments)
+   {
+      box.x1 = std::min(box.x1, std::min(seg.x1, seg.x2));
+      box.y1 = std::min(box.y1, std::min(seg.y1, seg.y2));
+      box.x2 = std::max(box.x2, std::max(seg.x1, seg.x2));
+      box.y2 = std::max(box.y2, std::max(seg.y1, seg.y2));
+   }
+   _dirty.push_back(box);
+}
+
+void ConnectorRouter::route(const TreeGraph &graph, const TreeLayout &layout)
+{
+   _dirty.clear();
+   _changed.clear();
+
+   // Раскладка не менялась с прошлого раза - маршруты те же
+   if ((_layout == &layout) && (_layoutVersion == layout.version()))
+   {
+      _routed = 0;
+      return;
+   }
+   _layout = &layout;
+   _layoutVersion = layout.version();
+
+   // Прежний состав групп откладывается, чтобы заметить появление и уход детей
+   for (Group &group : _groups)
+   {
+      group.alive = false;
+      group.previous.swap(group.children);
+      group.children.clear();
+   }
+
+   for (int c = 0; c < graph.size(); c++)
+   {
+      int f = graph.father[c], m = graph.mother[c];
+      if ((f < 0) && (m < 0))
+         continue;
+
+      // Обычно ребёнок остаётся в своей прежней группе, и хэш-таблица не нужна
+      int g = (c < static_cast<int>(_groupOf.size())) ? _groupOf[c] : -1;
+      if ((g < 0) || (_groups[g].father != f) || (_groups[g].mother != m))
+      {
+         auto it = _groupIndex.emplace(groupKey(f, m), static_cast<int>(_groups.size()));
+         if (it.second)
+            _groups.push_back(Group{ f, m, std::vector<int>(), std::vector<int>(), std::vector<ConnectorSegment>(), 0, false });
+         g = it.first->second;
+         if (c >= static_cast<int>(_groupOf.size()))
+            _groupOf.resize(graph.size(), -1);
+         _groupOf[c] = g;
+      }
+
+      Group &group = _groups[g];
+      group.alive = true;
+      group.children.push_back(c);
+   }
+
+   // Группа перекладывается, если сменился состав или сдвинулся кто-то из родителей или детей
+   _routed = 0;
+   _segments.clear();
+   for (size_t g = 0; g < _groups.size(); g++)
+   {
+      Group &group = _groups[g];
+      group.first = static_cast<int>(_segments.size());
+      if (!group.alive)
+      {
+         if (!group.segments.empty())
+            _changed.push_back(static_cast<int>(g));
+         markDirty(group.segments);
+         group.previous.clear();
+         group.segments.clear();
+         continue;
+      }
+
+      bool dirty = (group.children != group.previous) || group.segments.empty()
+            || ((group.father >= 0) && moved(group.father, layout))
+            || ((group.mother >= 0) && moved(group.mother, layout));
+      for (size_t k = 0; !dirty && (k < group.children.size()); k++)
+         dirty = moved(group.children[k], layout);
+
+      if (dirty)
+      {
+         markDirty(group.segments);
+         routeGroup(group, layout);
+         markDirty(group.segments);
+         _changed.push_back(static_cast<int>(g));
+         _routed++;
+      }
+      _segments.insert(_segments.end(), group.segments.begin(), group.segments.end());
+   }
+
+   _lastX.resize(layout.size());
+   _lastY.resize(layout.size());
+   for (int i = 0; i < layout.size(); i++)
+   {
+      _lastX[i] = layout.x(i);
+      _lastY[i] = layout.y(i);
+   }
+
+   _version++;
+}
+
+void ConnectorRouter::routeGroup(Group &group, const TreeLayout &layout)
+{
+   group.segments.clear();
+
+   const LayoutParams &params = layout.params();
+   double halfH = params.cardHeight / 2;
+
+   auto add = [&group](double x1, double y1, double x2, double y2)
+   {
+      if ((x1 != x2) || (y1 != y2))
+         group.segments.push_back({ x1, y1, x2, y2 });
+   };
+
+   std::vector<int> parents;
+   if (group.father >= 0)
+      parents.push_back(group.father);
+   if ((group.mother >= 0) && (group.mother != group.father))
+      parents.push_back(group.mother);
+
+   double parentBottom = layout.y(parents[0]) + halfH;
+   double dropX = 0;
+   for (int p : parents)
+   {
+      parentBottom = std::max(parentBottom, layout.y(p) + halfH);
+      dropX += layout.x(p);
+   }
+   dropX /= parents.size();
+
+   double childTop = layout.y(group.children[0]) - halfH;
+   double minX = dropX, maxX = dropX;
+   for (int c : group.children)
+   {
+      childTop = std::min(childTop, layout.y(c) - halfH);
+      minX = std::min(minX, layout.x(c));
+      maxX = std::max(maxX, layout.x(c));
+   }
+
+   // Брачная шина - в верхней трети промежутка между поколениями, шина детей - в нижней
+   double gap = childTop - parentBottom;
+   double marriageY = parentBottom + gap / 3;
+   double siblingY = childTop - gap / 3;
+   if (gap <= 0)
+      marriageY = siblingY = (parentBottom + childTop) / 2;
+
+   if (parents.size() > 1)
+   {
+      double left = dropX, right = dropX;
+      for (int p : parents)
+      {
+         add(layout.x(p), layout.y(p) + halfH, layout.x(p), marriageY);
+         left = std::min(left, layout.x(p));
+         right = std::max(right, layout.x(p));
+      }
+      add(left, marriageY, right, marriageY);
+      add(dropX, marriageY, dropX, siblingY);
+   }
+   else
+   {
+      add(dropX, parentBottom, dropX, siblingY);
+   }
+
+   add(minX, siblingY, maxX, siblingY);
+   for (int c : group.children)
+      add(layout.x(c), siblingY, layout.x(c), layout.y(c) - halfH);
+}
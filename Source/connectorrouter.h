@@ -0,0 +1,82 @@
+#ifndef CONNECTORROUTER_H
+#define CONNECTORROUTER_H
+
+/*
+ * Прямоугольные линии связи родителей с детьми.
+ * Дети одной пары родителей объединяются в группу: от родителей линии сходятся в общую
+ * "брачную" шину, от неё одна линия спускается к общей шине братьев и сестёр, а уже от неё -
+ * короткие отводы к каждому ребёнку. Геометрия кэшируется по группам и пересчитывается
+ * только для групп, где сдвинулся кто-то из участников.
+ */
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+#include "treegraph.h"
+#include "treelayout.h"
+
+struct ConnectorSegment
+{
+   double x1, y1, x2, y2;
+};
+
+class ConnectorRouter
+{
+public:
+   ConnectorRouter();
+
+   void clear();
+   void route(const TreeGraph &graph, const TreeLayout &layout);
+
+   unsigned version() const { return _version; }
+   int groupCount() const { return static_cast<int>(_groups.size()); }
+   int routedGroups() const { return _routed; }
+
+   int segmentCount() const { return static_cast<int>(_segments.size()); }
+   const ConnectorSegment &segment(int num) const { return _segments[num]; }
+
+   // Охватывающие прямоугольники линий (старых и новых), изменившихся при последнем route()
+   const std::vector<ConnectorSegment> &dirtyBoxes() const { return _dirty; }
+   // Группы, переложенные или исчезнувшие при последнем route(); номера групп не меняются
+   const std::vector<int> &changedGroups() const { return _changed; }
+   // Линии группы лежат в segment() подряд
+   int groupFirstSegment(int group) const { return _groups[group].first; }
+   int groupSegmentCount(int group) const { return static_cast<int>(_groups[group].segments.size()); }
+
+private:
+   struct Group
+   {
+      int father;
+      int mother;
+      std::vector<int> children;
+      std::vector<int> previous;
+      std::vector<ConnectorSegment> segments;
+      int first;        // номер первой линии в _segments
+      bool alive;
+   };
+
+   static uint64_t groupKey(int father, int mother)
+   {
+      return (uint64_t(uint32_t(father)) << 32) | uint32_t(mother);
+   }
+   void routeGroup(Group &group, const TreeLayout &layout);
+   bool moved(int node, const TreeLayout &layout) const;
+   void markDirty(const std::vector<ConnectorSegment> &segments);
+
+   std::vector<Group> _groups;
+   std::unordered_map<uint64_t, int> _groupIndex;
+   std::vector<int> _groupOf;
+   std::vector<double> _lastX;
+   std::vector<double> _lastY;
+   std::vector<ConnectorSegment> _segments;
+   std::vector<ConnectorSegment> _dirty;
+   std::vector<int> _changed;
+
+   unsigned _layoutVersion;
+   const TreeLayout *_layout;
+   unsigned _version;
+   int _routed;
+};
+
+#endif // CONNECTORROUTER_H
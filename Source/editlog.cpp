@@ -0,0 +1,403 @@
+#include "editlog.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "writelog.h"
+
+// Связи идут отдельными шагами, а не значениями полей
+static const unsigned VALUE_FIELDS = FIELD_ALL & ~(FIELD_PARENTS | FIELD_CHILDREN);
+
+EditLog::EditLog(QVector<Person*> *persons, ChangeTracker *tracker, size_t budget)
+   : _persons(persons), _tracker(tracker),
+#ifdef DATABASE
+   _db(nullptr),
+#endif
+   _budget(budget), _usage(0), _open(false)
+{
+
+}
+
+EditLog::~EditLog()
+{
+   clear();
+}
+
+#ifdef DATABASE
+void EditLog::setDB(DB *db, const std::string &tableName)
+{
+   _db = db;
+   _tableName = tableName;
+}
+#endif
+
+void EditLog::setBudget(size_t bytes)
+{
+   _budget = bytes;
+   while ((_usage > _budget) && (_undo.size() > 1))
+   {
+      _usage -= _undo.front().cost;
+      release(_undo.front(), true);
+      _undo.pop_front();
+   }
+}
+
+void EditLog::readFields(const Person &pers, unsigned fields, FieldValues &values)
+{
+   values.alive = pers.bIsAlive;
+   if (fields & FIELD_NAME)
+      values.name = pers.name;
+   if (fields & FIELD_BIRTH_DATE)
+      values.birthDate = pers.birthDate;
+   if (fields & FIELD_DEATH)
+      values.deathDate = pers.deathDate;
+   if (fields & FIELD_INFO)
+      values.info = pers.info;
+   if (fields & FIELD_BIRTH_PLACE)
+      values.birthPlace = pers.birthPlace;
+   if (fields & FIELD_PHOTO)
+      values.photo = pers.photoData;   // без копирования данных
+   if (fields & FIELD_SEX)
+      values.sex = pers.sex;
+}
+
+void EditLog::writeFields(const FieldValues &values, unsigned fields, Person &pers)
+{
+   if (fields & FIELD_NAME)
+      pers.name = values.name;
+   if (fields & FIELD_BIRTH_DATE)
+      pers.birthDate = values.birthDate;
+   if (fields & FIELD_DEATH)
+   {
+      pers.bIsAlive = values.alive;
+      pers.deathDate = values.deathDate;
+   }
+   if (fields & FIELD_INFO)
+      pers.info = values.info;
+   if (fields & FIELD_BIRTH_PLACE)
+      pers.birthPlace = values.birthPlace;
+   if (fields & FIELD_PHOTO)
+      pers.photoData = values.photo;
+   if (fields & FIELD_SEX)
+      pers.sex = values.sex;
+}
+
+size_t EditLog::costOf(const Step &step)
+{
+   size_t cost = sizeof(Step);
+   if (step.delta)
+   {
+      // Новое фото принадлежит дереву; журнал держит только старое
+      const FieldValues *values[2] = { &step.delta->before, &step.delta->after };
+      cost += sizeof(FieldDelta) + step.delta->before.photo.size();
+      for (const FieldValues *v : values)
+         cost += (v->name.size() + v->info.size() + v->birthPlace.size() + v->sex.size()) * sizeof(QChar);
+   }
+   if ((step.kind == STEP_REMOVE) && step.pers)
+      cost += sizeof(Person) + step.pers->photoData.size()
+            + (step.pers->name.size() + step.pers->info.size() + step.pers->birthPlace.size()) * sizeof(QChar);
+   return cost;
+}
+
+void EditLog::begin(const QString &title)
+{
+   if (_open)
+      return;
+   _open = true;
+   _current.title = title;
+   _current.steps.clear();
+   _current.cost = 0;
+}
+
+int EditLog::commit()
+{
+   if (!_open)
+      return 0;
+   _open = false;
+   int ret = flush();
+   if (_current.steps.empty())
+      return ret;
+
+   _current.cost = sizeof(Command);
+   for (const Step &step : _current.steps)
+      _current.cost += costOf(step);
+
+   // Новая правка отменяет возможность повтора
+   for (Command &cmd : _redo)
+   {
+      _usage -= cmd.cost;
+      release(cmd, false);
+   }
+   _redo.clear();
+
+   _usage += _current.cost;
+   _undo.push_back(std::move(_current));
+   _current = Command();
+
+   setBudget(_budget);
+   return ret;
+}
+
+void EditLog::touch(Person *pers, unsigned fields)
+{
+   _touched.markChanged(pers, fields);
+   if (_tracker)
+      _tracker->markChanged(pers, fields);
+}
+
+void EditLog::touchPresence(Person *pers, bool added)
+{
+   if (added)
+   {
+      _touched.markAdded(pers);
+      if (_tracker)
+         _tracker->markAdded(pers);
+   }
+   else
+   {
+      _touched.markRemoved(pers);
+      if (_tracker)
+         _tracker->markRemoved(pers);
+   }
+}
+
+int EditLog::flush()
+{
+   int ret = 0;
+#ifdef DATABASE
+   // Всё затронутое одной транзакцией savePersonDelta
+   if (_db && !_touched.isEmpty())
+   {
+      ret = _touched.saveToDB(*_db, _tableName);
+      if (ret)
+         writeDebugLog("EditLog::flush Failed to write to " + QString::fromStdString(_tableName));
+   }
+#endif
+   _touched.clear();
+   return ret;
+}
+
+void EditLog::apply(Step &step, bool forward)
+{
+   switch (step.kind)
+   {
+   case STEP_FIELDS:
+      writeFields(forward ? step.delta->after : step.delta->before, step.fields, *step.pers);
+      touch(step.pers, step.fields);
+      break;
+
+   case STEP_LINK:
+   case STEP_UNLINK:
+   {
+      Person *&slot = step.mother ? step.pers->mother : step.pers->father;
+      QVector<Person*> &children = step.parent->children;
+      if ((step.kind == STEP_LINK) == forward)
+      {
+         slot = step.parent;
+         // Отменённое удаление связи возвращает ребёнка на прежнее место
+         int at = (step.kind == STEP_UNLINK) ? std::min(step.index, children.size()) : children.size();
+         children.insert(at, step.pers);
+      }
+      else
+      {
+         slot = nullptr;
+         int at = (step.kind == STEP_LINK) ? children.lastIndexOf(step.pers) : children.indexOf(step.pers);
+         if (at >= 0)
+            children.remove(at);
+         step.index = at;
+      }
+      touch(step.parent, FIELD_CHILDREN);
+      touch(step.pers, FIELD_PARENTS);
+      break;
+   }
+
+   case STEP_ADD:
+   case STEP_REMOVE:
+      if ((step.kind == STEP_ADD) == forward)
+      {
+         int at = (step.kind == STEP_REMOVE) ? std::min(step.index, _persons->size()) : _persons->size();
+         _persons->insert(at, step.pers);
+         touchPresence(step.pers, true);
+      }
+      else
+      {
+         touchPresence(step.pers, false);
+         int at = _persons->indexOf(step.pers);
+         if (at >= 0)
+            _persons->remove(at);
+         step.index = at;
+      }
+      break;
+   }
+}
+
+int EditLog::record(Step &&step)
+{
+   step.index = -1;
+   apply(step, true);
+   _current.steps.push_back(std::move(step));
+   return 0;
+}
+
+int EditLog::setFields(Person *pers, const Person &values, unsigned fields)
+{
+   fields &= VALUE_FIELDS;
+   if (!pers || !fields)
+      return pers ? 0 : -1;
+
+   // В шаг попадают только действительно изменившиеся поля
+   unsigned changed = 0;
+   if ((fields & FIELD_NAME) && (pers->name != values.name))
+      changed |= FIELD_NAME;
+   if ((fields & FIELD_BIRTH_DATE) && (pers->birthDate != values.birthDate))
+      changed |= FIELD_BIRTH_DATE;
+   if ((fields & FIELD_DEATH) && ((pers->bIsAlive != values.bIsAlive) || (pers->deathDate != values.deathDate)))
+      changed |= FIELD_DEATH;
+   if ((fields & FIELD_INFO) && (pers->info != values.info))
+      changed |= FIELD_INFO;
+   if ((fields & FIELD_BIRTH_PLACE) && (pers->birthPlace != values.birthPlace))
+      changed |= FIELD_BIRTH_PLACE;
+   if ((fields & FIELD_PHOTO) && (pers->photoData != values.photoData))
+      changed |= FIELD_PHOTO;
+   if ((fields & FIELD_SEX) && (pers->sex != values.sex))
+      changed |= FIELD_SEX;
+   if (!changed)
+      return 0;
+
+   bool group = !_open;
+   if (group)
+      begin(QString::fromUtf8("Правка"));
+
+   Step step{ STEP_FIELDS, pers, nullptr, false, -1, changed, std::unique_ptr<FieldDelta>(new FieldDelta) };
+   readFields(*pers, changed, step.delta->before);
+   readFields(values, changed, step.delta->after);
+   record(std::move(step));
+
+   return group ? commit() : 0;
+}
+
+int EditLog::link(Person *parent, Person *child, bool mother)
+{
+   if (!parent || !child || (parent == child))
+      return -1;
+   Person *current = mother ? child->mother : child->father;
+   if (current == parent)
+      return 0;
+
+   bool group = !_open;
+   if (group)
+      begin(QString::fromUtf8("Связь"));
+   if (current)
+      unlink(current, child);
+   record(Step{ STEP_LINK, child, parent, mother, -1, 0, nullptr });
+   return group ? commit() : 0;
+}
+
+int EditLog::unlink(Person *parent, Person *child)
+{
+   if (!parent || !child || ((child->father != parent) && (child->mother != parent)))
+      return -1;
+
+   bool group = !_open;
+   if (group)
+      begin(QString::fromUtf8("Связь"));
+   record(Step{ STEP_UNLINK, child, parent, child->mother == parent, -1, 0, nullptr });
+   return group ? commit() : 0;
+}
+
+int EditLog::addPerson(Person *pers)
+{
+   if (!pers || _persons->contains(pers))
+      return -1;
+
+   bool group = !_open;
+   if (group)
+      begin(QString::fromUtf8("Добавление"));
+   record(Step{ STEP_ADD, pers, nullptr, false, -1, 0, nullptr });
+   return group ? commit() : 0;
+}
+
+int EditLog::removePerson(Person *pers)
+{
+   if (!pers || !_persons->contains(pers))
+      return -1;
+
+   bool group = !_open;
+   if (group)
+      begin(QString::fromUtf8("Удаление"));
+
+   // Сначала связи - отдельными шагами, чтобы undo их вернул
+   if (pers->father)
+      unlink(pers->father, pers);
+   if (pers->mother)
+      unlink(pers->mother, pers);
+   QVector<Person*> children = pers->children;
+   for (Person *child : children)
+      unlink(pers, child);
+   record(Step{ STEP_REMOVE, pers, nullptr, false, -1, 0, nullptr });
+
+   return group ? commit() : 0;
+}
+
+int EditLog::undo()
+{
+   if (_open || _undo.empty())
+      return -1;
+
+   Command cmd = std::move(_undo.back());
+   _undo.pop_back();
+   for (auto it = cmd.steps.rbegin(); it != cmd.steps.rend(); ++it)
+      apply(*it, false);
+   _redo.push_back(std::move(cmd));
+   return flush();
+}
+
+int EditLog::redo()
+{
+   if (_open || _redo.empty())
+      return -1;
+
+   Command cmd = std::move(_redo.back());
+   _redo.pop_back();
+   for (Step &step : cmd.steps)
+      apply(step, true);
+   _undo.push_back(std::move(cmd));
+   return flush();
+}
+
+void EditLog::release(Command &cmd, bool applied)
+{
+   // Владелец - журнал, если человек вне дерева в том состоянии, в котором осталась команда:
+   // у применённой решает последний шаг добавления/удаления, у отменённой - первый
+   std::unordered_map<Person*, bool> owned;
+   if (applied)
+   {
+      for (const Step &step : cmd.steps)
+         if ((step.kind == STEP_ADD) || (step.kind == STEP_REMOVE))
+            owned[step.pers] = (step.kind == STEP_REMOVE);
+   }
+   else
+   {
+      for (auto it = cmd.steps.rbegin(); it != cmd.steps.rend(); ++it)
+         if ((it->kind == STEP_ADD) || (it->kind == STEP_REMOVE))
+            owned[it->pers] = (it->kind == STEP_ADD);
+   }
+
+   for (const auto &it : owned)
+      if (it.second)
+         delete it.first;
+   cmd.steps.clear();
+}
+
+void EditLog::clear()
+{
+   if (_open)
+      commit();
+   for (Command &cmd : _undo)
+      release(cmd, true);
+   for (Command &cmd : _redo)
+      release(cmd, false);
+   _undo.clear();
+   _redo.clear();
+   _usage = 0;
+}
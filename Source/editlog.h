@@ -0,0 +1,144 @@
+#ifndef EDITLOG_H
+#define EDITLOG_H
+
+/*
+ * Отмена и повтор правок дерева.
+ * Правки идут через EditLog: он сам меняет людей и записывает шаги команды - какие поля
+ * стали какими (только изменённые поля, значения до и после), какие связи родитель-ребёнок
+ * появились или исчезли, кто добавлен или удалён. Целые копии Person не снимаются;
+ * фото хранится как QByteArray и делит данные с деревом, пока их никто не меняет.
+ * Удалённый человек не освобождается, пока его удаление можно отменить: после undo
+ * в дерево возвращается тот же объект, и указатели на него остаются верными.
+ * Журнал держится в пределах бюджета памяти: старые команды выбрасываются, последняя
+ * остаётся всегда. Каждая команда, undo и redo отмечаются в ChangeTracker и, если задана
+ * база, сразу пишутся в неё одной транзакцией.
+ */
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QByteArray>
+#include <QDate>
+#include <QString>
+#include <QVector>
+
+#include "person.h"
+#include "changetracker.h"
+#ifdef DATABASE
+#include "db.h"
+#endif
+
+#define EDIT_LOG_BUDGET   (32 * 1024 * 1024)   // байт на весь журнал
+
+class EditLog
+{
+public:
+   explicit EditLog(QVector<Person*> *persons, ChangeTracker *tracker = nullptr, size_t budget = EDIT_LOG_BUDGET);
+   ~EditLog();
+
+#ifdef DATABASE
+   void setDB(DB *db, const std::string &tableName);
+#endif
+   void setBudget(size_t bytes);
+   size_t memoryUsage() const { return _usage; }
+
+   // Операции между begin и commit - одна команда; без begin каждая операция - своя команда
+   void begin(const QString &title);
+   int commit();
+
+   // Поля PersonField из values, кроме связей
+   int setFields(Person *pers, const Person &values, unsigned fields);
+   // Прежний отец (мать) ребёнка отвязывается
+   int link(Person *parent, Person *child, bool mother);
+   int unlink(Person *parent, Person *child);
+   // Дерево становится владельцем pers
+   int addPerson(Person *pers);
+   // Связи отвязываются, сам человек хранится в журнале
+   int removePerson(Person *pers);
+
+   bool canUndo() const { return !_undo.empty(); }
+   bool canRedo() const { return !_redo.empty(); }
+   QString undoTitle() const { return _undo.empty() ? QString() : _undo.back().title; }
+   QString redoTitle() const { return _redo.empty() ? QString() : _redo.back().title; }
+   int undo();
+   int redo();
+   void clear();
+
+private:
+   enum StepKind
+   {
+      STEP_FIELDS,
+      STEP_LINK,
+      STEP_UNLINK,
+      STEP_ADD,
+      STEP_REMOVE
+   };
+
+   struct FieldValues
+   {
+      QString name;
+      QDate birthDate;
+      bool alive;
+      QDate deathDate;
+      QString info;
+      QString birthPlace;
+      QByteArray photo;
+      QString sex;
+   };
+
+   struct FieldDelta
+   {
+      FieldValues before;
+      FieldValues after;
+   };
+
+   struct Step
+   {
+      StepKind kind;
+      Person *pers;                       // для связи - ребёнок
+      Person *parent;
+      bool mother;
+      int index;                          // место в списке детей или в дереве, для отмены
+      unsigned fields;
+      std::unique_ptr<FieldDelta> delta;  // только STEP_FIELDS
+   };
+
+   struct Command
+   {
+      QString title;
+      std::vector<Step> steps;
+      size_t cost;
+   };
+
+   static void readFields(const Person &pers, unsigned fields, FieldValues &values);
+   static void writeFields(const FieldValues &values, unsigned fields, Person &pers);
+   static size_t costOf(const Step &step);
+
+   int record(Step &&step);
+   void apply(Step &step, bool forward);
+   void touch(Person *pers, unsigned fields);
+   void touchPresence(Person *pers, bool added);
+   int flush();
+   // Освобождает людей, которыми владеет команда: удалённых в применённой, добавленных в отменённой
+   static void release(Command &cmd, bool applied);
+
+   QVector<Person*> *_persons;
+   ChangeTracker *_tracker;
+   ChangeTracker _touched;       // затронутое текущей командой, undo или redo
+#ifdef DATABASE
+   DB *_db;
+   std::string _tableName;
+#endif
+   size_t _budget;
+   size_t _usage;
+
+   bool _open;
+   Command _current;
+   std::deque<Command> _undo;
+   std::deque<Command> _redo;
+};
+
+#endif // EDITLOG_H
@@ -1,11 +1,312 @@
 #include "familytreewidget.h"
 
+#include <cmath>
+
+#include <QPainter>
+#include <QPaintEvent>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QtConcurrent/QtConcurrent>
+
+#include "posterexporter.h"
+
+#define MIN_ZOOM 0.01
+#define MAX_ZOOM 4.0
+
 FamilyTreeWidget::FamilyTreeWidget(QWidget *parent)
-    : QWidget(parent)
+    : QWidget(parent),
+    m_version(0),
+    m_layoutSerial(0),
+    m_layoutPending(false),
+    m_scale(1.0),
+    m_dragging(false)
 {
+    m_scene = std::make_shared<TreeScene>();
+    connect(&m_layoutWatcher, SIGNAL(finished()), this, SLOT(layoutFinished()));
+    connect(&m_thumbnails, SIGNAL(thumbnailReady(uint)), this, SLOT(thumbnailReady(uint)));
+    connect(&m_tiles, SIGNAL(tileReady(int,int,int)), this, SLOT(tileReady(int,int,int)));
+    m_tiles.setThumbnails(&m_thumbnails);
 }
 
 FamilyTreeWidget::~FamilyTreeWidget()
 {
+    m_layoutWatcher.waitForFinished();
+}
+
+void FamilyTreeWidget::setPersons(const QVector<Person*> &persons)
+{
+    m_persons = persons;
+    startLayout();
+}
+
+void FamilyTreeWidget::updatePersons(const QVector<Person*> &changed)
+{
+    int added = 0;
+    for (Person *pers : changed)
+    {
+        if (m_scene->graph().indexOf(pers->id) < 0)
+        {
+            m_persons.append(pers);
+            added++;
+        }
+    }
+
+    // Пока считается полная раскладка, точечная правка бессмысленна - пересчитываем всё
+    if (m_layoutWatcher.isRunning() || (m_scene->size() + added != m_persons.size()))
+    {
+        startLayout();
+        return;
+    }
+
+    // Сцену делят снимки рабочих потоков: отпускаем свои ссылки и копируем её, только если она ещё занята
+    m_snapshot.reset();
+    m_tiles.setSnapshot(nullptr);
+    if (m_scene.use_count() > 1)
+        m_scene = std::make_shared<TreeScene>(*m_scene);
+
+    // Сбрасываются только плитки, где что-то сдвинулось или поменялось
+    m_tiles.invalidate(m_scene->update(m_persons, changed));
+    m_scenePersons = m_persons;
+    for (Person *pers : changed)
+        m_dirtyRecords.push_back(m_scene->graph().indexOf(pers->id));
+    emit layoutReady();
+    update();
+}
+
+void FamilyTreeWidget::setLayoutParams(const LayoutParams &params)
+{
+    m_params = params;
+    startLayout();
+}
+
+void FamilyTreeWidget::startLayout()
+{
+    m_version++;
+
+    // Раскладка и индексы считаются в пуле потоков, пока идёт старая - новая откладывается до её конца
+    if (m_layoutWatcher.isRunning())
+    {
+        m_layoutPending = true;
+        return;
+    }
+    m_layoutPending = false;
+
+    // Граф собирается здесь: GUI может править людей, пока рабочий поток раскладывает дерево.
+    // В поток уходят только номера узлов и индексы родителей
+    quint64 version = m_version;
+    m_layoutPersons = m_persons;
+    std::shared_ptr<TreeGraph> graph = std::make_shared<TreeGraph>(TreeGraph::fromPersons(m_layoutPersons));
+    LayoutParams params = m_params;
+
+    m_layoutWatcher.setFuture(QtConcurrent::run([version, graph, params]() -> LayoutJob
+    {
+        LayoutJob job;
+        job.version = version;
+        job.scene.build(std::move(*graph), params);
+        return job;
+    }));
+}
+
+void FamilyTreeWidget::layoutFinished()
+{
+    if (m_layoutPending)
+    {
+        startLayout();
+        return;
+    }
+
+    LayoutJob job = m_layoutWatcher.result();
+    if (job.version != m_version)
+        return;
+
+    m_scene = std::make_shared<TreeScene>(std::move(job.scene));
+    m_scenePersons = m_layoutPersons;
+    m_records.clear();
+    m_dirtyRecords.clear();
+    m_layoutSerial++;
+    m_snapshot.reset();
+    m_tiles.clear();
+    emit layoutReady();
+    update();
+}
+
+void FamilyTreeWidget::thumbnailReady(uint id)
+{
+    int node = m_scene->graph().indexOf(id);
+    if ((node < 0) || (node >= m_scene->size()))
+        return;
+
+    QRectF card = m_scene->cardRect(node);
+    m_tiles.invalidate(QVector<QRectF>() << card);
+    update(screenRect(card));
+}
+
+void FamilyTreeWidget::tileReady(int level, int tx, int ty)
+{
+    if (level == TileCache::levelFor(m_scale))
+        update(screenRect(TileCache::tileRect(level, tx, ty)));
+}
+
+std::shared_ptr<const RenderSnapshot> FamilyTreeWidget::snapshot()
+{
+    // Снимок для рабочих потоков делается только когда он понадобился после правок
+    if (!m_snapshot)
+    {
+        // Записи неизменяемы и общие с прежними снимками: заново копируются только правленые и новые люди
+        m_records.resize(m_scenePersons.size());
+        for (int node : m_dirtyRecords)
+            if ((node >= 0) && (node < static_cast<int>(m_records.size())))
+                m_records[node].reset();
+        m_dirtyRecords.clear();
+
+        std::shared_ptr<RenderSnapshot> snapshot = std::make_shared<RenderSnapshot>();
+        snapshot->scene = m_scene;   // только ссылка, правки копируют сцену сами
+        snapshot->serial = m_layoutSerial;
+        snapshot->pointers.reserve(m_scenePersons.size());
+        for (int node = 0; node < m_scenePersons.size(); node++)
+        {
+            if (!m_records[node])
+                m_records[node] = std::make_shared<Person>(*m_scenePersons[node]);
+            snapshot->pointers.append(m_records[node].get());
+        }
+        snapshot->records = m_records;
+        m_snapshot = snapshot;
+    }
+    return m_snapshot;
+}
+
+void FamilyTreeWidget::setZoom(double scale, const QPointF &anchor)
+{
+    scale = qBound(MIN_ZOOM, scale, MAX_ZOOM);
+
+    // Точка под anchor (экранные координаты) остаётся на месте
+    QPointF world = (anchor - m_offset) / m_scale;
+    m_scale = scale;
+    m_offset = anchor - world * m_scale;
+    update();
+}
+
+void FamilyTreeWidget::centerOn(const QPointF &worldPos)
+{
+    m_offset = QPointF(width() / 2.0, height() / 2.0) - worldPos * m_scale;
+    update();
+}
+
+int FamilyTreeWidget::exportPoster(const QString &fileName, double scale)
+{
+    PosterExporter exporter;
+    exporter.setThumbnails(&m_thumbnails);
+    exporter.setScale(scale);
+    return exporter.exportPoster(fileName, PosterExporter::formatFor(fileName), *m_scene, m_scenePersons);
+}
+
+QRectF FamilyTreeWidget::visibleWorldRect(const QRect &screenRect) const
+{
+    return QRectF((screenRect.left() - m_offset.x()) / m_scale,
+                  (screenRect.top() - m_offset.y()) / m_scale,
+                  screenRect.width() / m_scale,
+                  screenRect.height() / m_scale);
+}
+
+QRect FamilyTreeWidget::screenRect(const QRectF &worldRect) const
+{
+    // Края округляются одинаково, поэтому соседние плитки ложатся без щелей
+    QPoint topLeft(qRound(worldRect.left() * m_scale + m_offset.x()), qRound(worldRect.top() * m_scale + m_offset.y()));
+    QPoint bottomRight(qRound(worldRect.right() * m_scale + m_offset.x()), qRound(worldRect.bottom() * m_scale + m_offset.y()));
+    return QRect(topLeft, bottomRight - QPoint(1, 1));
+}
+
+void FamilyTreeWidget::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton)
+    {
+        m_dragging = true;
+        m_dragStart = event->pos();
+    }
+}
+
+void FamilyTreeWidget::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!m_dragging)
+        return;
+
+    m_offset += event->pos() - m_dragStart;
+    m_dragStart = event->pos();
+    update();
+}
+
+void FamilyTreeWidget::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton)
+        m_dragging = false;
+}
+
+void FamilyTreeWidget::wheelEvent(QWheelEvent *event)
+{
+    double factor = std::pow(1.0015, event->angleDelta().y());
+    setZoom(m_scale * factor, event->posF());
+}
+
+void FamilyTreeWidget::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    QColor background = palette().window().color();
+    painter.fillRect(event->rect(), background);
+
+    QRectF world = visibleWorldRect(event->rect()) & m_scene->bounds();
+    if (!m_scene->size() || world.isEmpty())
+        return;
+
+    m_tiles.setBackground(background);
+    m_tiles.setSnapshot(snapshot());
+
+    // Дерево собирается из готовых плиток ближайшего уровня масштаба, недостающие рисуются в фоне
+    int level = TileCache::levelFor(m_scale);
+    double tileWorld = TILE_SIZE / TileCache::levelScale(level);
+    int tx0 = static_cast<int>(std::floor(world.left() / tileWorld));
+    int tx1 = static_cast<int>(std::floor(world.right() / tileWorld));
+    int ty0 = static_cast<int>(std::floor(world.top() / tileWorld));
+    int ty1 = static_cast<int>(std::floor(world.bottom() / tileWorld));
+
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    for (int ty = ty0; ty <= ty1; ty++)
+    {
+        for (int tx = tx0; tx <= tx1; tx++)
+        {
+            QRectF rect = TileCache::tileRect(level, tx, ty);
+            QPixmap pixmap;
+            if (m_tiles.tile(level, tx, ty, pixmap))
+                painter.drawPixmap(screenRect(rect), pixmap);
+            else
+                drawFallback(painter, level, rect);
+        }
+    }
+}
+
+void FamilyTreeWidget::drawFallback(QPainter &painter, int level, const QRectF &rect)
+{
+    // Пока плитка рисуется, растягиваются уже готовые плитки более мелкого масштаба
+    for (int coarse = level - 1; coarse >= level - 2 * TILE_LEVELS_PER_2X; coarse--)
+    {
+        double coarseScale = TileCache::levelScale(coarse);
+        double coarseWorld = TILE_SIZE / coarseScale;
+        bool drawn = false;
+        for (int cy = static_cast<int>(std::floor(rect.top() / coarseWorld)); cy * coarseWorld < rect.bottom(); cy++)
+        {
+            for (int cx = static_cast<int>(std::floor(rect.left() / coarseWorld)); cx * coarseWorld < rect.right(); cx++)
+            {
+                QPixmap pixmap;
+                if (!m_tiles.cached(coarse, cx, cy, pixmap))
+                    continue;
 
+                QRectF coarseRect = TileCache::tileRect(coarse, cx, cy);
+                QRectF part = rect & coarseRect;
+                QRectF source((part.topLeft() - coarseRect.topLeft()) * coarseScale, part.size() * coarseScale);
+                painter.drawPixmap(screenRect(part), pixmap, source);
+                drawn = true;
+            }
+        }
+        if (drawn)
+            return;
+    }
 }
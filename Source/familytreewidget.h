@@ -1,7 +1,18 @@
 #ifndef FAMILYTREEWIDGET_H
 #define FAMILYTREEWIDGET_H
 
+#include <memory>
+#include <vector>
+
 #include <QWidget>
+#include <QVector>
+#include <QPainter>
+#include <QFutureWatcher>
+
+#include "person.h"
+#include "treescene.h"
+#include "thumbnailcache.h"
+#include "tilecache.h"
 
 class FamilyTreeWidget : public QWidget
 {
@@ -10,6 +21,67 @@ class FamilyTreeWidget : public QWidget
 public:
     FamilyTreeWidget(QWidget *parent = 0);
     ~FamilyTreeWidget();
+
+    void setPersons(const QVector<Person*> &persons);
+    void updatePersons(const QVector<Person*> &changed);
+    void setLayoutParams(const LayoutParams &params);
+    const TreeScene &scene() const { return *m_scene; }
+    ThumbnailCache &thumbnails() { return m_thumbnails; }
+
+    double zoom() const { return m_scale; }
+    void setZoom(double scale, const QPointF &anchor);
+    void centerOn(const QPointF &worldPos);
+
+    // Плакат всего дерева, формат по расширению файла (png, pdf, svg)
+    int exportPoster(const QString &fileName, double scale = 1.0);
+
+signals:
+    void layoutReady();
+
+protected:
+    void paintEvent(QPaintEvent *event);
+    void mousePressEvent(QMouseEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
+    void mouseReleaseEvent(QMouseEvent *event);
+    void wheelEvent(QWheelEvent *event);
+
+private slots:
+    void layoutFinished();
+    void thumbnailReady(uint id);
+    void tileReady(int level, int tx, int ty);
+
+private:
+    struct LayoutJob
+    {
+       quint64 version;
+       TreeScene scene;
+    };
+
+    void startLayout();
+    QRectF visibleWorldRect(const QRect &screenRect) const;
+    QRect screenRect(const QRectF &worldRect) const;
+    void drawFallback(QPainter &painter, int level, const QRectF &rect);
+    std::shared_ptr<const RenderSnapshot> snapshot();
+
+    QVector<Person*> m_persons;
+    LayoutParams m_params;
+    std::shared_ptr<TreeScene> m_scene;   // общая со снимками, перед правкой копируется, если занята
+    QVector<Person*> m_scenePersons;    // люди в порядке узлов m_scene
+    QVector<Person*> m_layoutPersons;   // люди в порядке узлов считающейся раскладки
+    ThumbnailCache m_thumbnails;
+    TileCache m_tiles;
+    std::shared_ptr<const RenderSnapshot> m_snapshot;   // пусто - снимок устарел
+    std::vector<std::shared_ptr<Person>> m_records;    // копии людей для снимков, пусто - копировать заново
+    std::vector<int> m_dirtyRecords;                   // узлы, правленые после последнего снимка
+    quint64 m_version;
+    quint64 m_layoutSerial;                            // номер полной раскладки, для сброса кэшей текста
+    QFutureWatcher<LayoutJob> m_layoutWatcher;
+    bool m_layoutPending;
+
+    double m_scale;
+    QPointF m_offset;       // положение начала координат дерева на экране
+    QPoint m_dragStart;
+    bool m_dragging;
 };
 
 #endif // FAMILYTREEWIDGET_H
@@ -0,0 +1,473 @@
+#include "gedcomparser.h"
+
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+
+#include <QFile>
+#include <QDate>
+#include <QThread>
+#include <QThreadPool>
+#include <QTextCodec>
+#include <QtConcurrent/QtConcurrent>
+
+#include "writelog.h"
+
+static const char *MONTHS[12] = { "JAN", "FEB", "MAR", "APR", "MAY", "JUN", "JUL", "AUG", "SEP", "OCT", "NOV", "DEC" };
+
+void GedcomRecord::clear()
+{
+   type = OTHER;
+   xref.clear();
+   name.clear();
+   sex.clear();
+   birthDate.clear();
+   birthPlace.clear();
+   deathDate.clear();
+   info.clear();
+   photo.clear();
+   dead = false;
+   husband.clear();
+   wife.clear();
+   children.clear();
+}
+
+GedcomParser::GedcomParser()
+   : _ansiCodepage(GEDCOM_ANSI_CODEPAGE), _collect(nullptr)
+{
+   reset();
+}
+
+void GedcomParser::reset()
+{
+   _record.clear();
+   _inRecord = false;
+   for (std::string &tag : _context)
+      tag.clear();
+   _codec = nullptr;
+   _lines = 0;
+   _errors = 0;
+}
+
+int GedcomParser::parseFile(const QString &fileName, int threads)
+{
+   QFile file(fileName);
+   if (!file.open(QIODevice::ReadOnly))
+   {
+      writeDebugLog("GedcomParser::parseFile Could not open " + fileName);
+      return -1;
+   }
+
+   if (threads <= 0)
+      threads = QThread::idealThreadCount();
+   if ((threads > 1) && (file.size() > GEDCOM_CHUNK_SIZE))
+   {
+      // Если отобразить файл не вышло (32-битный процесс), читаем по-старому
+      uchar *data = file.map(0, file.size());
+      if (data)
+      {
+         const char *begin = reinterpret_cast<const char*>(data);
+         int ret = parseMapped(begin, begin + file.size(), threads);
+         file.unmap(data);
+         return ret;
+      }
+   }
+
+   // Блок читается целиком, строки режутся в нём на месте; хвост без перевода строки
+   // переносится в начало следующего блока
+   std::vector<char> buffer(GEDCOM_READ_BLOCK);
+   size_t carry = 0;
+   bool first = true;
+   while (true)
+   {
+      if (carry == buffer.size())
+         buffer.resize(buffer.size() * 2);
+      qint64 got = file.read(buffer.data() + carry, static_cast<qint64>(buffer.size() - carry));
+      if (got < 0)
+      {
+         writeDebugLog("GedcomParser::parseFile Read failed: " + file.errorString());
+         return -1;
+      }
+
+      size_t size = carry + static_cast<size_t>(got);
+      const char *begin = buffer.data();
+      const char *end = begin + size;
+      if (first && (size >= 3) && !memcmp(begin, "\xEF\xBB\xBF", 3))
+         begin += 3;
+      first = false;
+
+      begin = feedLines(begin, end);
+      carry = end - begin;
+      if (!got)
+      {
+         if (carry)
+            feedLine(begin, static_cast<int>(carry));
+         break;
+      }
+      memmove(buffer.data(), begin, carry);
+   }
+
+   finish();
+   return 0;
+}
+
+const char *GedcomParser::feedLines(const char *begin, const char *end)
+{
+   // Концом строки считаются и \n, и \r (старые файлы Mac); пустые строки от \r\n пропускаются
+   while (begin < end)
+   {
+      const char *eol = begin;
+      while ((eol < end) && (*eol != '\n') && (*eol != '\r'))
+         eol++;
+      if (eol == end)
+         break;
+      feedLine(begin, static_cast<int>(eol - begin));
+      begin = eol + 1;
+   }
+   return begin;
+}
+
+void GedcomParser::parseBuffer(const char *begin, const char *end)
+{
+   const char *tail = feedLines(begin, end);
+   if (tail < end)
+      feedLine(tail, static_cast<int>(end - tail));
+}
+
+const char *GedcomParser::nextRecord(const char *pos, const char *end)
+{
+   // Ближайшее после pos начало строки вида "0 ..."
+   while (pos < end)
+   {
+      while ((pos < end) && (*pos != '\n') && (*pos != '\r'))
+         pos++;
+      while ((pos < end) && ((*pos == '\n') || (*pos == '\r')))
+         pos++;
+      if ((end - pos >= 2) && (pos[0] == '0') && (pos[1] == ' '))
+         return pos;
+   }
+   return end;
+}
+
+GedcomParser::ChunkResult GedcomParser::parseChunk(const char *begin, const char *end, QTextCodec *codec)
+{
+   ChunkResult result;
+   GedcomParser parser;
+   parser.setCodec(codec);
+   parser._collect = &result.records;
+   parser.parseBuffer(begin, end);
+   parser.finish();
+   result.lines = parser.lineCount();
+   result.errors = parser.errorCount();
+   return result;
+}
+
+int GedcomParser::parseMapped(const char *data, const char *end, int threads)
+{
+   if ((end - data >= 3) && !memcmp(data, "\xEF\xBB\xBF", 3))
+      data += 3;
+
+   std::vector<const char*> bounds;
+   bounds.push_back(data);
+   for (const char *pos = data + GEDCOM_CHUNK_SIZE; pos < end; pos = bounds.back() + GEDCOM_CHUNK_SIZE)
+   {
+      const char *next = nextRecord(pos, end);
+      if (next == end)
+         break;
+      bounds.push_back(next);
+   }
+   bounds.push_back(end);
+
+   // Первый кусок с заголовком разбирается здесь же: из HEAD узнаётся кодировка для остальных
+   parseBuffer(bounds[0], bounds[1]);
+   finish();
+
+   QThreadPool pool;
+   pool.setMaxThreadCount(threads);
+   QTextCodec *codec = _codec;
+
+   // Записи отдаются по порядку кусков; впереди разбирается не больше двух кусков на поток
+   std::deque<QFuture<ChunkResult>> window;
+   size_t next = 1, chunks = bounds.size() - 1;
+   while ((next < chunks) || !window.empty())
+   {
+      while ((next < chunks) && (window.size() < static_cast<size_t>(threads) * 2))
+      {
+         window.push_back(QtConcurrent::run(&pool, &GedcomParser::parseChunk, bounds[next], bounds[next + 1], codec));
+         next++;
+      }
+
+      ChunkResult result = window.front().result();
+      window.pop_front();
+      if (onRecord)
+         for (const GedcomRecord &record : result.records)
+            onRecord(record);
+      _lines += result.lines;
+      _errors += result.errors;
+   }
+   return 0;
+}
+
+void GedcomParser::setCharset(const std::string &charset)
+{
+   if ((charset == "UTF-8") || (charset == "UTF8") || (charset == "ASCII"))
+   {
+      _codec = nullptr;
+      return;
+   }
+
+   _codec = (charset == "ANSI") ? QTextCodec::codecForName(_ansiCodepage) : nullptr;
+   if (!_codec)
+   {
+      // Latin-1 у QTextCodec есть всегда
+      writeDebugLog(QString("GedcomParser::setCharset ") + charset.c_str() + " decoded as Latin-1");
+      _codec = QTextCodec::codecForName("ISO-8859-1");
+   }
+}
+
+std::string GedcomParser::decode(const char *text, int length) const
+{
+   if (!_codec)
+      return std::string(text, length);
+
+   // toUnicode без состояния можно звать из разных потоков над одним кодеком
+   QByteArray utf8 = _codec->toUnicode(text, length).toUtf8();
+   return std::string(utf8.constData(), utf8.size());
+}
+
+void GedcomParser::feedLine(const char *line, int length)
+{
+   // уровень [@xref@] тег [значение]
+   const char *p = line, *end = line + length;
+   while ((end > p) && ((end[-1] == '\r') || (end[-1] == '\n')))
+      end--;
+   while ((p < end) && ((*p == ' ') || (*p == '\t')))
+      p++;
+   if (p == end)
+      return;
+   _lines++;
+
+   int level = 0;
+   const char *digits = p;
+   while ((p < end) && (*p >= '0') && (*p <= '9'))
+      level = level * 10 + (*p++ - '0');
+   if ((p == digits) || (p == end) || (*p != ' '))
+   {
+      _errors++;
+      return;
+   }
+   p++;
+
+   const char *xref = nullptr;
+   int xrefLength = 0;
+   if ((p < end) && (*p == '@'))
+   {
+      const char *close = static_cast<const char*>(memchr(p + 1, '@', end - p - 1));
+      if (!close)
+      {
+         _errors++;
+         return;
+      }
+      xref = p;
+      xrefLength = static_cast<int>(close + 1 - p);
+      p = close + 1;
+      while ((p < end) && (*p == ' '))
+         p++;
+   }
+
+   const char *tag = p;
+   while ((p < end) && (*p != ' '))
+      p++;
+   std::string tagName(tag, p - tag);
+   if (p < end)
+      p++;
+   const char *value = p;
+   int valueLength = static_cast<int>(end - p);
+
+   if (level == 0)
+   {
+      flush();
+      _inRecord = true;
+      if (tagName == "INDI")
+         _record.type = GedcomRecord::INDI;
+      else if (tagName == "FAM")
+         _record.type = GedcomRecord::FAM;
+      else if (tagName == "HEAD")
+         _record.type = GedcomRecord::HEAD;
+      else
+         _record.type = GedcomRecord::OTHER;
+      if (xref)
+         _record.xref.assign(xref, xrefLength);
+      _context[0] = tagName;
+      return;
+   }
+
+   if (!_inRecord || (level >= GEDCOM_MAX_LEVEL))
+      return;
+   _context[level] = tagName;
+   const std::string &parent = _context[level - 1];
+
+   switch (_record.type)
+   {
+   case GedcomRecord::HEAD:
+      if ((level == 1) && (tagName == "CHAR"))
+         setCharset(std::string(value, valueLength));
+      break;
+
+   case GedcomRecord::INDI:
+      if (level == 1)
+      {
+         if ((tagName == "NAME") && _record.name.empty())
+            _record.name = convertName(decode(value, valueLength));
+         else if ((tagName == "SEX") && valueLength)
+            _record.sex.assign(value, 1);
+         else if (tagName == "DEAT")
+            _record.dead = true;
+         else if ((tagName == "NOTE") && valueLength && (*value != '@'))
+         {
+            if (!_record.info.empty())
+               _record.info += '\n';
+            _record.info += decode(value, valueLength);
+         }
+      }
+      else if (level == 2)
+      {
+         if ((parent == "BIRT") && (tagName == "DATE"))
+            _record.birthDate = convertDate(std::string(value, valueLength));
+         else if ((parent == "BIRT") && (tagName == "PLAC"))
+            _record.birthPlace = decode(value, valueLength);
+         else if ((parent == "DEAT") && (tagName == "DATE"))
+            _record.deathDate = convertDate(std::string(value, valueLength));
+         else if ((parent == "NOTE") && (tagName == "CONT"))
+            _record.info += '\n' + decode(value, valueLength);
+         else if ((parent == "NOTE") && (tagName == "CONC"))
+            _record.info += decode(value, valueLength);
+         else if ((parent == "OBJE") && (tagName == "FILE") && _record.photo.empty())
+            _record.photo = decode(value, valueLength);
+      }
+      break;
+
+   case GedcomRecord::FAM:
+      if (level == 1)
+      {
+         if (tagName == "HUSB")
+            _record.husband.assign(value, valueLength);
+         else if (tagName == "WIFE")
+            _record.wife.assign(value, valueLength);
+         else if (tagName == "CHIL")
+            _record.children.emplace_back(value, valueLength);
+      }
+      break;
+
+   default:
+      break;
+   }
+}
+
+void GedcomParser::flush()
+{
+   if (_inRecord && _collect)
+      _collect->push_back(std::move(_record));
+   else if (_inRecord && onRecord)
+      onRecord(_record);
+   _record.clear();
+   _inRecord = false;
+}
+
+void GedcomParser::finish()
+{
+   flush();
+}
+
+std::string GedcomParser::convertName(const std::string &name)
+{
+   // "Иван Петрович /Сидоров/" -> "Сидоров Иван Петрович": фамилия выделена косыми чертами,
+   // а в программе она идёт первой
+   std::string given, surname;
+   bool inSurname = false;
+   bool space = false;
+   for (char c : name)
+   {
+      std::string &out = inSurname ? surname : given;
+      if (c == '/')
+      {
+         inSurname = !inSurname;
+         space = true;
+         continue;
+      }
+      if ((c == ' ') || (c == '\t'))
+      {
+         space = true;
+         continue;
+      }
+      if (space && !out.empty())
+         out += ' ';
+      space = false;
+      out += c;
+   }
+   if (surname.empty())
+      return given;
+   if (given.empty())
+      return surname;
+   return surname + ' ' + given;
+}
+
+std::string GedcomParser::convertDate(const std::string &date)
+{
+   // Берётся первая точная дата: "ABT 1900", "BET 1 JAN 1900 AND 1910", "@#DJULIAN@ 5 MAR 1700"...
+   std::vector<std::string> parts;
+   size_t pos = 0;
+   while (pos < date.size())
+   {
+      size_t next = date.find(' ', pos);
+      if (next == std::string::npos)
+         next = date.size();
+      std::string token = date.substr(pos, next - pos);
+      pos = next + 1;
+      if (token.empty() || (token[0] == '@'))
+         continue;
+      for (char &c : token)
+         c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+
+      if ((token == "AND") || (token == "TO"))
+      {
+         if (!parts.empty())
+            break;
+         continue;
+      }
+      if ((token == "ABT") || (token == "CAL") || (token == "EST") || (token == "BEF") || (token == "AFT")
+            || (token == "BET") || (token == "FROM") || (token == "INT"))
+         continue;
+      if (token[0] == '(')
+         break;
+      parts.push_back(token);
+      if (parts.size() == 3)
+         break;
+   }
+
+   int day = 1, month = 1, year = 0;
+   size_t yearPart = parts.size() - 1;
+   if (parts.empty())
+      return std::string();
+
+   // Год вида 1699/00 (двойная датировка) - берётся первая часть
+   year = atoi(parts[yearPart].c_str());
+   if (parts.size() >= 2)
+   {
+      const std::string &mon = parts[yearPart - 1];
+      month = 0;
+      for (int m = 0; m < 12; m++)
+         if (mon == MONTHS[m])
+            month = m + 1;
+   }
+   if (parts.size() == 3)
+      day = atoi(parts[0].c_str());
+
+   if (!QDate::isValid(year, month, day))
+      return std::string();
+
+   char buf[16];
+   snprintf(buf, sizeof(buf), "%02d.%02d.%04d", day, month, year);
+   return buf;
+}
@@ -0,0 +1,116 @@
+#ifndef GEDCOMPARSER_H
+#define GEDCOMPARSER_H
+
+/*
+ * Потоковый разбор GEDCOM 5.5.1.
+ * Файл читается блоками и режется на строки, строки проходят через автомат записей:
+ * запись уровня 0 копится, пока не начнётся следующая, и затем целиком отдаётся в onRecord.
+ * В памяти всегда только одна запись, так что размер файла не важен.
+ * Из INDI берутся имя, пол, рождение, смерть, заметки и первое фото, из FAM - супруги и дети.
+ * Кодировки: UTF-8 и ASCII как есть, ANSI - через QTextCodec в кодовой странице setAnsiCodepage()
+ * (по умолчанию windows-1251: русские программы пишут ANSI именно в ней), прочие (ANSEL и т.п.)
+ * приближённо как Latin-1 с записью в лог.
+ * Большие файлы можно разбирать параллельно: файл отображается в память, режется на куски
+ * по границам записей уровня 0, куски разбираются в пуле потоков, а записи отдаются в onRecord
+ * строго в порядке файла. Одновременно в работе ограниченное окно кусков.
+ */
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <QString>
+#include <QByteArray>
+
+class QTextCodec;
+
+#define GEDCOM_MAX_LEVEL    16
+#define GEDCOM_READ_BLOCK   (1024 * 1024)
+#define GEDCOM_CHUNK_SIZE   (8 * 1024 * 1024)
+#define GEDCOM_ANSI_CODEPAGE "windows-1251"
+
+struct GedcomRecord
+{
+   enum Type
+   {
+      OTHER,
+      HEAD,
+      INDI,
+      FAM
+   };
+
+   Type type;
+   std::string xref;
+
+   // INDI, строки уже в UTF-8, даты в виде dd.MM.yyyy
+   std::string name;
+   std::string sex;
+   std::string birthDate;
+   std::string birthPlace;
+   std::string deathDate;
+   std::string info;
+   std::string photo;     // путь из OBJE/FILE как записан в файле
+   bool dead;
+
+   // FAM
+   std::string husband;
+   std::string wife;
+   std::vector<std::string> children;
+
+   void clear();
+};
+
+class GedcomParser
+{
+public:
+   GedcomParser();
+
+   void reset();
+   // threads: 1 - последовательное чтение блоками, 0 - по числу ядер
+   int parseFile(const QString &fileName, int threads = 1);
+
+   // Строка без перевода строки; законченные записи уходят в onRecord
+   void feedLine(const char *line, int length);
+   void parseBuffer(const char *begin, const char *end);
+   void finish();
+
+   // Кодовая страница для "1 CHAR ANSI", имя в понятном QTextCodec виде
+   void setAnsiCodepage(const QByteArray &codepage) { _ansiCodepage = codepage; }
+   // nullptr - текст в UTF-8 и не перекодируется
+   QTextCodec *codec() const { return _codec; }
+   void setCodec(QTextCodec *codec) { _codec = codec; }
+   long lineCount() const { return _lines; }
+   long errorCount() const { return _errors; }
+
+   static std::string convertDate(const std::string &date);
+   static std::string convertName(const std::string &name);
+
+   std::function<void(const GedcomRecord &record)> onRecord;
+
+private:
+   struct ChunkResult
+   {
+      std::vector<GedcomRecord> records;
+      long lines;
+      long errors;
+   };
+
+   const char *feedLines(const char *begin, const char *end);
+   int parseMapped(const char *data, const char *end, int threads);
+   static ChunkResult parseChunk(const char *begin, const char *end, QTextCodec *codec);
+   static const char *nextRecord(const char *pos, const char *end);
+   void flush();
+   void setCharset(const std::string &charset);
+   std::string decode(const char *text, int length) const;
+
+   GedcomRecord _record;
+   bool _inRecord;
+   std::string _context[GEDCOM_MAX_LEVEL];
+   QTextCodec *_codec;
+   QByteArray _ansiCodepage;
+   std::vector<GedcomRecord> *_collect;   // куда переносить записи вместо onRecord (разбор куска)
+   long _lines;
+   long _errors;
+};
+
+#endif // GEDCOMPARSER_H
@@ -0,0 +1,279 @@
+#include "namematcher.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+// à..ÿ без диакритики; ÷ не буква
+static const char LATIN1_BASE[] = "aaaaaaaceeeeiiiidnooooo\x7Fouuuuyty";
+
+static const unsigned char UNKNOWN_UNIT = 0x7F;
+
+static uint32_t nextCodePoint(const std::string &str, size_t &pos)
+{
+   unsigned char c = static_cast<unsigned char>(str[pos++]);
+   int extra = (c >= 0xF0) ? 3 : (c >= 0xE0) ? 2 : (c >= 0xC0) ? 1 : 0;
+   uint32_t cp = (extra == 3) ? (c & 0x07) : (extra == 2) ? (c & 0x0F) : (extra == 1) ? (c & 0x1F) : c;
+   for (int i = 0; (i < extra) && (pos < str.size()); i++)
+      cp = (cp << 6) | (static_cast<unsigned char>(str[pos++]) & 0x3F);
+   return cp;
+}
+
+static unsigned char unitOf(uint32_t cp)
+{
+   if ((cp >= 'A') && (cp <= 'Z'))
+      return static_cast<unsigned char>(cp + 'a' - 'A');
+   if (cp < 0x80)
+      return static_cast<unsigned char>(cp);
+
+   // Кириллица на местах cp1251
+   if ((cp >= 0x410) && (cp <= 0x42F))
+      cp += 0x20;
+   if ((cp >= 0x430) && (cp <= 0x44F))
+      return static_cast<unsigned char>(0xE0 + cp - 0x430);
+
+   if ((cp >= 0xC0) && (cp <= 0xDE) && (cp != 0xD7))
+      cp += 0x20;
+   if ((cp >= 0xE0) && (cp <= 0xFF))
+      return static_cast<unsigned char>(LATIN1_BASE[cp - 0xE0]);
+
+   switch (cp)
+   {
+   case 0x401: case 0x451: return 0xE5;   // ё как е
+   case 0x404: case 0x454: return 0xBA;   // є
+   case 0x406: case 0x456: return 0xB3;   // і
+   case 0x407: case 0x457: return 0xBF;   // ї
+   case 0x40E: case 0x45E: return 0xA2;   // ў
+   case 0x490: case 0x491: return 0xB4;   // ґ
+   case 0x10C: case 0x10D: case 0x106: case 0x107: return 'c';   // č ć
+   case 0x160: case 0x161: case 0x15A: case 0x15B: return 's';   // š ś
+   case 0x17D: case 0x17E: case 0x179: case 0x17A: case 0x17B: case 0x17C: return 'z';   // ž ź ż
+   case 0x141: case 0x142: return 'l';    // ł
+   case 0x143: case 0x144: return 'n';    // ń
+   case 0x158: case 0x159: return 'r';    // ř
+   case 0xDF: return 's';                 // ß
+   case 0x2019: case 0x02BC: return '\'';
+   default: return UNKNOWN_UNIT;
+   }
+}
+
+std::string NameMatcher::normalize(const std::string &utf8)
+{
+   std::string units;
+   units.reserve(utf8.size());
+   bool space = false;
+   size_t pos = 0;
+   while (pos < utf8.size())
+   {
+      unsigned char unit = unitOf(nextCodePoint(utf8, pos));
+      if ((unit == ' ') || (unit == '\t') || (unit == '\r') || (unit == '\n'))
+      {
+         space = !units.empty();
+         continue;
+      }
+      if (space)
+         units += ' ';
+      space = false;
+      units += static_cast<char>(unit);
+   }
+   return units;
+}
+
+NameMatcher::NameMatcher(const std::string &pattern, int maxDistance, bool transpositions)
+   : _pattern(normalize(pattern)), _maxDistance(std::max(0, maxDistance)), _transpositions(transpositions)
+{
+   std::fill(_peq, _peq + 256, 0);
+   if (_pattern.size() <= NAME_MATCH_MAX_PATTERN)
+      for (size_t i = 0; i < _pattern.size(); i++)
+         _peq[static_cast<unsigned char>(_pattern[i])] |= 1ull << i;
+}
+
+int NameMatcher::naiveDistance(const std::string &a, const std::string &b, bool transpositions)
+{
+   size_t n = b.size();
+   std::vector<int> prev2(n + 1), prev(n + 1), cur(n + 1);
+   for (size_t j = 0; j <= n; j++)
+      prev[j] = static_cast<int>(j);
+
+   for (size_t i = 1; i <= a.size(); i++)
+   {
+      cur[0] = static_cast<int>(i);
+      for (size_t j = 1; j <= n; j++)
+      {
+         int cost = (a[i - 1] == b[j - 1]) ? 0 : 1;
+         cur[j] = std::min(std::min(prev[j] + 1, cur[j - 1] + 1), prev[j - 1] + cost);
+         if (transpositions && (i > 1) && (j > 1) && (a[i - 1] == b[j - 2]) && (a[i - 2] == b[j - 1]))
+            cur[j] = std::min(cur[j], prev2[j - 2] + 1);
+      }
+      std::swap(prev2, prev);
+      std::swap(prev, cur);
+   }
+   return prev[n];
+}
+
+int NameMatcher::distance(const std::string &text) const
+{
+   int m = length(), n = static_cast<int>(text.size());
+   if (abs(m - n) > _maxDistance)
+      return _maxDistance + 1;
+   if (!m || !n)
+      return std::max(m, n);
+   if (m > NAME_MATCH_MAX_PATTERN)
+      return std::min(naiveDistance(_pattern, text, _transpositions), _maxDistance + 1);
+
+   // Хюрё: столбец D[.][j] хранится разностями соседних клеток (VP - +1, VN - -1),
+   // score - нижняя клетка D[m][j]
+   const uint64_t last = 1ull << (m - 1);
+   const uint64_t trMask = _transpositions ? ~0ull : 0;
+   uint64_t vp = ~0ull, vn = 0, d0 = 0, prevEq = 0;
+   int score = m;
+   // Клетка на диагонали конечной D[m][n]: вдоль диагонали значения не убывают, поэтому
+   // она - нижняя граница ответа, и растёт с каждой несовпавшей буквой
+   int shift = m - n, diag = abs(shift);
+   for (int j = 0; j < n; j++)
+   {
+      uint64_t eq = _peq[static_cast<unsigned char>(text[j])];
+      uint64_t tr = (((~d0) & eq) << 1) & prevEq & trMask;
+      d0 = (((eq & vp) + vp) ^ vp) | eq | vn | tr;
+      uint64_t hp = vn | ~(d0 | vp);
+      uint64_t hn = vp & d0;
+      if (hp & last)
+         score++;
+      if (hn & last)
+         score--;
+      hp = (hp << 1) | 1;
+      hn <<= 1;
+      vp = hn | ~(d0 | hp);
+      vn = hp & d0;
+      prevEq = eq;
+
+      int row = j + shift;
+      if (row >= 0)
+         diag += static_cast<int>(((d0 >> row) & 1) ^ 1);
+      // Каждая оставшаяся буква уменьшает D[m][.] не больше чем на 1
+      if ((diag > _maxDistance) || (score - (n - j - 1) > _maxDistance))
+         return _maxDistance + 1;
+   }
+   return std::min(score, _maxDistance + 1);
+}
+
+void NameMatcher::distanceLanes(const std::vector<std::string> &texts, const std::vector<size_t> &candidates,
+                                std::vector<int> &result) const
+{
+   const int m = length();
+   const int64_t k = _maxDistance;
+   const uint64_t trMask = _transpositions ? ~0ull : 0;
+   static const char EMPTY[1] = { 0 };
+
+   uint64_t vp[NAME_MATCH_LANES], vn[NAME_MATCH_LANES], d0[NAME_MATCH_LANES], prevEq[NAME_MATCH_LANES];
+   uint64_t eq[NAME_MATCH_LANES], busy[NAME_MATCH_LANES];
+   int64_t score[NAME_MATCH_LANES], pos[NAME_MATCH_LANES], len[NAME_MATCH_LANES], done[NAME_MATCH_LANES];
+   int64_t diag[NAME_MATCH_LANES], row[NAME_MATCH_LANES];
+   const char *text[NAME_MATCH_LANES];
+   size_t owner[NAME_MATCH_LANES];
+
+   // Дорожка, закончившая кандидата или бросившая его по отсечению, сразу берёт следующего,
+   // так что все дорожки заняты до конца списка
+   size_t next = 0;
+   int running = 0;
+   auto load = [&](int l)
+   {
+      vp[l] = ~0ull;
+      vn[l] = d0[l] = prevEq[l] = 0;
+      score[l] = m;
+      pos[l] = 0;
+      if (next < candidates.size())
+      {
+         owner[l] = candidates[next++];
+         text[l] = texts[owner[l]].data();
+         len[l] = static_cast<int64_t>(texts[owner[l]].size());
+         row[l] = m - len[l];
+         diag[l] = std::abs(row[l]);
+         busy[l] = ~0ull;
+         running++;
+      }
+      else
+      {
+         text[l] = EMPTY;
+         len[l] = 1;
+         row[l] = diag[l] = 0;
+         busy[l] = 0;
+      }
+   };
+   for (int l = 0; l < NAME_MATCH_LANES; l++)
+      load(l);
+
+   while (running)
+   {
+      // Выборка масок по буквам - скалярная, дальше все дорожки одними операциями
+      for (int l = 0; l < NAME_MATCH_LANES; l++)
+         eq[l] = _peq[static_cast<unsigned char>(text[l][pos[l]])];
+
+      for (int l = 0; l < NAME_MATCH_LANES; l++)
+      {
+         uint64_t e = eq[l];
+         uint64_t tr = (((~d0[l]) & e) << 1) & prevEq[l] & trMask;
+         uint64_t d = (((e & vp[l]) + vp[l]) ^ vp[l]) | e | vn[l] | tr;
+         uint64_t hp = vn[l] | ~(d | vp[l]);
+         uint64_t hn = vp[l] & d;
+         score[l] += static_cast<int64_t>((hp >> (m - 1)) & 1) - static_cast<int64_t>((hn >> (m - 1)) & 1);
+         hp = (hp << 1) | 1;
+         hn <<= 1;
+         vp[l] = hn | ~(d | hp);
+         vn[l] = hp & d;
+         d0[l] = d;
+         prevEq[l] = e;
+         pos[l] += static_cast<int64_t>(busy[l] & 1);
+
+         // Диагональ конечной клетки - как в distance(); до её начала (row < 0) не считается
+         uint64_t onDiag = 0ull - static_cast<uint64_t>(row[l] >= 0);
+         diag[l] += static_cast<int64_t>(((d >> (row[l] & 63)) & 1 & onDiag) ^ (onDiag & 1));
+         row[l]++;
+
+         // Текст кончился или оставшиеся буквы уже не опустят расстояние до k
+         int64_t left = len[l] - pos[l];
+         done[l] = static_cast<int64_t>(busy[l] & ((left == 0) | (score[l] - left > k) | (diag[l] > k)));
+      }
+
+      int64_t any = 0;
+      for (int l = 0; l < NAME_MATCH_LANES; l++)
+         any |= done[l];
+      if (!any)
+         continue;
+
+      for (int l = 0; l < NAME_MATCH_LANES; l++)
+      {
+         if (!done[l])
+            continue;
+         result[owner[l]] = static_cast<int>((pos[l] < len[l]) ? k + 1 : std::min(score[l], k + 1));
+         running--;
+         load(l);
+      }
+   }
+}
+
+void NameMatcher::distances(const std::vector<std::string> &texts, std::vector<int> &result, bool lanes) const
+{
+   int m = length();
+   result.assign(texts.size(), _maxDistance + 1);
+   if (!lanes || !m || (m > NAME_MATCH_MAX_PATTERN))
+   {
+      for (size_t i = 0; i < texts.size(); i++)
+         result[i] = distance(texts[i]);
+      return;
+   }
+
+   // По дорожкам раскладываются только кандидаты, прошедшие по длине
+   std::vector<size_t> candidates;
+   candidates.reserve(texts.size());
+   for (size_t i = 0; i < texts.size(); i++)
+   {
+      int n = static_cast<int>(texts[i].size());
+      if (abs(m - n) > _maxDistance)
+         continue;
+      if (n)
+         candidates.push_back(i);
+      else
+         result[i] = m;
+   }
+   distanceLanes(texts, candidates, result);
+}
@@ -0,0 +1,55 @@
+#ifndef NAMEMATCHER_H
+#define NAMEMATCHER_H
+
+/*
+ * Нечёткое сравнение имён с ограничением расстояния (опечатки в отчестве, "Петровичь").
+ * Имя приводится к однобайтовым кодам: строчные буквы, кириллица - как в cp1251, ё = е,
+ * латиница с диакритикой - базовой буквой, пробелы схлопнуты. Одна буква - один код,
+ * поэтому расстояние считается в буквах, а не в байтах UTF-8.
+ * Расстояние Левенштейна (или с перестановкой соседних букв, Дамерау) считается
+ * битпараллельным алгоритмом Майерса/Хюрё: столбец матрицы - два 64-битных вектора,
+ * шаг по букве - десяток логических операций. Кандидат отбрасывается, как только
+ * расстояние уже не может опуститься до maxDistance: по нижней клетке столбца и по клетке
+ * на диагонали конечной (вдоль диагонали значения не убывают).
+ * В режиме дорожек distances() ведёт NAME_MATCH_LANES кандидатов одновременно: у каждой
+ * дорожки свои векторы, цикл по дорожкам компилятор разворачивает в SIMD, а освободившаяся
+ * дорожка сразу берёт следующего кандидата. С отсечением по диагонали большинство кандидатов
+ * бросается через несколько букв, и скалярный цикл не уступает дорожкам; дорожки выигрывают
+ * только с AVX2 и большим maxDistance, поэтому по умолчанию выключены (см. Benchmarks/fuzzy_bench).
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define NAME_MATCH_LANES        8
+#define NAME_MATCH_MAX_PATTERN  64   // длиннее - обычная динамика
+
+class NameMatcher
+{
+public:
+   NameMatcher(const std::string &pattern, int maxDistance, bool transpositions = true);
+
+   int length() const { return static_cast<int>(_pattern.size()); }
+   int maxDistance() const { return _maxDistance; }
+
+   // Тексты уже нормализованы; больше maxDistance - возвращается maxDistance + 1
+   int distance(const std::string &text) const;
+   void distances(const std::vector<std::string> &texts, std::vector<int> &result,
+                  bool lanes = false) const;
+
+   static std::string normalize(const std::string &utf8);
+   // Полная матрица без отсечения - для проверки и сравнения скорости
+   static int naiveDistance(const std::string &a, const std::string &b, bool transpositions);
+
+private:
+   void distanceLanes(const std::vector<std::string> &texts, const std::vector<size_t> &candidates,
+                      std::vector<int> &result) const;
+
+   std::string _pattern;
+   int _maxDistance;
+   bool _transpositions;
+   uint64_t _peq[256];   // биты позиций буквы в образце
+};
+
+#endif // NAMEMATCHER_H
@@ -2,6 +2,53 @@
 
 uint32_t Person::global_id = 0;
 
+int8_t Person::sexOf(const QString &sex)
+{
+   if (sex.isEmpty())
+      return SEX_UNKNOWN;
+   ushort c = sex.at(0).unicode();
+   if ((c == 'M') || (c == 'm') || (c == 0x41C) || (c == 0x43C))
+      return SEX_MALE;
+   if ((c == 'F') || (c == 'f') || (c == 0x416) || (c == 0x436))
+      return SEX_FEMALE;
+   return SEX_UNKNOWN;
+}
+
+int8_t Person::sexOf(const std::string &sex)
+{
+   // М и Ж в UTF-8 - по два байта
+   if (sex.empty())
+      return SEX_UNKNOWN;
+   if ((sex[0] == 'M') || (sex[0] == 'm') || !sex.compare(0, 2, "\xD0\x9C") || !sex.compare(0, 2, "\xD0\xBC"))
+      return SEX_MALE;
+   if ((sex[0] == 'F') || (sex[0] == 'f') || !sex.compare(0, 2, "\xD0\x96") || !sex.compare(0, 2, "\xD0\xB6"))
+      return SEX_FEMALE;
+   return SEX_UNKNOWN;
+}
+
+void PersonColumns::clear()
+{
+   birthYear.clear();
+   birthMonthDay.clear();
+   deathYear.clear();
+   deathMonthDay.clear();
+   place.clear();
+   sex.clear();
+   children.clear();
+   places.clear();
+}
+
+void PersonColumns::reserve(size_t count)
+{
+   birthYear.reserve(count);
+   birthMonthDay.reserve(count);
+   deathYear.reserve(count);
+   deathMonthDay.reserve(count);
+   place.reserve(count);
+   sex.reserve(count);
+   children.reserve(count);
+}
+
 #ifdef PERSON_CLASS
 
 int Person::global_id;
@@ -1,10 +1,54 @@
 #ifndef PERSON_H
 #define PERSON_H
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include <QString>
 #include <QDate>
 #include <QVector>
 
+// Поля человека - для учёта правок и частичного сохранения
+enum PersonField
+{
+   FIELD_NAME        = 0x001,
+   FIELD_BIRTH_DATE  = 0x002,
+   FIELD_DEATH       = 0x004,    // жив/умер и дата смерти
+   FIELD_INFO        = 0x008,
+   FIELD_BIRTH_PLACE = 0x010,
+   FIELD_PHOTO       = 0x020,
+   FIELD_SEX         = 0x040,
+   FIELD_PARENTS     = 0x080,
+   FIELD_CHILDREN    = 0x100,
+   FIELD_ALL         = 0x1FF
+};
+
+enum PersonSex
+{
+   SEX_UNKNOWN,
+   SEX_MALE,
+   SEX_FEMALE,
+   SEX_COUNT
+};
+
+// Поля людей по столбцам для отчётов; 0 - не указано
+struct PersonColumns
+{
+   std::vector<int32_t> birthYear;
+   std::vector<int32_t> birthMonthDay;   // месяц * 100 + день
+   std::vector<int32_t> deathYear;       // у живых 0
+   std::vector<int32_t> deathMonthDay;
+   std::vector<int32_t> place;           // индекс в places, -1 - не указано
+   std::vector<int8_t> sex;              // PersonSex
+   std::vector<int32_t> children;
+   std::vector<QString> places;
+
+   void clear();
+   void reserve(size_t count);
+   size_t size() const { return birthYear.size(); }
+};
+
 struct Person
 {
    uint32_t id;
@@ -22,6 +66,12 @@ struct Person
    QVector<Person*> children;
 
    static uint32_t global_id;
+
+   // PersonSex по первой букве в любом регистре: "Мужской"/"Женский" в программе,
+   // М/Ж у TreeGenerator, M/F из GEDCOM
+   static int8_t sexOf(const QString &sex);
+   static int8_t sexOf(const std::string &sex);   // UTF-8
+
    Person()
    {
       id = ++global_id;
@@ -0,0 +1,230 @@
+#include "phonetickey.h"
+
+#include <cstdint>
+
+// а..я по порядку
+static const char *CYRILLIC[32] = {
+   "a", "b", "v", "g", "d", "e", "zh", "z", "i", "i", "k", "l", "m", "n", "o", "p",
+   "r", "s", "t", "u", "f", "kh", "ts", "ch", "sh", "shch", "", "y", "", "e", "yu", "ya"
+};
+
+// Латинские буквы как отдельные строки: "a\0b\0..."
+static const char ASCII_LETTERS[] = "a\0b\0c\0d\0e\0f\0g\0h\0i\0j\0k\0l\0m\0n\0o\0p\0q\0r\0s\0t\0u\0v\0w\0x\0y\0z";
+
+// Латиница-1 от U+00E0 (à) до U+00FF (ÿ); знак деления на месте U+00F7 не используется
+static const char *LATIN1[32] = {
+   "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+   "d", "n", "o", "o", "o", "o", "o", "-", "o", "u", "u", "u", "u", "y", "th", "y"
+};
+
+static uint32_t nextCodePoint(const std::string &str, size_t &pos)
+{
+   unsigned char c = static_cast<unsigned char>(str[pos++]);
+   int extra = (c >= 0xF0) ? 3 : (c >= 0xE0) ? 2 : (c >= 0xC0) ? 1 : 0;
+   uint32_t cp = (extra == 3) ? (c & 0x07) : (extra == 2) ? (c & 0x0F) : (extra == 1) ? (c & 0x1F) : c;
+   for (int i = 0; (i < extra) && (pos < str.size()); i++)
+      cp = (cp << 6) | (static_cast<unsigned char>(str[pos++]) & 0x3F);
+   return cp;
+}
+
+// Латинское написание буквы; nullptr - разделитель слов, "" - буква без звука (ь, ъ, апостроф)
+static const char *latinOf(uint32_t cp)
+{
+   if ((cp >= 'A') && (cp <= 'Z'))
+      cp += 'a' - 'A';
+   if ((cp >= 'a') && (cp <= 'z'))
+      return ASCII_LETTERS + 2 * (cp - 'a');
+   if ((cp == '\'') || (cp == 0x2019) || (cp == 0x02BC))
+      return "";
+
+   if ((cp >= 0x410) && (cp <= 0x42F))
+      cp += 0x20;
+   if ((cp >= 0x430) && (cp <= 0x44F))
+      return CYRILLIC[cp - 0x430];
+
+   if ((cp >= 0xC0) && (cp <= 0xDE) && (cp != 0xD7))
+      cp += 0x20;
+   if (cp == 0xDF)
+      return "ss";
+   if ((cp >= 0xE0) && (cp <= 0xFF))
+      return (cp == 0xF7) ? nullptr : LATIN1[cp - 0xE0];
+
+   switch (cp)
+   {
+   case 0x401: case 0x451: return "e";     // ё
+   case 0x404: case 0x454: return "e";     // є
+   case 0x406: case 0x456: return "i";     // і
+   case 0x407: case 0x457: return "i";     // ї
+   case 0x490: case 0x491: return "g";     // ґ
+   case 0x10C: case 0x10D: return "ch";    // č
+   case 0x106: case 0x107: return "c";     // ć
+   case 0x160: case 0x161: return "sh";    // š
+   case 0x15A: case 0x15B: return "s";     // ś
+   case 0x17D: case 0x17E: return "zh";    // ž
+   case 0x179: case 0x17A: case 0x17B: case 0x17C: return "z";   // ź ż
+   case 0x141: case 0x142: return "l";     // ł
+   case 0x143: case 0x144: return "n";     // ń
+   case 0x158: case 0x159: return "r";     // ř
+   default: return nullptr;
+   }
+}
+
+std::string PhoneticKey::transliterate(const std::string &word)
+{
+   std::string latin;
+   size_t pos = 0;
+   while (pos < word.size())
+   {
+      const char *letter = latinOf(nextCodePoint(word, pos));
+      if (letter)
+         latin += letter;
+   }
+   return latin;
+}
+
+std::string PhoneticKey::encode(const std::string &latin)
+{
+   std::string code;
+   char last = 0;
+   size_t n = latin.size();
+
+   auto starts = [&latin, n](size_t i, const char *with)
+   {
+      for (size_t k = 0; with[k]; k++)
+         if ((i + k >= n) || (latin[i + k] != with[k]))
+            return false;
+      return true;
+   };
+
+   for (size_t i = 0; (i < n) && (code.size() < PHONETIC_MAX_CODE); )
+   {
+      char c = latin[i];
+      char digit;
+      size_t step = 1;
+
+      // Буквосочетания разных транслитераций одного звука
+      if (starts(i, "shch") || starts(i, "tsch"))
+      {
+         digit = '7';
+         step = 4;
+      }
+      else if (starts(i, "sch") || starts(i, "tch"))
+      {
+         digit = '7';
+         step = 3;
+      }
+      else if (starts(i, "chr") || starts(i, "chl"))
+      {
+         // Немецкое ch перед согласной - х (Chruschtschow)
+         digit = '2';
+         step = 2;
+      }
+      else if (starts(i, "ch") || starts(i, "sh") || starts(i, "zh") || starts(i, "ts")
+               || starts(i, "tz") || starts(i, "cz") || starts(i, "sz"))
+      {
+         digit = '7';
+         step = 2;
+      }
+      else if (starts(i, "kh") || starts(i, "ck"))
+      {
+         digit = '2';
+         step = 2;
+      }
+      else if (starts(i, "ph"))
+      {
+         digit = '1';
+         step = 2;
+      }
+      else if (starts(i, "th"))
+      {
+         digit = '3';
+         step = 2;
+      }
+      else
+      {
+         switch (c)
+         {
+         case 'b': case 'p': case 'f': case 'v': case 'w':
+            digit = '1';
+            break;
+         case 'g': case 'k': case 'q': case 'h':
+            digit = '2';
+            break;
+         case 'c':
+            // Перед e, i, y - как ц
+            digit = ((i + 1 < n) && ((latin[i + 1] == 'e') || (latin[i + 1] == 'i') || (latin[i + 1] == 'y'))) ? '7' : '2';
+            break;
+         case 'x':
+            if (last != '2')
+               code += '2';
+            digit = '7';
+            break;
+         case 'd': case 't':
+            digit = '3';
+            break;
+         case 'l':
+            digit = '4';
+            break;
+         case 'm': case 'n':
+            digit = '5';
+            break;
+         case 'r':
+            digit = '6';
+            break;
+         case 's': case 'z':
+            digit = '7';
+            break;
+         default:
+            // Гласные (и j, й) только разделяют повторы; слово с гласной начинается с 0
+            if (code.empty())
+               code += '0';
+            last = 0;
+            i++;
+            continue;
+         }
+      }
+
+      if (digit != last)
+         code += digit;
+      last = digit;
+      i += step;
+   }
+
+   if (code.size() > PHONETIC_MAX_CODE)
+      code.resize(PHONETIC_MAX_CODE);
+   return code;
+}
+
+std::string PhoneticKey::ofWord(const std::string &word)
+{
+   return encode(transliterate(word));
+}
+
+std::string PhoneticKey::ofName(const std::string &name)
+{
+   std::string key;
+   std::string latin;
+   size_t pos = 0;
+
+   auto flush = [&key, &latin]()
+   {
+      std::string code = encode(latin);
+      latin.clear();
+      if (code.empty())
+         return;
+      if (!key.empty())
+         key += ' ';
+      key += code;
+   };
+
+   while (pos < name.size())
+   {
+      const char *letter = latinOf(nextCodePoint(name, pos));
+      if (letter)
+         latin += letter;
+      else
+         flush();
+   }
+   flush();
+   return key;
+}
@@ -0,0 +1,32 @@
+#ifndef PHONETICKEY_H
+#define PHONETICKEY_H
+
+/*
+ * Фонетический ключ имени для поиска "звучит похоже".
+ * Каждое слово сначала приводится к латинице (кириллица транслитерируется,
+ * буквы с диакритикой упрощаются), затем кодируется вариантом Soundex под русские фамилии:
+ * звонкие и глухие пары в одной группе (б/п, в/ф, г/к, д/т, з/с, ж/ш),
+ * шипящие и ц вместе с с/з, гласные, ь и ъ не различаются, повторы схлопываются.
+ * Силков, Сильков, Silkov и Silkoff дают один и тот же код "7421".
+ * Ключ имени - коды слов через пробел в исходном порядке, поэтому поиск по фамилии
+ * или по началу полного имени - это поиск по префиксу ключа.
+ */
+
+#include <string>
+
+#define PHONETIC_MAX_CODE   8   // цифр на слово
+
+class PhoneticKey
+{
+public:
+   // Строки в UTF-8
+   static std::string ofName(const std::string &name);
+   static std::string ofWord(const std::string &word);
+
+   static std::string transliterate(const std::string &word);
+
+private:
+   static std::string encode(const std::string &latin);
+};
+
+#endif // PHONETICKEY_H
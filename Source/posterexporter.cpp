@@ -0,0 +1,361 @@
+#include "posterexporter.h"
+
+#include <cmath>
+#include <vector>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QBuffer>
+#include <QImage>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QSvgGenerator>
+#include <QtEndian>
+
+#include <zlib.h>
+
+#include "writelog.h"
+
+#define PNG_OUT_BUFFER  (256 * 1024)
+
+/*
+ * PNG пишется построчно: заголовок, затем строки уходят в deflate, и каждый заполненный
+ * выходной буфер сразу становится IDAT-блоком. Вся картинка в памяти не нужна.
+ */
+class PngStream
+{
+public:
+   PngStream(QFile &file, int width, int height)
+      : m_file(file),
+      m_width(width),
+      m_row(width * 3 + 1),
+      m_out(PNG_OUT_BUFFER),
+      m_ok(true)
+   {
+      static const char signature[8] = { '\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n' };
+      m_file.write(signature, sizeof(signature));
+
+      uchar header[13];
+      qToBigEndian<quint32>(width, header);
+      qToBigEndian<quint32>(height, header + 4);
+      header[8] = 8;    // бит на канал
+      header[9] = 2;    // RGB
+      header[10] = 0;
+      header[11] = 0;
+      header[12] = 0;
+      writeChunk("IHDR", header, sizeof(header));
+
+      m_zstream.zalloc = Z_NULL;
+      m_zstream.zfree = Z_NULL;
+      m_zstream.opaque = Z_NULL;
+      m_ok = (deflateInit(&m_zstream, POSTER_PNG_COMPRESSION) == Z_OK);
+   }
+
+   ~PngStream()
+   {
+      deflateEnd(&m_zstream);
+   }
+
+   // Строка RGB32 -> RGB с фильтром Sub (разность с соседним пикселем хорошо сжимается на заливках)
+   bool writeRow(const QRgb *pixels)
+   {
+      uchar *row = m_row.data();
+      row[0] = 1;
+      uchar prev[3] = { 0, 0, 0 };
+      for (int x = 0; x < m_width; x++)
+      {
+         uchar rgb[3] = { uchar(qRed(pixels[x])), uchar(qGreen(pixels[x])), uchar(qBlue(pixels[x])) };
+         for (int c = 0; c < 3; c++)
+         {
+            row[1 + x * 3 + c] = uchar(rgb[c] - prev[c]);
+            prev[c] = rgb[c];
+         }
+      }
+      return deflateData(row, static_cast<int>(m_row.size()), Z_NO_FLUSH);
+   }
+
+   bool finish()
+   {
+      if (!deflateData(nullptr, 0, Z_FINISH))
+         return false;
+      writeChunk("IEND", nullptr, 0);
+      return m_ok;
+   }
+
+private:
+   bool deflateData(uchar *data, int size, int flush)
+   {
+      m_zstream.next_in = data;
+      m_zstream.avail_in = size;
+      int ret;
+      do
+      {
+         m_zstream.next_out = m_out.data();
+         m_zstream.avail_out = PNG_OUT_BUFFER;
+         ret = deflate(&m_zstream, flush);
+         if (ret == Z_STREAM_ERROR)
+            return m_ok = false;
+         int produced = PNG_OUT_BUFFER - m_zstream.avail_out;
+         if (produced)
+            writeChunk("IDAT", m_out.data(), produced);
+      } while (m_zstream.avail_out == 0 || ((flush == Z_FINISH) && (ret != Z_STREAM_END)));
+      return m_ok;
+   }
+
+   void writeChunk(const char *type, const uchar *data, int size)
+   {
+      uchar buf[4];
+      qToBigEndian<quint32>(size, buf);
+      m_file.write(reinterpret_cast<const char*>(buf), 4);
+      m_file.write(type, 4);
+      if (size)
+         m_file.write(reinterpret_cast<const char*>(data), size);
+
+      uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(type), 4);
+      if (size)
+         crc = crc32(crc, data, size);
+      qToBigEndian<quint32>(crc, buf);
+      if (m_file.write(reinterpret_cast<const char*>(buf), 4) != 4)
+         m_ok = false;
+   }
+
+   QFile &m_file;
+   int m_width;
+   std::vector<uchar> m_row;
+   std::vector<uchar> m_out;
+   z_stream m_zstream;
+   bool m_ok;
+};
+
+PosterExporter::PosterExporter()
+   : m_thumbnails(nullptr),
+   m_scale(1.0),
+   m_margin(40),
+   m_pageSize(QPageSize::A3)
+{
+
+}
+
+void PosterExporter::setThumbnails(ThumbnailCache *thumbnails)
+{
+   m_thumbnails = thumbnails;
+   m_renderer.setThumbnails(thumbnails);
+}
+
+PosterFormat PosterExporter::formatFor(const QString &fileName)
+{
+   QString suffix = QFileInfo(fileName).suffix().toLower();
+   if (suffix == "pdf")
+      return POSTER_PDF;
+   if (suffix == "svg")
+      return POSTER_SVG;
+   return POSTER_PNG;
+}
+
+QSize PosterExporter::posterSize(const TreeScene &scene) const
+{
+   QRectF bounds = scene.bounds();
+   return QSize(static_cast<int>(std::ceil(bounds.width() * m_scale)) + 2 * m_margin,
+                static_cast<int>(std::ceil(bounds.height() * m_scale)) + 2 * m_margin);
+}
+
+int PosterExporter::exportPoster(const QString &fileName, PosterFormat format, const TreeScene &scene,
+                                 const QVector<Person*> &persons)
+{
+   if (!scene.size() || (scene.size() != persons.size()))
+   {
+      writeDebugLog("PosterExporter::exportPoster Scene is empty or does not match persons");
+      return -1;
+   }
+
+   int ret = 0;
+   switch (format)
+   {
+   case POSTER_PNG:
+      ret = exportPng(fileName, scene, persons);
+      break;
+   case POSTER_PDF:
+      ret = exportPdf(fileName, scene, persons);
+      break;
+   case POSTER_SVG:
+      ret = exportSvg(fileName, scene, persons);
+      break;
+   }
+
+   // Текст полос плаката экрану не пригодится
+   m_renderer.clearCache();
+   return ret;
+}
+
+// painter в пикселях плаката; рисуется то, что попадает в part
+void PosterExporter::renderPart(QPainter &painter, const TreeScene &scene, const QVector<Person*> &persons,
+                                const QRect &part)
+{
+   QRectF bounds = scene.bounds();
+   QRectF world((part.left() - m_margin) / m_scale + bounds.left(), (part.top() - m_margin) / m_scale + bounds.top(),
+                part.width() / m_scale, part.height() / m_scale);
+
+   // Фото для плаката нужны сразу, а не заглушки: миниатюры полосы заказываются и дожидаются
+   if (m_thumbnails)
+   {
+      m_renderer.prefetchPhotos(scene, persons, world, m_scale);
+      m_thumbnails->waitForDone();
+   }
+
+   painter.save();
+   painter.translate(m_margin - bounds.left() * m_scale, m_margin - bounds.top() * m_scale);
+   painter.scale(m_scale, m_scale);
+   m_renderer.render(painter, scene, persons, world, m_scale);
+   painter.restore();
+}
+
+int PosterExporter::exportPng(const QString &fileName, const TreeScene &scene, const QVector<Person*> &persons)
+{
+   QSize size = posterSize(scene);
+   QFile file(fileName);
+   if (!file.open(QIODevice::WriteOnly))
+   {
+      writeDebugLog("PosterExporter::exportPng Could not open " + fileName);
+      return -1;
+   }
+
+   int stripHeight = qBound(1, POSTER_STRIP_BUDGET / (size.width() * 4), size.height());
+   QImage strip(size.width(), stripHeight, QImage::Format_RGB32);
+   if (strip.isNull())
+   {
+      writeDebugLog("PosterExporter::exportPng Poster is too wide");
+      return -1;
+   }
+
+   PngStream png(file, size.width(), size.height());
+   for (int top = 0; top < size.height(); top += stripHeight)
+   {
+      int rows = qMin(stripHeight, size.height() - top);
+      strip.fill(Qt::white);
+      {
+         QPainter painter(&strip);
+         painter.setRenderHint(QPainter::Antialiasing);
+         painter.translate(0, -top);
+         renderPart(painter, scene, persons, QRect(0, top, size.width(), rows));
+      }
+
+      for (int y = 0; y < rows; y++)
+      {
+         if (!png.writeRow(reinterpret_cast<const QRgb*>(strip.constScanLine(y))))
+         {
+            writeDebugLog("PosterExporter::exportPng Compression failed");
+            return -1;
+         }
+      }
+   }
+
+   if (!png.finish())
+   {
+      writeDebugLog("PosterExporter::exportPng Write failed: " + file.errorString());
+      return -1;
+   }
+   return 0;
+}
+
+int PosterExporter::exportPdf(const QString &fileName, const TreeScene &scene, const QVector<Person*> &persons)
+{
+   QSize size = posterSize(scene);
+
+   // Плакат режется на листы; каждый лист записывается в файл при переходе к следующему
+   QPdfWriter writer(fileName);
+   writer.setCreator("FamilyTree");
+   writer.setPageSize(m_pageSize);
+   writer.setPageMargins(QMarginsF(0, 0, 0, 0));
+   writer.setResolution(96);
+
+   QPainter painter;
+   if (!painter.begin(&writer))
+   {
+      writeDebugLog("PosterExporter::exportPdf Could not open " + fileName);
+      return -1;
+   }
+
+   int pageWidth = writer.width(), pageHeight = writer.height();
+   bool first = true;
+   for (int top = 0; top < size.height(); top += pageHeight)
+   {
+      for (int left = 0; left < size.width(); left += pageWidth)
+      {
+         if (!first)
+            writer.newPage();
+         first = false;
+
+         QRect page(left, top, pageWidth, pageHeight);
+         painter.save();
+         painter.setClipRect(0, 0, pageWidth, pageHeight);
+         painter.translate(-left, -top);
+         renderPart(painter, scene, persons, page);
+         painter.restore();
+      }
+   }
+
+   return painter.end() ? 0 : -1;
+}
+
+int PosterExporter::exportSvg(const QString &fileName, const TreeScene &scene, const QVector<Person*> &persons)
+{
+   QSize size = posterSize(scene);
+   QFile file(fileName);
+   if (!file.open(QIODevice::WriteOnly))
+   {
+      writeDebugLog("PosterExporter::exportSvg Could not open " + fileName);
+      return -1;
+   }
+
+   file.write(QString("<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
+                      "<svg width=\"%1\" height=\"%2\" viewBox=\"0 0 %1 %2\" xmlns=\"http://www.w3.org/2000/svg\" "
+                      "xmlns:xlink=\"http://www.w3.org/1999/xlink\" version=\"1.2\" baseProfile=\"tiny\">\n"
+                      "<rect width=\"%1\" height=\"%2\" fill=\"#ffffff\"/>\n")
+              .arg(size.width()).arg(size.height()).toUtf8());
+
+   // Полоса - одно поколение: границы проходят посередине промежутка между поколениями,
+   // так что ни одна карточка не попадает в две полосы. Линии, пересекающие границу, полоса
+   // пишет только если они в ней начинаются; part с запасом в пиксель, чтобы не потерять их на округлении
+   const LayoutParams &params = scene.layout().params();
+   double pitch = params.cardHeight + params.levelGap;
+   int generations = static_cast<int>(std::ceil((scene.bounds().height() + params.levelGap) / pitch));
+   for (int gen = 0; gen < generations; gen++)
+   {
+      double bandTop = scene.bounds().top() + gen * pitch - params.levelGap / 2;
+      m_renderer.setLinkBand(bandTop, bandTop + pitch);
+
+      double top = (gen * pitch - params.levelGap / 2) * m_scale + m_margin;
+      QRect part(0, static_cast<int>(std::floor(top)), size.width(), static_cast<int>(std::ceil(pitch * m_scale)) + 1);
+
+      // Каждую полосу рисует отдельный QSvgGenerator, от результата берутся только элементы
+      QByteArray chunk;
+      {
+         QBuffer buffer(&chunk);
+         QSvgGenerator generator;
+         generator.setOutputDevice(&buffer);
+         generator.setSize(size);
+         QPainter painter(&generator);
+         renderPart(painter, scene, persons, part);
+      }
+
+      int begin = chunk.indexOf("</defs>");
+      int end = chunk.lastIndexOf("</svg>");
+      if ((begin < 0) || (end < begin))
+      {
+         writeDebugLog("PosterExporter::exportSvg Unexpected generator output");
+         m_renderer.clearLinkBand();
+         return -1;
+      }
+      begin += static_cast<int>(qstrlen("</defs>"));
+      file.write(chunk.constData() + begin, end - begin);
+   }
+
+   m_renderer.clearLinkBand();
+   file.write("</svg>\n");
+   if (file.error() != QFileDevice::NoError)
+   {
+      writeDebugLog("PosterExporter::exportSvg Write failed: " + file.errorString());
+      return -1;
+   }
+   return 0;
+}
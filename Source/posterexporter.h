@@ -0,0 +1,61 @@
+#ifndef POSTEREXPORTER_H
+#define POSTEREXPORTER_H
+
+/*
+ * Экспорт всего разложенного дерева в плакат: PNG, PDF или SVG.
+ * Дерево рисуется тем же TreeRenderer, что и на экране, но полосами по высоте, и каждая
+ * полоса сразу уходит в файл (строки PNG, страницы PDF, элементы SVG). Поэтому память
+ * ограничена размером одной полосы, а не всего плаката в десятки тысяч пикселей.
+ */
+
+#include <QString>
+#include <QVector>
+#include <QPageSize>
+
+#include "person.h"
+#include "treescene.h"
+#include "treerenderer.h"
+#include "thumbnailcache.h"
+
+#define POSTER_STRIP_BUDGET     (64 * 1024 * 1024)   // байт на полосу растра
+#define POSTER_PNG_COMPRESSION  6
+
+enum PosterFormat
+{
+   POSTER_PNG,
+   POSTER_PDF,
+   POSTER_SVG
+};
+
+class PosterExporter
+{
+public:
+   PosterExporter();
+
+   void setThumbnails(ThumbnailCache *thumbnails);
+   void setScale(double scale) { m_scale = scale; }          // пикселей плаката на единицу мира
+   void setMargin(int pixels) { m_margin = pixels; }
+   void setPageSize(const QPageSize &size) { m_pageSize = size; }
+
+   static PosterFormat formatFor(const QString &fileName);
+   QSize posterSize(const TreeScene &scene) const;
+
+   int exportPoster(const QString &fileName, PosterFormat format, const TreeScene &scene,
+                    const QVector<Person*> &persons);
+
+private:
+   int exportPng(const QString &fileName, const TreeScene &scene, const QVector<Person*> &persons);
+   int exportPdf(const QString &fileName, const TreeScene &scene, const QVector<Person*> &persons);
+   int exportSvg(const QString &fileName, const TreeScene &scene, const QVector<Person*> &persons);
+
+   void renderPart(QPainter &painter, const TreeScene &scene, const QVector<Person*> &persons,
+                   const QRect &part);
+
+   TreeRenderer m_renderer;
+   ThumbnailCache *m_thumbnails;
+   double m_scale;
+   int m_margin;
+   QPageSize m_pageSize;
+};
+
+#endif // POSTEREXPORTER_H
@@ -0,0 +1,216 @@
+#include "spatialindex.h"
+
+#include <algorithm>
+#include <cmath>
+
+SpatialIndex::SpatialIndex()
+   : _stale(0),
+   _count(0)
+{
+
+}
+
+void SpatialIndex::clear()
+{
+   _nodes.clear();
+   _levelStart.clear();
+   _leafOf.clear();
+   _extra.clear();
+   _extraOf.clear();
+   _stale = 0;
+   _count = 0;
+}
+
+void SpatialIndex::build(std::vector<SpatialBox> items)
+{
+   clear();
+   _count = static_cast<int>(items.size());
+   if (items.empty())
+      return;
+
+   // Листья: полосы по X, внутри полосы - по Y
+   size_t pages = (items.size() + NODE_CAPACITY - 1) / NODE_CAPACITY;
+   size_t slices = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(pages))));
+   size_t sliceSize = slices * NODE_CAPACITY;
+
+   std::sort(items.begin(), items.end(), [](const SpatialBox &a, const SpatialBox &b)
+   {
+      return (a.x1 + a.x2) < (b.x1 + b.x2);
+   });
+   for (size_t i = 0; i < items.size(); i += sliceSize)
+   {
+      auto last = items.begin() + std::min(items.size(), i + sliceSize);
+      std::sort(items.begin() + i, last, [](const SpatialBox &a, const SpatialBox &b)
+      {
+         return (a.y1 + a.y2) < (b.y1 + b.y2);
+      });
+   }
+
+   _nodes = std::move(items);
+   _levelStart.push_back(0);
+   for (size_t i = 0; i < _nodes.size(); i++)
+   {
+      reserveId(_nodes[i].id);
+      _leafOf[_nodes[i].id] = static_cast<int>(i);
+   }
+
+   // Верхние уровни: соседние узлы уже близки в пространстве, пакуем подряд
+   size_t begin = 0, end = _nodes.size();
+   while (end - begin > 1)
+   {
+      _levelStart.push_back(static_cast<int>(end));
+      for (size_t i = begin; i < end; i += NODE_CAPACITY)
+      {
+         SpatialBox box = _nodes[i];
+         box.id = static_cast<int>(i);
+         for (size_t k = i + 1; k < std::min(end, i + NODE_CAPACITY); k++)
+         {
+            box.x1 = std::min(box.x1, _nodes[k].x1);
+            box.y1 = std::min(box.y1, _nodes[k].y1);
+            box.x2 = std::max(box.x2, _nodes[k].x2);
+            box.y2 = std::max(box.y2, _nodes[k].y2);
+         }
+         _nodes.push_back(box);
+      }
+      begin = end;
+      end = _nodes.size();
+   }
+   _levelStart.push_back(static_cast<int>(_nodes.size()));
+}
+
+void SpatialIndex::query(double x1, double y1, double x2, double y2, std::vector<int> &result) const
+{
+   result.clear();
+   for (const SpatialBox &box : _extra)
+      if ((box.x2 >= x1) && (box.x1 <= x2) && (box.y2 >= y1) && (box.y1 <= y2))
+         result.push_back(box.id);
+   if (_nodes.empty())
+      return;
+
+   int top = static_cast<int>(_levelStart.size()) - 2;
+   std::vector<std::pair<int, int>> stack;   // уровень, номер узла
+   for (int i = _levelStart[top]; i < _levelStart[top + 1]; i++)
+      stack.emplace_back(top, i);
+
+   while (!stack.empty())
+   {
+      int level = stack.back().first;
+      const SpatialBox &box = _nodes[stack.back().second];
+      stack.pop_back();
+
+      if ((box.x2 < x1) || (box.x1 > x2) || (box.y2 < y1) || (box.y1 > y2))
+         continue;
+
+      if (!level)
+      {
+         if (box.id >= 0)
+            result.push_back(box.id);
+         continue;
+      }
+
+      int last = std::min(box.id + NODE_CAPACITY, _levelStart[level]);
+      for (int i = box.id; i < last; i++)
+         stack.emplace_back(level - 1, i);
+   }
+}
+
+void SpatialIndex::reserveId(int id)
+{
+   if (id >= static_cast<int>(_leafOf.size()))
+   {
+      _leafOf.resize(id + 1, -1);
+      _extraOf.resize(id + 1, -1);
+   }
+}
+
+void SpatialIndex::update(const SpatialBox &box)
+{
+   place(box);
+   compactIfNeeded();
+}
+
+void SpatialIndex::update(const std::vector<SpatialBox> &boxes)
+{
+   // Перестройка - не чаще раза за пачку, даже если сдвинулась половина дерева
+   for (const SpatialBox &box : boxes)
+      place(box);
+   compactIfNeeded();
+}
+
+void SpatialIndex::place(const SpatialBox &box)
+{
+   if (box.id < 0)
+      return;
+   reserveId(box.id);
+
+   int leaf = _leafOf[box.id];
+   int slot = _extraOf[box.id];
+   if (leaf >= 0)
+   {
+      SpatialBox &old = _nodes[leaf];
+      if ((old.x1 == box.x1) && (old.y1 == box.y1) && (old.x2 == box.x2) && (old.y2 == box.y2))
+         return;
+      old.id = -1;
+      _leafOf[box.id] = -1;
+      _stale++;
+   }
+   else if (slot < 0)
+   {
+      _count++;
+   }
+
+   if (slot >= 0)
+   {
+      _extra[slot] = box;
+   }
+   else
+   {
+      _extraOf[box.id] = static_cast<int>(_extra.size());
+      _extra.push_back(box);
+   }
+}
+
+void SpatialIndex::remove(int id)
+{
+   if ((id < 0) || (id >= static_cast<int>(_leafOf.size())))
+      return;
+
+   if (_leafOf[id] >= 0)
+   {
+      _nodes[_leafOf[id]].id = -1;
+      _leafOf[id] = -1;
+      _stale++;
+      _count--;
+   }
+   else if (_extraOf[id] >= 0)
+   {
+      int slot = _extraOf[id];
+      _extra[slot] = _extra.back();
+      _extraOf[_extra[slot].id] = slot;
+      _extra.pop_back();
+      _extraOf[id] = -1;
+      _count--;
+   }
+   compactIfNeeded();
+}
+
+void SpatialIndex::compactIfNeeded()
+{
+   int limit = _count / EXTRA_SHARE;
+   if (limit < EXTRA_MIN)
+      limit = EXTRA_MIN;
+   if (static_cast<int>(_extra.size()) + _stale > limit)
+      compact();
+}
+
+void SpatialIndex::compact()
+{
+   std::vector<SpatialBox> items;
+   items.reserve(_count);
+   int leaves = (_levelStart.size() > 1) ? _levelStart[1] : 0;
+   for (int i = 0; i < leaves; i++)
+      if (_nodes[i].id >= 0)
+         items.push_back(_nodes[i]);
+   items.insert(items.end(), _extra.begin(), _extra.end());
+   build(std::move(items));
+}
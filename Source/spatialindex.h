@@ -0,0 +1,59 @@
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+/*
+ * Статическое R-дерево, упакованное методом STR (Sort-Tile-Recursive).
+ * Строится целиком за O(n log n), запрос прямоугольника - O(log n + k).
+ * Используется для отсечения карточек и линий связи вне видимой области.
+ * Точечные правки не перестраивают дерево: прежний лист помечается удалённым, а новое место
+ * попадает в короткий список, который запрос просматривает подряд. Когда правок накопится
+ * больше EXTRA_MIN и 1/EXTRA_SHARE от числа элементов, дерево перестраивается: в среднем правка
+ * стоит O(log n), пачка правок перестраивает дерево не больше одного раза.
+ * id элементов - небольшие неотрицательные числа (номера).
+ */
+
+#include <vector>
+
+struct SpatialBox
+{
+   double x1, y1, x2, y2;
+   int id;
+};
+
+class SpatialIndex
+{
+public:
+   SpatialIndex();
+
+   void clear();
+   void build(std::vector<SpatialBox> items);
+   // Добавить элемент или переместить уже имеющийся с тем же id
+   void update(const SpatialBox &box);
+   void update(const std::vector<SpatialBox> &boxes);
+   void remove(int id);
+   void query(double x1, double y1, double x2, double y2, std::vector<int> &result) const;
+
+   int size() const { return _count; }
+
+private:
+   static const int NODE_CAPACITY = 16;
+   static const int EXTRA_MIN = 256;
+   static const int EXTRA_SHARE = 16;
+
+   void reserveId(int id);
+   void place(const SpatialBox &box);
+   void compactIfNeeded();
+   // Перестройка из живых листьев и списка правок
+   void compact();
+
+   // Уровни лежат подряд: сначала листья (сами элементы), затем узлы; у узла в id - начало детей
+   std::vector<SpatialBox> _nodes;
+   std::vector<int> _levelStart;
+   std::vector<int> _leafOf;          // id -> номер листа, -1 - нет в дереве
+   std::vector<SpatialBox> _extra;    // добавленные и сдвинутые после build()
+   std::vector<int> _extraOf;         // id -> номер в _extra, -1 - нет
+   int _stale;                        // листьев, помеченных удалёнными (id == -1)
+   int _count;
+};
+
+#endif // SPATIALINDEX_H
@@ -0,0 +1,200 @@
+#include "thumbnailcache.h"
+
+#include <QBuffer>
+#include <QImageReader>
+#include <QCryptographicHash>
+#include <QtConcurrent/QtConcurrent>
+
+#ifdef DATABASE
+#include "db.h"
+#endif
+
+static const int TIER_SIZES[THUMBNAIL_TIERS] = { 48, 96, 192 };
+
+ThumbnailCache::ThumbnailCache(QObject *parent)
+   : QObject(parent)
+#ifdef DATABASE
+   , m_db(nullptr)
+   , m_reader(nullptr)
+#endif
+{
+   m_cache.setMaxCost(THUMBNAIL_MEMORY_BUDGET);
+   m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+
+   m_flushTimer.setSingleShot(true);
+   m_flushTimer.setInterval(1000);
+   connect(&m_flushTimer, SIGNAL(timeout()), this, SLOT(flushToDB()));
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+   m_pool.clear();
+   m_pool.waitForDone();
+#ifdef DATABASE
+   flushToDB();
+   delete m_reader;
+#endif
+}
+
+#ifdef DATABASE
+void ThumbnailCache::setDB(DB *db)
+{
+   // Очередь относится к прежней базе
+   flushToDB();
+   m_db = db;
+
+   DB *reader = nullptr;
+   if (db)
+   {
+      reader = new DB(db->dbPath().c_str());
+      if (reader->openDB(true))
+      {
+         delete reader;
+         reader = nullptr;
+      }
+   }
+
+   QMutexLocker lock(&m_dbMutex);
+   delete m_reader;
+   m_reader = reader;
+}
+#endif
+
+void ThumbnailCache::setMemoryBudget(int bytes)
+{
+   QMutexLocker lock(&m_mutex);
+   m_cache.setMaxCost(bytes);
+}
+
+void ThumbnailCache::clear()
+{
+   QMutexLocker lock(&m_mutex);
+   m_cache.clear();
+}
+
+void ThumbnailCache::waitForDone()
+{
+   m_pool.waitForDone();
+}
+
+int ThumbnailCache::tierFor(double pixels)
+{
+   for (int tier = 0; tier < THUMBNAIL_TIERS; tier++)
+      if (pixels <= TIER_SIZES[tier])
+         return tier;
+   return THUMBNAIL_TIERS - 1;
+}
+
+int ThumbnailCache::tierSize(int tier)
+{
+   return TIER_SIZES[tier];
+}
+
+QImage ThumbnailCache::thumbnail(const Person *pers, double pixels)
+{
+   if (pers->photoData.isEmpty())
+      return QImage();
+
+   int tier = tierFor(pixels);
+   QMutexLocker lock(&m_mutex);
+
+   // Пока нужного размера нет, подойдёт любой готовый - лучше мутное фото, чем пустая рамка
+   QImage fallback;
+   for (int t = THUMBNAIL_TIERS - 1; t >= 0; t--)
+   {
+      Entry *entry = m_cache.object(key(pers->id, t));
+      if (!entry || (entry->source != pers->photoData.constData()) || (entry->sourceSize != pers->photoData.size()))
+         continue;
+      // Те же данные не декодируются ни в каком размере
+      if (entry->image.isNull())
+         return QImage();
+      if (t == tier)
+         return entry->image;
+      if (fallback.isNull() || (t > tier))
+         fallback = entry->image;
+   }
+
+   quint64 k = key(pers->id, tier);
+   if (!m_pending.contains(k))
+   {
+      m_pending.insert(k);
+      QtConcurrent::run(&m_pool, this, &ThumbnailCache::decode, pers->id, pers->photoData, tier);
+   }
+   return fallback;
+}
+
+void ThumbnailCache::decode(uint32_t id, QByteArray photo, int tier)
+{
+   int size = TIER_SIZES[tier];
+   QImage image;
+
+#ifdef DATABASE
+   QByteArray hash = QCryptographicHash::hash(photo, QCryptographicHash::Md5).toHex();
+   {
+      QMutexLocker lock(&m_dbMutex);
+      std::string stored;
+      if (m_reader && !m_reader->getThumbnail(hash.toStdString(), size, stored) && !stored.empty())
+         image.loadFromData(reinterpret_cast<const uchar*>(stored.data()), static_cast<int>(stored.size()));
+   }
+#endif
+
+   if (image.isNull())
+   {
+      // Декодер сразу уменьшает картинку (для JPEG это заметно быстрее полного декодирования)
+      QBuffer buffer(&photo);
+      buffer.open(QIODevice::ReadOnly);
+      QImageReader reader(&buffer);
+      QSize full = reader.size();
+      if (full.isValid())
+         reader.setScaledSize(full.scaled(size, size, Qt::KeepAspectRatio));
+      image = reader.read();
+      if (!image.isNull() && ((image.width() > size) || (image.height() > size)))
+         image = image.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+#ifdef DATABASE
+      if (!image.isNull())
+      {
+         QByteArray encoded;
+         QBuffer out(&encoded);
+         out.open(QIODevice::WriteOnly);
+         image.save(&out, image.hasAlphaChannel() ? "PNG" : "JPG", 85);
+
+         QMutexLocker lock(&m_dbMutex);
+         m_dbQueue.push_back({ hash.toStdString(), size, encoded.toStdString() });
+         QMetaObject::invokeMethod(&m_flushTimer, "start", Qt::QueuedConnection);
+      }
+#endif
+   }
+
+   image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+   {
+      QMutexLocker lock(&m_mutex);
+      m_pending.remove(key(id, tier));
+
+      // Неудача тоже запоминается, иначе перерисовка плитки закажет то же фото снова
+      Entry *entry = new Entry;
+      entry->image = image;
+      entry->source = photo.constData();
+      entry->sourceSize = photo.size();
+      int cost = image.isNull() ? static_cast<int>(sizeof(Entry)) : image.bytesPerLine() * image.height();
+      m_cache.insert(key(id, tier), entry, cost);
+   }
+
+   if (!image.isNull())
+      emit thumbnailReady(id);
+}
+
+void ThumbnailCache::flushToDB()
+{
+#ifdef DATABASE
+   // Пул во время записи только пополняет очередь, а не ждёт её
+   std::vector<ThumbnailRecord> records;
+   {
+      QMutexLocker lock(&m_dbMutex);
+      records.swap(m_dbQueue);
+   }
+   if (m_db && !records.empty())
+      m_db->putThumbnails(records);
+#endif
+}
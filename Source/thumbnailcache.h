@@ -0,0 +1,87 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+/*
+ * Кэш уменьшенных фотографий для отрисовки дерева.
+ * Фото декодируются и уменьшаются в отдельном пуле потоков, готовые миниатюры нескольких
+ * размеров лежат в памяти (LRU с ограничением по байтам) и в таблице THUMBNAILTABLE базы.
+ * thumbnail() никогда не блокирует: пока миниатюры нет, возвращается пустое изображение,
+ * а по готовности приходит сигнал thumbnailReady(). Фото, которое не удалось декодировать,
+ * запоминается пустой записью и больше не заказывается.
+ * Потоки пула читают THUMBNAILTABLE через своё соединение только для чтения; новые миниатюры
+ * пишутся через общее соединение базы в потоке GUI.
+ */
+
+#include <vector>
+
+#include <QObject>
+#include <QImage>
+#include <QCache>
+#include <QSet>
+#include <QMutex>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "person.h"
+
+#ifdef DATABASE
+class DB;
+struct ThumbnailRecord;
+#endif
+
+#define THUMBNAIL_TIERS         3
+#define THUMBNAIL_MEMORY_BUDGET (64 * 1024 * 1024)
+
+class ThumbnailCache : public QObject
+{
+   Q_OBJECT
+
+public:
+   explicit ThumbnailCache(QObject *parent = 0);
+   ~ThumbnailCache();
+
+#ifdef DATABASE
+   // Из потока GUI; для чтения открывается своё соединение к той же базе
+   void setDB(DB *db);
+#endif
+   void setMemoryBudget(int bytes);
+   void clear();
+   void waitForDone();
+
+   static int tierFor(double pixels);
+   static int tierSize(int tier);
+
+   QImage thumbnail(const Person *pers, double pixels);
+
+signals:
+   void thumbnailReady(uint id);
+
+private slots:
+   void flushToDB();
+
+private:
+   struct Entry
+   {
+      QImage image;         // пустое - фото не декодируется, повторно не заказывается
+      const char *source;   // данные фото, из которых сделана миниатюра (QByteArray делится неявно)
+      int sourceSize;
+   };
+
+   static quint64 key(uint32_t id, int tier) { return (quint64(id) << 8) | quint64(tier); }
+   void decode(uint32_t id, QByteArray photo, int tier);
+
+   QMutex m_mutex;
+   QCache<quint64, Entry> m_cache;
+   QSet<quint64> m_pending;
+   QThreadPool m_pool;
+   QTimer m_flushTimer;
+
+#ifdef DATABASE
+   DB *m_db;             // общее соединение, только из потока GUI
+   DB *m_reader;         // своё, для потоков пула, под m_dbMutex
+   QMutex m_dbMutex;
+   std::vector<ThumbnailRecord> m_dbQueue;
+#endif
+};
+
+#endif // THUMBNAILCACHE_H
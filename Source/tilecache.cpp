@@ -0,0 +1,196 @@
+#include "tilecache.h"
+
+#include <cmath>
+#include <climits>
+
+#include <QPainter>
+#include <QtConcurrent/QtConcurrent>
+
+#include "treerenderer.h"
+#include "spatialindex.h"
+
+TileCache::TileCache(QObject *parent)
+   : QObject(parent),
+   m_thumbnails(nullptr),
+   m_background(Qt::white),
+   m_generation(0),
+   m_activeLevel(INT_MIN)
+{
+   m_cache.setMaxCost(TILE_MEMORY_BUDGET);
+   m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+}
+
+TileCache::~TileCache()
+{
+   m_pool.clear();
+   m_pool.waitForDone();
+}
+
+void TileCache::setBackground(const QColor &color)
+{
+   if (color == m_background)
+      return;
+   m_background = color;
+   clear();
+}
+
+void TileCache::setMemoryBudget(int bytes)
+{
+   m_cache.setMaxCost(bytes);
+}
+
+int TileCache::levelFor(double scale)
+{
+   return static_cast<int>(std::lround(std::log2(scale) * TILE_LEVELS_PER_2X));
+}
+
+double TileCache::levelScale(int level)
+{
+   return std::pow(2.0, static_cast<double>(level) / TILE_LEVELS_PER_2X);
+}
+
+QRectF TileCache::tileRect(int level, int tx, int ty)
+{
+   double size = TILE_SIZE / levelScale(level);
+   return QRectF(tx * size, ty * size, size, size);
+}
+
+// Уровень - старшие 8 бит, номера плитки по 28 бит со знаком
+quint64 TileCache::key(int level, int tx, int ty)
+{
+   return (quint64(uint8_t(level + 128)) << 56) | (quint64(uint32_t(tx) & 0xFFFFFFF) << 28)
+         | quint64(uint32_t(ty) & 0xFFFFFFF);
+}
+
+void TileCache::unpack(quint64 key, int &level, int &tx, int &ty)
+{
+   level = static_cast<int>(key >> 56) - 128;
+   tx = static_cast<int32_t>(uint32_t(key >> 28) << 4) >> 4;
+   ty = static_cast<int32_t>(uint32_t(key) << 4) >> 4;
+}
+
+bool TileCache::cached(int level, int tx, int ty, QPixmap &pixmap)
+{
+   QPixmap *tile = m_cache.object(key(level, tx, ty));
+   if (!tile)
+      return false;
+   pixmap = *tile;
+   return true;
+}
+
+bool TileCache::tile(int level, int tx, int ty, QPixmap &pixmap)
+{
+   if (cached(level, tx, ty, pixmap))
+      return true;
+
+   // Масштаб сменился - плитки прежнего уровня, ещё не взятые в работу, уже не нужны
+   if (level != m_activeLevel)
+   {
+      dropQueued();
+      m_activeLevel = level;
+   }
+
+   quint64 k = key(level, tx, ty);
+   if (m_snapshot && !m_pending.contains(k))
+   {
+      m_pending.insert(k, m_generation);
+
+      std::shared_ptr<const RenderSnapshot> snapshot = m_snapshot;
+      QColor background = m_background;
+      quint64 generation = m_generation;
+      QtConcurrent::run(&m_pool, [this, snapshot, background, level, tx, ty, generation]()
+      {
+         render(*snapshot, background, level, tx, ty, generation);
+      });
+   }
+   return false;
+}
+
+void TileCache::dropQueued()
+{
+   // Уже рисующиеся плитки не отменить, их результат примется по совпадению поколения
+   m_pool.clear();
+   m_pending.clear();
+}
+
+void TileCache::invalidate(const QVector<QRectF> &world)
+{
+   if (world.isEmpty())
+      return;
+
+   std::vector<SpatialBox> boxes(world.size());
+   for (int i = 0; i < world.size(); i++)
+      boxes[i] = { world[i].left(), world[i].top(), world[i].right(), world[i].bottom(), i };
+   SpatialIndex index;
+   index.build(std::move(boxes));
+
+   std::vector<int> hits;
+   auto touched = [&](quint64 k) -> bool
+   {
+      int level, tx, ty;
+      unpack(k, level, tx, ty);
+      QRectF rect = tileRect(level, tx, ty);
+      index.query(rect.left(), rect.top(), rect.right(), rect.bottom(), hits);
+      return !hits.empty();
+   };
+
+   for (quint64 k : m_cache.keys())
+      if (touched(k))
+         m_cache.remove(k);
+
+   // Заказанные по старым данным плитки будут отброшены и закажутся заново
+   for (auto it = m_pending.begin(); it != m_pending.end(); )
+   {
+      if (touched(it.key()))
+         it = m_pending.erase(it);
+      else
+         ++it;
+   }
+   m_generation++;
+}
+
+void TileCache::clear()
+{
+   dropQueued();
+   m_cache.clear();
+   m_generation++;
+}
+
+void TileCache::render(const RenderSnapshot &snapshot, const QColor &background, int level, int tx, int ty,
+                       quint64 generation)
+{
+   // У каждого рабочего потока свой отрисовщик: кэш раскладки текста не потокобезопасен
+   static thread_local TreeRenderer renderer;
+   renderer.setThumbnails(m_thumbnails);
+   renderer.setSceneSerial(snapshot.serial);
+
+   double scale = levelScale(level);
+   QRectF world = tileRect(level, tx, ty);
+
+   QImage image(TILE_SIZE, TILE_SIZE, QImage::Format_ARGB32_Premultiplied);
+   image.fill(background);
+   {
+      QPainter painter(&image);
+      painter.scale(scale, scale);
+      painter.translate(-world.topLeft());
+      renderer.render(painter, *snapshot.scene, snapshot.pointers, world, scale);
+   }
+
+   QMetaObject::invokeMethod(this, "tileRendered", Qt::QueuedConnection, Q_ARG(int, level), Q_ARG(int, tx),
+                             Q_ARG(int, ty), Q_ARG(quint64, generation), Q_ARG(QImage, image));
+}
+
+void TileCache::tileRendered(int level, int tx, int ty, quint64 generation, QImage image)
+{
+   // Плитка годится, если её не сбросили после заказа
+   quint64 k = key(level, tx, ty);
+   auto it = m_pending.find(k);
+   bool requested = (it != m_pending.end()) && (it.value() == generation);
+   if (requested)
+      m_pending.erase(it);
+   if (!requested && (generation != m_generation))
+      return;
+
+   m_cache.insert(k, new QPixmap(QPixmap::fromImage(image)), image.bytesPerLine() * image.height());
+   emit tileReady(level, tx, ty);
+}
@@ -0,0 +1,90 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+/*
+ * Кэш отрисованных плиток дерева.
+ * Холст на каждом из дискретных уровней масштаба делится на квадраты TILE_SIZE пикселей.
+ * Плитки рисуются в пуле потоков в QImage по неизменяемому снимку сцены, готовые хранятся
+ * в памяти (LRU с ограничением по байтам), так что прокрутка сводится к копированию картинок.
+ * После правки сбрасываются только плитки, задетые изменившимися карточками и линиями.
+ */
+
+#include <memory>
+#include <vector>
+
+#include <QObject>
+#include <QImage>
+#include <QPixmap>
+#include <QColor>
+#include <QCache>
+#include <QHash>
+#include <QThreadPool>
+
+#include "person.h"
+#include "treescene.h"
+#include "thumbnailcache.h"
+
+#define TILE_SIZE           256
+#define TILE_LEVELS_PER_2X  4      // уровней масштаба на каждое удвоение
+#define TILE_MEMORY_BUDGET  (128 * 1024 * 1024)
+
+// Данные для рабочих потоков, которые не трогают правки в GUI. Сцена и записи людей после создания
+// не меняются и переходят из снимка в снимок: GUI копирует сцену перед правкой, если её держит снимок,
+// а из людей копируются только правленые
+struct RenderSnapshot
+{
+   std::shared_ptr<const TreeScene> scene;
+   quint64 serial;                                 // номер полной раскладки сцены
+   std::vector<std::shared_ptr<Person>> records;   // в порядке узлов сцены
+   QVector<Person*> pointers;                      // указывают в records
+};
+
+class TileCache : public QObject
+{
+   Q_OBJECT
+
+public:
+   explicit TileCache(QObject *parent = 0);
+   ~TileCache();
+
+   void setThumbnails(ThumbnailCache *thumbnails) { m_thumbnails = thumbnails; }
+   void setBackground(const QColor &color);
+   void setMemoryBudget(int bytes);
+   void setSnapshot(const std::shared_ptr<const RenderSnapshot> &snapshot) { m_snapshot = snapshot; }
+
+   static int levelFor(double scale);
+   static double levelScale(int level);
+   static QRectF tileRect(int level, int tx, int ty);
+
+   // Готовая плитка; если её нет - она ставится в очередь на отрисовку
+   bool tile(int level, int tx, int ty, QPixmap &pixmap);
+   // То же без постановки в очередь (для подстановки плиток соседних уровней)
+   bool cached(int level, int tx, int ty, QPixmap &pixmap);
+
+   void invalidate(const QVector<QRectF> &world);
+   void clear();
+
+signals:
+   void tileReady(int level, int tx, int ty);
+
+private slots:
+   void tileRendered(int level, int tx, int ty, quint64 generation, QImage image);
+
+private:
+   static quint64 key(int level, int tx, int ty);
+   static void unpack(quint64 key, int &level, int &tx, int &ty);
+   void render(const RenderSnapshot &snapshot, const QColor &background, int level, int tx, int ty,
+               quint64 generation);
+   void dropQueued();
+
+   ThumbnailCache *m_thumbnails;
+   std::shared_ptr<const RenderSnapshot> m_snapshot;
+   QColor m_background;
+   QCache<quint64, QPixmap> m_cache;
+   QHash<quint64, quint64> m_pending;   // плитка -> поколение, для которого она заказана
+   quint64 m_generation;
+   int m_activeLevel;
+   QThreadPool m_pool;
+};
+
+#endif // TILECACHE_H
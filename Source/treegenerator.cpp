@@ -0,0 +1,554 @@
+#include "treegenerator.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "writelog.h"
+
+struct NameForms
+{
+   const char *male;
+   const char *female;
+};
+
+// Имя и отчества от него
+struct FirstName
+{
+   const char *name;
+   const char *son;
+   const char *daughter;
+};
+
+// Сначала частые: выбор смещён к началу списка
+static const NameForms SURNAMES[] = {
+   { "Иванов", "Иванова" }, { "Смирнов", "Смирнова" }, { "Кузнецов", "Кузнецова" }, { "Попов", "Попова" },
+   { "Васильев", "Васильева" }, { "Петров", "Петрова" }, { "Соколов", "Соколова" }, { "Михайлов", "Михайлова" },
+   { "Новиков", "Новикова" }, { "Фёдоров", "Фёдорова" }, { "Морозов", "Морозова" }, { "Волков", "Волкова" },
+   { "Алексеев", "Алексеева" }, { "Лебедев", "Лебедева" }, { "Семёнов", "Семёнова" }, { "Егоров", "Егорова" },
+   { "Павлов", "Павлова" }, { "Козлов", "Козлова" }, { "Степанов", "Степанова" }, { "Николаев", "Николаева" },
+   { "Орлов", "Орлова" }, { "Андреев", "Андреева" }, { "Макаров", "Макарова" }, { "Сидоров", "Сидорова" },
+   { "Ильин", "Ильина" }, { "Яковлев", "Яковлева" }, { "Зайцев", "Зайцева" }, { "Соловьёв", "Соловьёва" },
+   { "Борисов", "Борисова" }, { "Голубев", "Голубева" }, { "Виноградов", "Виноградова" }, { "Белов", "Белова" },
+   { "Ёлкин", "Ёлкина" }, { "Елкин", "Елкина" }, { "Воробьёв", "Воробьёва" }, { "Тарасов", "Тарасова" },
+   { "Покровский", "Покровская" }, { "Успенский", "Успенская" }, { "Троицкий", "Троицкая" },
+   { "Вишневский", "Вишневская" }, { "Черных", "Черных" }, { "Долгих", "Долгих" }, { "Коваленко", "Коваленко" },
+   { "Шевченко", "Шевченко" }, { "Йодко", "Йодко" }
+};
+
+// Супруги со стороны
+static const NameForms FOREIGN_SURNAMES[] = {
+   { "Müller", "Müller" }, { "Schmidt", "Schmidt" }, { "Smith", "Smith" }, { "Brown", "Brown" },
+   { "Łukasiewicz", "Łukasiewicz" }, { "Nowak", "Nowak" }, { "Іваненко", "Іваненко" }, { "Dubois", "Dubois" }
+};
+
+static const FirstName MALE_NAMES[] = {
+   { "Иван", "Иванович", "Ивановна" }, { "Александр", "Александрович", "Александровна" },
+   { "Николай", "Николаевич", "Николаевна" }, { "Сергей", "Сергеевич", "Сергеевна" },
+   { "Алексей", "Алексеевич", "Алексеевна" }, { "Дмитрий", "Дмитриевич", "Дмитриевна" },
+   { "Михаил", "Михайлович", "Михайловна" }, { "Андрей", "Андреевич", "Андреевна" },
+   { "Пётр", "Петрович", "Петровна" }, { "Василий", "Васильевич", "Васильевна" },
+   { "Фёдор", "Фёдорович", "Фёдоровна" }, { "Григорий", "Григорьевич", "Григорьевна" },
+   { "Яков", "Яковлевич", "Яковлевна" }, { "Степан", "Степанович", "Степановна" },
+   { "Егор", "Егорович", "Егоровна" }, { "Илья", "Ильич", "Ильинична" }
+};
+
+static const char *FEMALE_NAMES[] = {
+   "Анна", "Мария", "Елена", "Ольга", "Татьяна", "Наталья", "Екатерина", "Александра",
+   "Евдокия", "Анастасия", "Ксения", "Варвара", "Пелагея", "Софья", "Дарья", "Ирина"
+};
+
+static const char *PLACES[] = {
+   "Москва", "Санкт-Петербург", "Тверь", "Новгород", "Казань", "Ярославль", "Нижний Новгород", "Тула",
+   "Рязань", "Владимир", "Кострома", "Вологда", "Смоленск", "Псков", "Калуга", "Орёл",
+   "Воронеж", "Самара", "Саратов", "Екатеринбург", "Пермь", "Томск", "Иркутск", "Архангельск"
+};
+
+static const char *NOTES[] = {
+   "Заметка о человеке",
+   "Записан в метрической книге прихода",
+   "Крестьянин, затем мещанин",
+   "Участник войны",
+   "Сведения со слов родственников"
+};
+
+#define COUNT_OF(a)     static_cast<uint32_t>(sizeof(a) / sizeof((a)[0]))
+
+// Потоки случайных чисел полей человека
+enum RandomField
+{
+   RANDOM_BIRTH,
+   RANDOM_DEATH,
+   RANDOM_PLACE,
+   RANDOM_INFO,
+   RANDOM_PHOTO,
+   RANDOM_PATRONYMIC
+};
+
+static uint64_t mix(uint64_t x)
+{
+   // splitmix64
+   x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+   x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+   return x ^ (x >> 31);
+}
+
+// Выбор из n со смещением к началу: первая четверть списка - около половины выборов
+static uint32_t skewed(uint32_t r16, uint32_t n)
+{
+   return static_cast<uint32_t>((uint64_t(r16) * r16 * n) >> 32);
+}
+
+TreeGeneratorOptions::TreeGeneratorOptions()
+   : seed(2019),
+   persons(100000),
+   generations(12),
+   founders(0),
+   children(2.6),
+   marriage(0.8),
+   remarriage(0.1),
+   collapse(0.05),
+   foreign(0.02),
+   photos(0.1),
+   photoSize(4096),
+   notes(0.25),
+   firstYear(1700),
+   firstId(1)
+{
+
+}
+
+uint64_t TreeGenerator::Random::next()
+{
+   _state += 0x9E3779B97F4A7C15ull;
+   return mix(_state);
+}
+
+TreeGenerator::TreeGenerator(const TreeGeneratorOptions &options)
+   : _options(options)
+{
+   _options.generations = std::max(_options.generations, 1);
+   // Род в целом не должен обрываться на первых поколениях и в маленьком дереве
+   if (_options.founders <= 0)
+      _options.founders = std::max(_options.persons / GENERATOR_FOUNDER_SIZE, 1);
+   _options.children = std::max(_options.children, 0.0);
+   _options.photoSize = std::max(_options.photoSize, 4);
+
+   _marriage = threshold(_options.marriage);
+   _remarriage = threshold(std::min(_options.remarriage, 0.9));
+   _collapse = threshold(_options.collapse);
+   _foreign = threshold(_options.foreign);
+   _photos = threshold(_options.photos);
+   _notes = threshold(_options.notes);
+
+   // Число детей - биномиальное: среднее children, дисперсия чуть меньше пуассоновской
+   _childTrials = static_cast<int>(_options.children * 2) + 2;
+   _childTrial = threshold(_options.children / _childTrials);
+
+   for (const char *place : PLACES)
+      _places.push_back(QString::fromUtf8(place));
+   _sexes[0] = QString::fromUtf8("М");
+   _sexes[1] = QString::fromUtf8("Ж");
+
+   build();
+}
+
+uint32_t TreeGenerator::threshold(double share)
+{
+   if (share <= 0)
+      return 0;
+   if (share >= 1)
+      return UINT32_MAX;
+   return static_cast<uint32_t>(share * 4294967296.0);
+}
+
+TreeGenerator::Random TreeGenerator::randomOf(int num, uint32_t field) const
+{
+   return Random(_options.seed ^ mix((uint64_t(static_cast<uint32_t>(num)) << 8) | field));
+}
+
+int TreeGenerator::addPerson(int father, int mother, int sex, int year, int surname, Random &rng)
+{
+   _father.push_back(father);
+   _mother.push_back(mother);
+   _sex.push_back(static_cast<uint8_t>(sex));
+   _birthYear.push_back(static_cast<int16_t>(year));
+   _surname.push_back(static_cast<uint16_t>(surname));
+   uint32_t names = sex ? COUNT_OF(FEMALE_NAMES) : COUNT_OF(MALE_NAMES);
+   _firstName.push_back(static_cast<uint8_t>(skewed(rng.below(65536), names)));
+   return size() - 1;
+}
+
+int TreeGenerator::addOutsider(int sex, int year, Random &rng)
+{
+   uint32_t surname = rng.chance(_foreign) ? COUNT_OF(SURNAMES) + rng.below(COUNT_OF(FOREIGN_SURNAMES))
+                                           : skewed(rng.below(65536), COUNT_OF(SURNAMES));
+   return addPerson(-1, -1, sex, year, static_cast<int>(surname), rng);
+}
+
+int TreeGenerator::childrenOf(Random &rng) const
+{
+   int count = 0;
+   for (int i = 0; i < _childTrials; i++)
+      count += rng.chance(_childTrial);
+   return count;
+}
+
+int TreeGenerator::relativeFor(int pers, const std::vector<int> &generation, Random &rng) const
+{
+   for (int tries = 0; tries < 4; tries++)
+   {
+      int other = generation[rng.below(static_cast<uint32_t>(generation.size()))];
+      if ((_sex[other] != _sex[pers]) && (_father[other] != _father[pers]) && (_mother[other] != _mother[pers]))
+         return other;
+   }
+   return -1;
+}
+
+void TreeGenerator::build()
+{
+   int total = std::max(_options.persons, 0);
+   _father.reserve(total);
+   _mother.reserve(total);
+   _sex.reserve(total);
+   _birthYear.reserve(total);
+   _surname.reserve(total);
+   _firstName.reserve(total);
+
+   Random rng(_options.seed);
+   std::vector<std::pair<int32_t, int32_t>> couples, next;
+   std::vector<int> born;
+
+   // Каждый проход - новый род от своих основателей
+   while (size() < total)
+   {
+      couples.clear();
+      for (int f = 0; (f < _options.founders) && (size() < total); f++)
+      {
+         int year = _options.firstYear + static_cast<int>(rng.below(10));
+         int husband = addOutsider(0, year, rng);
+         if (size() >= total)
+            break;
+         int wife = addOutsider(1, year + 2 - static_cast<int>(rng.below(5)), rng);
+         couples.emplace_back(husband, wife);
+      }
+      _couples.insert(_couples.end(), couples.begin(), couples.end());
+
+      for (int gen = 1; (gen < _options.generations) && !couples.empty() && (size() < total); gen++)
+      {
+         born.clear();
+         for (const auto &couple : couples)
+         {
+            int count = childrenOf(rng);
+            int year = _birthYear[couple.second] + 19;
+            for (int i = 0; (i < count) && (size() < total); i++)
+            {
+               year += 1 + static_cast<int>(rng.below(4));
+               if (year > GENERATOR_LAST_YEAR)
+                  break;
+               born.push_back(addPerson(couple.first, couple.second, static_cast<int>(rng.below(2)), year,
+                                        _surname[couple.first], rng));
+            }
+         }
+
+         next.clear();
+         for (int pers : born)
+         {
+            if (!rng.chance(_marriage))
+               continue;
+            size_t first = next.size();
+            do
+            {
+               int spouse = rng.chance(_collapse) ? relativeFor(pers, born, rng) : -1;
+               if (spouse < 0)
+               {
+                  if (size() >= total)
+                     break;
+                  int year = std::min(_birthYear[pers] + 5 - static_cast<int>(rng.below(11)), GENERATOR_LAST_YEAR);
+                  spouse = addOutsider(1 - _sex[pers], year, rng);
+               }
+               // Повторный брак с тем же родственником дал бы вторую одинаковую семью
+               bool again = false;
+               for (size_t i = first; (i < next.size()) && !again; i++)
+                  again = (next[i].first == spouse) || (next[i].second == spouse);
+               if (again)
+                  continue;
+               if (_sex[pers] == 0)
+                  next.emplace_back(pers, spouse);
+               else
+                  next.emplace_back(spouse, pers);
+            } while (rng.chance(_remarriage));
+         }
+         _couples.insert(_couples.end(), next.begin(), next.end());
+         couples.swap(next);
+      }
+   }
+
+   linkChildren();
+}
+
+void TreeGenerator::linkChildren()
+{
+   int count = size();
+   _childStart.assign(count + 1, 0);
+   for (int i = 0; i < count; i++)
+   {
+      if (_father[i] >= 0)
+         _childStart[_father[i] + 1]++;
+      if (_mother[i] >= 0)
+         _childStart[_mother[i] + 1]++;
+   }
+   for (int i = 0; i < count; i++)
+      _childStart[i + 1] += _childStart[i];
+
+   // Дети по возрастанию номера - в порядке рождения
+   _childList.resize(_childStart[count]);
+   std::vector<uint32_t> pos(_childStart.begin(), _childStart.end() - 1);
+   for (int i = 0; i < count; i++)
+   {
+      if (_father[i] >= 0)
+         _childList[pos[_father[i]]++] = i;
+      if (_mother[i] >= 0)
+         _childList[pos[_mother[i]]++] = i;
+   }
+}
+
+std::string TreeGenerator::name(int num) const
+{
+   bool female = _sex[num] != 0;
+   uint32_t surname = _surname[num];
+   const NameForms &forms = (surname < COUNT_OF(SURNAMES)) ? SURNAMES[surname]
+                                                            : FOREIGN_SURNAMES[surname - COUNT_OF(SURNAMES)];
+
+   // Отчество - по имени отца, у основателей и пришедших со стороны - любое
+   int father = _father[num];
+   uint32_t fatherName = (father >= 0) ? _firstName[father]
+                                       : skewed(randomOf(num, RANDOM_PATRONYMIC).below(65536), COUNT_OF(MALE_NAMES));
+
+   std::string name = female ? forms.female : forms.male;
+   name += ' ';
+   name += female ? FEMALE_NAMES[_firstName[num]] : MALE_NAMES[_firstName[num]].name;
+   name += ' ';
+   name += female ? MALE_NAMES[fatherName].daughter : MALE_NAMES[fatherName].son;
+   return name;
+}
+
+int TreeGenerator::placeOf(int num) const
+{
+   Random rng = randomOf(num, RANDOM_PLACE);
+   if (rng.below(100) < 3)
+      return -1;
+   return static_cast<int>(skewed(rng.below(65536), COUNT_OF(PLACES)));
+}
+
+std::string TreeGenerator::birthPlace(int num) const
+{
+   int place = placeOf(num);
+   return (place >= 0) ? PLACES[place] : std::string();
+}
+
+QDate TreeGenerator::birthDate(int num) const
+{
+   Random rng = randomOf(num, RANDOM_BIRTH);
+   if (rng.below(100) < 2)
+      return QDate();
+   int month = 1 + static_cast<int>(rng.below(12));
+   return QDate(_birthYear[num], month, 1 + static_cast<int>(rng.below(28)));
+}
+
+QDate TreeGenerator::deathDate(int num) const
+{
+   Random rng = randomOf(num, RANDOM_DEATH);
+   // Каждый двенадцатый - в детстве, остальные доживают до 30-95
+   int age = (rng.below(12) == 0) ? static_cast<int>(rng.below(5)) : 30 + static_cast<int>(rng.below(66));
+   int year = _birthYear[num] + age;
+   if (year > GENERATOR_LAST_YEAR)
+      return QDate();
+
+   int month = 1 + static_cast<int>(rng.below(12));
+   QDate death(year, month, 1 + static_cast<int>(rng.below(28)));
+   QDate birth = birthDate(num);
+   if (birth.isValid() && (death < birth))
+      death = birth.addDays(1 + rng.below(300));
+   return death;
+}
+
+QString TreeGenerator::info(int num) const
+{
+   Random rng = randomOf(num, RANDOM_INFO);
+   if (!rng.chance(_notes))
+      return QString();
+   QString note = QString::fromUtf8(NOTES[rng.below(COUNT_OF(NOTES))]);
+   if (rng.below(4) == 0)
+      note += QString::fromUtf8("\nвторая строка");
+   return note;
+}
+
+QByteArray TreeGenerator::photo(int num) const
+{
+   Random rng = randomOf(num, RANDOM_PHOTO);
+   if (!rng.chance(_photos))
+      return QByteArray();
+
+   // Размер от половины до полутора средних; начало и конец как у JPEG, внутри шум
+   int size = _options.photoSize / 2 + static_cast<int>(rng.below(static_cast<uint32_t>(_options.photoSize) + 1));
+   QByteArray data(size, 0);
+   char *out = data.data();
+   for (int i = 0; i < size; i += 8)
+   {
+      uint64_t bits = rng.next();
+      for (int k = 0; (k < 8) && (i + k < size); k++, bits >>= 8)
+         out[i + k] = static_cast<char>(bits);
+   }
+   static const unsigned char head[] = { 0xFF, 0xD8, 0xFF, 0xE0 };
+   for (int k = 0; k < 4; k++)
+      out[k] = static_cast<char>(head[k]);
+   out[size - 2] = static_cast<char>(0xFF);
+   out[size - 1] = static_cast<char>(0xD9);
+   return data;
+}
+
+void TreeGenerator::fill(int num, Person &pers) const
+{
+   pers.id = id(num);
+   pers.name = QString::fromStdString(name(num));
+   pers.birthDate = birthDate(num);
+   pers.deathDate = deathDate(num);
+   pers.bIsAlive = !pers.deathDate.isValid();
+   pers.info = info(num);
+   int place = placeOf(num);
+   pers.birthPlace = (place >= 0) ? _places[place] : QString();
+   pers.photoData = photo(num);
+   pers.sex = _sexes[_sex[num]];
+}
+
+void TreeGenerator::makePersons(std::vector<Person> &persons) const
+{
+   int count = size();
+   persons.clear();
+   persons.resize(count);
+   for (int i = 0; i < count; i++)
+   {
+      Person &pers = persons[i];
+      fill(i, pers);
+      pers.father = (_father[i] >= 0) ? &persons[_father[i]] : nullptr;
+      pers.mother = (_mother[i] >= 0) ? &persons[_mother[i]] : nullptr;
+      pers.children.reserve(childCount(i));
+      for (int k = 0; k < childCount(i); k++)
+         pers.children.append(&persons[child(i, k)]);
+   }
+}
+
+int TreeGenerator::writeGedcom(const QString &fileName) const
+{
+   static const char *MONTHS[] = { "JAN", "FEB", "MAR", "APR", "MAY", "JUN", "JUL", "AUG", "SEP", "OCT", "NOV", "DEC" };
+
+   FILE *out = fopen(fileName.toLocal8Bit().constData(), "wb");
+   if (!out)
+   {
+      writeDebugLog("TreeGenerator::writeGedcom Could not open " + fileName);
+      return -1;
+   }
+   std::vector<char> buffer(1 << 20);
+   setvbuf(out, buffer.data(), _IOFBF, buffer.size());
+
+   fprintf(out, "0 HEAD\r\n1 SOUR treegen\r\n1 GEDC\r\n2 VERS 5.5.1\r\n1 CHAR UTF-8\r\n");
+   for (int num = 0; num < size(); num++)
+   {
+      // "Фамилия Имя Отчество" -> "Имя Отчество /Фамилия/"
+      std::string full = name(num);
+      size_t space = full.find(' ');
+      fprintf(out, "0 @I%u@ INDI\r\n1 NAME %s /%s/\r\n1 SEX %c\r\n", id(num), full.c_str() + space + 1,
+              full.substr(0, space).c_str(), _sex[num] ? 'F' : 'M');
+
+      QDate birth = birthDate(num);
+      std::string place = birthPlace(num);
+      fprintf(out, "1 BIRT\r\n");
+      if (birth.isValid())
+         fprintf(out, "2 DATE %d %s %d\r\n", birth.day(), MONTHS[birth.month() - 1], birth.year());
+      if (!place.empty())
+         fprintf(out, "2 PLAC %s\r\n", place.c_str());
+      QDate death = deathDate(num);
+      if (death.isValid())
+         fprintf(out, "1 DEAT\r\n2 DATE %d %s %d\r\n", death.day(), MONTHS[death.month() - 1], death.year());
+
+      QString note = info(num);
+      if (!note.isEmpty())
+      {
+         std::string text = note.toStdString();
+         size_t newline = text.find('\n');
+         fprintf(out, "1 NOTE %s\r\n", text.substr(0, newline).c_str());
+         if (newline != std::string::npos)
+            fprintf(out, "2 CONT %s\r\n", text.c_str() + newline + 1);
+      }
+   }
+
+   for (size_t fam = 0; fam < _couples.size(); fam++)
+   {
+      int husband = _couples[fam].first;
+      int wife = _couples[fam].second;
+      fprintf(out, "0 @F%zu@ FAM\r\n1 HUSB @I%u@\r\n1 WIFE @I%u@\r\n", fam + 1, id(husband), id(wife));
+      for (int k = 0; k < childCount(husband); k++)
+         if (_mother[child(husband, k)] == wife)
+            fprintf(out, "1 CHIL @I%u@\r\n", id(child(husband, k)));
+   }
+
+   fprintf(out, "0 TRLR\r\n");
+   if (fclose(out))
+   {
+      writeDebugLog("TreeGenerator::writeGedcom Write failed for " + fileName);
+      return -1;
+   }
+   return 0;
+}
+
+#ifdef DATABASE
+
+void TreeGenerator::fillRow(int num, PersonRow &row) const
+{
+   QDate death = deathDate(num);
+   int place = placeOf(num);
+
+   row.id = id(num);
+   row.name = name(num);
+   row.birthDate = birthDate(num).toString("dd.MM.yyyy").toStdString();
+   row.isAlive = death.isValid() ? "Dead" : "Alive";
+   row.deathDate = death.toString("dd.MM.yyyy").toStdString();
+   row.info = info(num).toStdString();
+   row.birthPlace = (place >= 0) ? PLACES[place] : "";
+   row.photo = photo(num).toBase64().toStdString();
+   row.sex = _sex[num] ? "Ж" : "М";
+   row.fatherId = (_father[num] >= 0) ? id(_father[num]) : static_cast<uint32_t>(-1);
+   row.motherId = (_mother[num] >= 0) ? id(_mother[num]) : static_cast<uint32_t>(-1);
+   row.childrenCnt = static_cast<uint32_t>(childCount(num));
+   row.childrenID.clear();
+   for (int k = 0; k < childCount(num); k++)
+   {
+      if (k)
+         row.childrenID += ' ';
+      row.childrenID += std::to_string(id(child(num, k)));
+   }
+}
+
+int TreeGenerator::writeDB(DB &db, const std::string &tableName) const
+{
+   std::vector<PersonRow> rows;
+   rows.reserve(std::min(size(), GENERATOR_DB_BATCH));
+   for (int num = 0; num < size(); num++)
+   {
+      rows.emplace_back();
+      fillRow(num, rows.back());
+      if ((rows.size() < static_cast<size_t>(GENERATOR_DB_BATCH)) && (num + 1 < size()))
+         continue;
+
+      int ret = db.addPersons(tableName, rows);
+      if (ret)
+      {
+         writeDebugLog("TreeGenerator::writeDB Insert failed for " + QString::fromStdString(tableName));
+         return ret;
+      }
+      rows.clear();
+   }
+   return 0;
+}
+
+#endif
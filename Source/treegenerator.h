@@ -0,0 +1,145 @@
+#ifndef TREEGENERATOR_H
+#define TREEGENERATOR_H
+
+/*
+ * Синтетическое родословное дерево для замеров.
+ * Дерево растёт по поколениям от пар-основателей: у пары в среднем options.children детей,
+ * часть детей вступает в брак - супруг приходит со стороны или (доля collapse) берётся из того же
+ * поколения дерева, так появляются браки родственников и общие предки; часть браков повторные.
+ * Когда поколения кончились, а людей мало, начинается следующий род с новыми основателями.
+ * Сначала строится только скелет - родители, пол, имя, фамилия и год рождения, около 26 байт
+ * на человека вместе со списками детей, поэтому в память помещаются десятки миллионов людей.
+ * Полные данные (русские имена с отчеством от имени отца и женскими формами фамилий, даты,
+ * места, заметки, фото) выводятся из номера человека и seed, когда они нужны.
+ * Случайные числа и распределения свои, без std::*_distribution: одни и те же параметры дают
+ * одно и то же дерево на любой платформе и в любой сборке.
+ */
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <QByteArray>
+#include <QString>
+
+#include "person.h"
+#ifdef DATABASE
+#include "db.h"
+#endif
+
+#define GENERATOR_LAST_YEAR    2019    // позже - живые, рождений позже нет
+#define GENERATOR_DB_BATCH     50000   // строк на транзакцию в writeDB
+#define GENERATOR_FOUNDER_SIZE 30000   // людей на пару основателей, если founders не задано
+
+struct TreeGeneratorOptions
+{
+   uint64_t seed;
+   int persons;          // всего людей
+   int generations;      // поколений в одном роду
+   int founders;         // пар-основателей рода, 0 - по числу людей
+   double children;      // детей на пару в среднем
+   double marriage;      // доля детей, вступающих в брак
+   double remarriage;    // доля браков, за которыми следует ещё один
+   double collapse;      // доля браков с человеком из того же поколения дерева
+   double foreign;       // доля супругов со стороны с нерусской фамилией
+   double photos;        // доля людей с фото
+   int photoSize;        // средний размер фото, байт
+   double notes;         // доля людей с заметкой
+   int firstYear;        // год рождения основателей
+   uint32_t firstId;
+
+   TreeGeneratorOptions();
+};
+
+class TreeGenerator
+{
+public:
+   explicit TreeGenerator(const TreeGeneratorOptions &options = TreeGeneratorOptions());
+
+   const TreeGeneratorOptions &options() const { return _options; }
+
+   // Люди пронумерованы так, что родители всегда раньше детей; -1 - нет родителя
+   int size() const { return static_cast<int>(_father.size()); }
+   uint32_t id(int num) const { return _options.firstId + static_cast<uint32_t>(num); }
+   int father(int num) const { return _father[num]; }
+   int mother(int num) const { return _mother[num]; }
+   bool isMale(int num) const { return _sex[num] == 0; }
+   int childCount(int num) const { return static_cast<int>(_childStart[num + 1] - _childStart[num]); }
+   int child(int num, int k) const { return _childList[_childStart[num] + k]; }
+
+   // UTF-8
+   std::string name(int num) const;
+   std::string birthPlace(int num) const;
+
+   // Все поля, кроме связей
+   void fill(int num, Person &pers) const;
+   // Всё дерево в память со связями, около 250 байт на человека без фото
+   void makePersons(std::vector<Person> &persons) const;
+   // GEDCOM 5.5.1 в UTF-8 одним проходом: сначала люди, затем семьи всех пар, в том числе бездетных
+   int writeGedcom(const QString &fileName) const;
+#ifdef DATABASE
+   void fillRow(int num, PersonRow &row) const;
+   // Пачками по GENERATOR_DB_BATCH, без Person в памяти; таблица - как после DB::createRoot
+   int writeDB(DB &db, const std::string &tableName) const;
+#endif
+
+private:
+   class Random
+   {
+   public:
+      explicit Random(uint64_t seed) : _state(seed) { }
+      uint64_t next();
+      // [0, n)
+      uint32_t below(uint32_t n) { return static_cast<uint32_t>(((next() >> 32) * n) >> 32); }
+      bool chance(uint32_t threshold) { return static_cast<uint32_t>(next() >> 32) < threshold; }
+
+   private:
+      uint64_t _state;
+   };
+
+   // Доля 0..1 в порог для Random::chance
+   static uint32_t threshold(double share);
+   // Свой поток случайных чисел на каждое поле человека
+   Random randomOf(int num, uint32_t field) const;
+
+   void build();
+   int addPerson(int father, int mother, int sex, int year, int surname, Random &rng);
+   int addOutsider(int sex, int year, Random &rng);
+   int childrenOf(Random &rng) const;
+   // Не брат и не сестра того же поколения; -1 - не нашлось
+   int relativeFor(int pers, const std::vector<int> &generation, Random &rng) const;
+   void linkChildren();
+
+   int placeOf(int num) const;
+   QDate birthDate(int num) const;
+   QDate deathDate(int num) const;
+   QString info(int num) const;
+   QByteArray photo(int num) const;
+
+   TreeGeneratorOptions _options;
+   uint32_t _marriage;
+   uint32_t _remarriage;
+   uint32_t _collapse;
+   uint32_t _foreign;
+   uint32_t _photos;
+   uint32_t _notes;
+   uint32_t _childTrial;
+   int _childTrials;
+
+   std::vector<int32_t> _father;
+   std::vector<int32_t> _mother;
+   std::vector<int16_t> _birthYear;
+   std::vector<uint16_t> _surname;
+   std::vector<uint8_t> _firstName;
+   std::vector<uint8_t> _sex;           // 0 - мужской, 1 - женский
+   std::vector<uint32_t> _childStart;   // size() + 1
+   std::vector<int32_t> _childList;
+   std::vector<std::pair<int32_t, int32_t>> _couples;   // муж, жена
+
+   // Общие для всех людей строки: QString делит данные, а не копирует
+   std::vector<QString> _places;
+   QString _sexes[2];
+};
+
+#endif // TREEGENERATOR_H
@@ -0,0 +1,98 @@
+#include "treegraph.h"
+#include "person.h"
+
+TreeGraph::TreeGraph()
+{
+
+}
+
+void TreeGraph::clear()
+{
+   personId.clear();
+   father.clear();
+   mother.clear();
+   childStart.clear();
+   childList.clear();
+   _index.clear();
+}
+
+void TreeGraph::reserve(int count)
+{
+   personId.reserve(count);
+   father.reserve(count);
+   mother.reserve(count);
+   _index.reserve(count);
+}
+
+int TreeGraph::addNode(uint32_t id, int fatherNode, int motherNode)
+{
+   int node = size();
+   personId.push_back(id);
+   father.push_back(fatherNode);
+   mother.push_back(motherNode);
+   _index[id] = node;
+   return node;
+}
+
+void TreeGraph::setParents(int node, int fatherNode, int motherNode)
+{
+   father[node] = fatherNode;
+   mother[node] = motherNode;
+}
+
+void TreeGraph::finalize()
+{
+   int n = size();
+
+   childStart.assign(n + 1, 0);
+   for (int i = 0; i < n; i++)
+   {
+      if (father[i] >= 0)
+         childStart[father[i] + 1]++;
+      if ((mother[i] >= 0) && (mother[i] != father[i]))
+         childStart[mother[i] + 1]++;
+   }
+   for (int i = 0; i < n; i++)
+      childStart[i + 1] += childStart[i];
+
+   childList.resize(childStart[n]);
+   std::vector<int> fill(childStart.begin(), childStart.end() - 1);
+   for (int i = 0; i < n; i++)
+   {
+      if (father[i] >= 0)
+         childList[fill[father[i]]++] = i;
+      if ((mother[i] >= 0) && (mother[i] != father[i]))
+         childList[fill[mother[i]]++] = i;
+   }
+}
+
+int TreeGraph::indexOf(uint32_t id) const
+{
+   auto it = _index.find(id);
+   return (it != _index.end()) ? it->second : -1;
+}
+
+TreeGraph TreeGraph::fromPersons(const QVector<Person*> &persons)
+{
+   TreeGraph graph;
+   graph.reserve(persons.size());
+
+   std::unordered_map<const Person*, int> nodes;
+   nodes.reserve(persons.size());
+   for (const Person *pers : persons)
+      nodes[pers] = graph.addNode(pers->id);
+
+   auto find = [&nodes](const Person *pers) -> int
+   {
+      if (!pers)
+         return -1;
+      auto it = nodes.find(pers);
+      return (it != nodes.end()) ? it->second : -1;
+   };
+
+   for (const Person *pers : persons)
+      graph.setParents(nodes[pers], find(pers->father), find(pers->mother));
+
+   graph.finalize();
+   return graph;
+}
@@ -0,0 +1,45 @@
+#ifndef TREEGRAPH_H
+#define TREEGRAPH_H
+
+/*
+ * Компактное представление дерева: люди пронумерованы подряд, родители хранятся индексами,
+ * дети - в виде CSR (childStart/childList). Используется алгоритмами раскладки и обхода.
+ */
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+#include <QVector>
+
+struct Person;
+
+class TreeGraph
+{
+public:
+   TreeGraph();
+
+   void clear();
+   void reserve(int count);
+   int addNode(uint32_t id, int father = -1, int mother = -1);
+   void setParents(int node, int father, int mother);
+   void finalize();
+
+   static TreeGraph fromPersons(const QVector<Person*> &persons);
+
+   int size() const { return static_cast<int>(father.size()); }
+   int childCount(int node) const { return childStart[node + 1] - childStart[node]; }
+   int child(int node, int num) const { return childList[childStart[node] + num]; }
+   int indexOf(uint32_t id) const;
+
+   std::vector<uint32_t> personId;
+   std::vector<int> father;
+   std::vector<int> mother;
+   std::vector<int> childStart;   // size() + 1 элементов после finalize()
+   std::vector<int> childList;
+
+private:
+   std::unordered_map<uint32_t, int> _index;
+};
+
+#endif // TREEGRAPH_H
@@ -0,0 +1,931 @@
+#include "treelayout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_set>
+#include <unordered_map>
+
+TreeLayout::TreeLayout()
+   : _root(-1),
+   _recordMoves(false),
+   _left(0),
+   _width(0),
+   _height(0),
+   _version(0)
+{
+
+}
+
+void TreeLayout::setParams(const LayoutParams &params)
+{
+   _params = params;
+}
+
+void TreeLayout::run(const TreeGraph &graph)
+{
+   buildUnits(graph);
+   buildUnitTree(graph);
+   firstWalk();
+   secondWalk();
+   _moved.clear();
+   placeMembers();
+   _version++;
+}
+
+int TreeLayout::wantedOwner(const TreeGraph &graph, int node) const
+{
+   // Противоречивые данные (один человек и отец, и мать) могут дать цепочку - тогда своя семья
+   int owner = ownerCandidate(graph, node);
+   if ((owner != node) && (ownerCandidate(graph, owner) != owner))
+      return node;
+   return owner;
+}
+
+int TreeLayout::ownerCandidate(const TreeGraph &graph, int node) const
+{
+   auto parentless = [&graph](int n)
+   {
+      return (graph.father[n] < 0) && (graph.mother[n] < 0);
+   };
+
+   if (!parentless(node))
+      return node;
+
+   // Супруг без родителей в дереве встаёт рядом с первым супругом, у которого родители есть
+   for (int k = 0; k < graph.childCount(node); k++)
+   {
+      int c = graph.child(node, k);
+      int partner = (graph.father[c] == node) ? graph.mother[c] : graph.father[c];
+      if ((partner >= 0) && (partner != node) && !parentless(partner))
+         return partner;
+   }
+
+   // Если родителей нет у обоих, жена встаёт в семью мужа
+   for (int k = 0; k < graph.childCount(node); k++)
+   {
+      int c = graph.child(node, k);
+      int f = graph.father[c];
+      if ((graph.mother[c] != node) || (f < 0) || (f == node))
+         continue;
+      for (int j = 0; j < graph.childCount(f); j++)
+      {
+         int fc = graph.child(f, j);
+         int partner = (graph.father[fc] == f) ? graph.mother[fc] : graph.father[fc];
+         if ((partner >= 0) && (partner != f) && !parentless(partner))
+            return partner;
+      }
+      return f;
+   }
+
+   return node;
+}
+
+void TreeLayout::buildUnits(const TreeGraph &graph)
+{
+   int n = graph.size();
+   std::vector<int> owner(n);
+   for (int i = 0; i < n; i++)
+      owner[i] = wantedOwner(graph, i);
+
+   _unitOf.assign(n, -1);
+   int units = 0;
+   for (int i = 0; i < n; i++)
+      if (owner[i] == i)
+         _unitOf[i] = units++;
+
+   // Последний узел - виртуальный корень, объединяющий все деревья леса
+   _root = units;
+   _memberHead.assign(units + 1, -1);
+   _memberCount.assign(units + 1, 0);
+   _memberNext.assign(n, -1);
+
+   // Первым в семье идёт её владелец, за ним супруги по возрастанию номера
+   for (int i = n - 1; i >= 0; i--)
+   {
+      if (owner[i] == i)
+         continue;
+      int u = _unitOf[owner[i]];
+      _unitOf[i] = u;
+      _memberNext[i] = _memberHead[u];
+      _memberHead[u] = i;
+      _memberCount[u]++;
+   }
+   for (int i = 0; i < n; i++)
+   {
+      if (owner[i] != i)
+         continue;
+      int u = _unitOf[i];
+      _memberNext[i] = _memberHead[u];
+      _memberHead[u] = i;
+      _memberCount[u]++;
+   }
+
+   _unitWidth.assign(units + 1, 0);
+   for (int u = 0; u < units; u++)
+      updateUnitWidth(u);
+}
+
+void TreeLayout::updateUnitWidth(int unit)
+{
+   int members = _memberCount[unit];
+   _unitWidth[unit] = members ? members * _params.cardWidth + (members - 1) * _params.spouseGap : 0;
+}
+
+void TreeLayout::buildUnitTree(const TreeGraph &graph)
+{
+   int units = unitCount();
+
+   _unitParent.assign(units, _root);
+   _unitParent[_root] = -1;
+   for (int u = 0; u < _root; u++)
+   {
+      int owner = _memberHead[u];
+      int p = (graph.father[owner] >= 0) ? graph.father[owner] : graph.mother[owner];
+      if ((p >= 0) && (_unitOf[p] != u))
+         _unitParent[u] = _unitOf[p];
+   }
+
+   // Противоречивые данные (человек оказался своим предком) дают циклы - разрываем их
+   std::vector<int> state(units, 0);   // 0 - не проверен, 1 - в текущей цепочке, 2 - достижим из корня
+   state[_root] = 2;
+   for (int u = 0; u < _root; u++)
+   {
+      int v = u;
+      while (state[v] == 0)
+      {
+         state[v] = 1;
+         v = _unitParent[v];
+      }
+      if (state[v] == 1)
+         _unitParent[v] = _root;
+      for (v = u; state[v] == 1; v = _unitParent[v])
+         state[v] = 2;
+   }
+
+   _firstChild.assign(units, -1);
+   _lastChild.assign(units, -1);
+   _prevSibling.assign(units, -1);
+   _nextSibling.assign(units, -1);
+   _number.assign(units, 0);
+   for (int u = 0; u < _root; u++)
+   {
+      int p = _unitParent[u];
+      if (_lastChild[p] >= 0)
+      {
+         _nextSibling[_lastChild[p]] = u;
+         _prevSibling[u] = _lastChild[p];
+         _number[u] = _number[_lastChild[p]] + 1;
+      }
+      else
+      {
+         _firstChild[p] = u;
+         _number[u] = 1;
+      }
+      _lastChild[p] = u;
+   }
+}
+
+double TreeLayout::distance(int left, int right) const
+{
+   double gap = (_unitParent[left] == _unitParent[right]) ? _params.siblingGap : _params.subtreeGap;
+   return (_unitWidth[left] + _unitWidth[right]) / 2 + gap;
+}
+
+void TreeLayout::firstWalk()
+{
+   int units = unitCount();
+   _prelim.assign(units, 0);
+   _mod.assign(units, 0);
+   _shift.assign(units, 0);
+   _change.assign(units, 0);
+   _thread.assign(units, -1);
+   _ancestor.resize(units);
+   for (int u = 0; u < units; u++)
+      _ancestor[u] = u;
+
+   // Обход в обратном порядке без рекурсии: глубина реальных деревьев не ограничена
+   std::vector<int> defaultAncestor(units, -1);
+   std::vector<int> cursor(units, -1);
+   std::vector<int> stack;
+   stack.push_back(_root);
+   cursor[_root] = _firstChild[_root];
+   defaultAncestor[_root] = _firstChild[_root];
+   while (!stack.empty())
+   {
+      int v = stack.back();
+      int w = cursor[v];
+      if (w >= 0)
+      {
+         cursor[v] = _nextSibling[w];
+         cursor[w] = _firstChild[w];
+         defaultAncestor[w] = _firstChild[w];
+         stack.push_back(w);
+         continue;
+      }
+
+      stack.pop_back();
+      finishNode(v);
+
+      int p = _unitParent[v];
+      if (p >= 0)
+         defaultAncestor[p] = apportion(v, defaultAncestor[p]);
+   }
+}
+
+void TreeLayout::finishNode(int v)
+{
+   int w = leftSibling(v);
+   if (_firstChild[v] < 0)
+   {
+      _prelim[v] = (w >= 0) ? _prelim[w] + distance(w, v) : 0;
+      return;
+   }
+
+   executeShifts(v);
+   double midpoint = (_prelim[_firstChild[v]] + _prelim[_lastChild[v]]) / 2;
+   if (w >= 0)
+   {
+      _prelim[v] = _prelim[w] + distance(w, v);
+      _mod[v] = _prelim[v] - midpoint;
+   }
+   else
+   {
+      _prelim[v] = midpoint;
+   }
+}
+
+int TreeLayout::apportion(int v, int defaultAncestor)
+{
+   int w = leftSibling(v);
+   if (w < 0)
+      return defaultAncestor;
+
+   int vip = v, vop = v;
+   int vim = w, vom = leftmostSibling(v);
+   double sip = _mod[vip], sop = _mod[vop];
+   double sim = _mod[vim], som = _mod[vom];
+
+   while ((nextRight(vim) >= 0) && (nextLeft(vip) >= 0))
+   {
+      vim = nextRight(vim);
+      vip = nextLeft(vip);
+      vom = nextLeft(vom);
+      vop = nextRight(vop);
+      _ancestor[vop] = v;
+
+      double shift = (_prelim[vim] + sim) - (_prelim[vip] + sip) + distance(vim, vip);
+      if (shift > 0)
+      {
+         int a = (_unitParent[_ancestor[vim]] == _unitParent[v]) ? _ancestor[vim] : defaultAncestor;
+         moveSubtree(a, v, shift);
+         sip += shift;
+         sop += shift;
+      }
+      sim += _mod[vim];
+      sip += _mod[vip];
+      som += _mod[vom];
+      sop += _mod[vop];
+   }
+
+   if ((nextRight(vim) >= 0) && (nextRight(vop) < 0))
+   {
+      _thread[vop] = nextRight(vim);
+      _mod[vop] += sim - sop;
+   }
+   if ((nextLeft(vip) >= 0) && (nextLeft(vom) < 0))
+   {
+      _thread[vom] = nextLeft(vip);
+      _mod[vom] += sip - som;
+      defaultAncestor = v;
+   }
+   return defaultAncestor;
+}
+
+void TreeLayout::moveSubtree(int wm, int wp, double shift)
+{
+   double subtrees = _number[wp] - _number[wm];
+   _change[wp] -= shift / subtrees;
+   _shift[wp] += shift;
+   _change[wm] += shift / subtrees;
+   _prelim[wp] += shift;
+   _mod[wp] += shift;
+}
+
+void TreeLayout::executeShifts(int v)
+{
+   double shift = 0, change = 0;
+   for (int w = _lastChild[v]; w >= 0; w = _prevSibling[w])
+   {
+      _prelim[w] += shift;
+      _mod[w] += shift;
+      change += _change[w];
+      shift += _shift[w] + change;
+   }
+}
+
+void TreeLayout::secondWalk()
+{
+   int units = unitCount();
+   _unitX.assign(units, 0);
+   _unitDepth.assign(units, 0);
+
+   std::vector<std::pair<int, double>> stack;
+   _unitDepth[_root] = -1;
+   stack.emplace_back(_root, -_prelim[_root]);
+   while (!stack.empty())
+   {
+      int v = stack.back().first;
+      double m = stack.back().second;
+      stack.pop_back();
+
+      _unitX[v] = _prelim[v] + m;
+      for (int w = _firstChild[v]; w >= 0; w = _nextSibling[w])
+      {
+         _unitDepth[w] = _unitDepth[v] + 1;
+         stack.emplace_back(w, m + _mod[v]);
+      }
+   }
+}
+
+void TreeLayout::placeUnitMembers(int unit)
+{
+   double step = _params.cardWidth + _params.spouseGap;
+   double left = _unitX[unit] - _unitWidth[unit] / 2 + _params.cardWidth / 2;
+   double y = _unitDepth[unit] * (_params.cardHeight + _params.levelGap) + _params.cardHeight / 2;
+
+   for (int node = _memberHead[unit]; node >= 0; node = _memberNext[node])
+   {
+      if (_recordMoves && !_movedMark[node] && ((_x[node] != left) || (_y[node] != y)))
+      {
+         _movedMark[node] = 1;
+         _moved.push_back({ node, _x[node], _y[node] });
+      }
+      _x[node] = left;
+      _y[node] = y;
+      left += step;
+   }
+}
+
+void TreeLayout::placeMembers()
+{
+   int n = static_cast<int>(_unitOf.size());
+   _x.assign(n, 0);
+   _y.assign(n, 0);
+   _left = 0;
+   _width = 0;
+   _height = 0;
+
+   _leftContour.assign(unitCount(), std::vector<double>());
+   _rightContour.assign(unitCount(), std::vector<double>());
+   _contourValid.assign(unitCount(), 0);
+   if (!n)
+      return;
+
+   double minX = std::numeric_limits<double>::max();
+   double maxX = std::numeric_limits<double>::lowest();
+   int maxDepth = 0;
+   for (int u = 0; u < _root; u++)
+   {
+      minX = std::min(minX, _unitX[u] - _unitWidth[u] / 2);
+      maxX = std::max(maxX, _unitX[u] + _unitWidth[u] / 2);
+      maxDepth = std::max(maxDepth, _unitDepth[u]);
+   }
+
+   for (int u = 0; u < unitCount(); u++)
+      _unitX[u] -= minX;
+
+   // Родитель может стоять позже ребёнка (добавлен правкой), поэтому смещения - после сдвига всех семей
+   _relX.assign(unitCount(), 0);
+   for (int u = 0; u < _root; u++)
+   {
+      _relX[u] = _unitX[u] - _unitX[_unitParent[u]];
+      placeUnitMembers(u);
+   }
+
+   _width = maxX - minX;
+   _height = (maxDepth + 1) * (_params.cardHeight + _params.levelGap) - _params.levelGap;
+}
+
+int TreeLayout::newUnit()
+{
+   int unit = unitCount();
+   _memberHead.push_back(-1);
+   _memberCount.push_back(0);
+   _unitParent.push_back(-1);
+   _firstChild.push_back(-1);
+   _lastChild.push_back(-1);
+   _prevSibling.push_back(-1);
+   _nextSibling.push_back(-1);
+   _unitWidth.push_back(0);
+   _unitDepth.push_back(0);
+   _unitX.push_back(0);
+   _relX.push_back(0);
+   _leftContour.emplace_back();
+   _rightContour.emplace_back();
+   _contourValid.push_back(0);
+   return unit;
+}
+
+void TreeLayout::addMember(int unit, int node)
+{
+   _unitOf[node] = unit;
+   _memberCount[unit]++;
+
+   int head = _memberHead[unit];
+   if (head < 0)
+   {
+      _memberHead[unit] = node;
+      _memberNext[node] = -1;
+      return;
+   }
+
+   int prev = head;
+   while ((_memberNext[prev] >= 0) && (_memberNext[prev] < node))
+      prev = _memberNext[prev];
+   _memberNext[node] = _memberNext[prev];
+   _memberNext[prev] = node;
+}
+
+void TreeLayout::removeMember(int unit, int node)
+{
+   if (_memberHead[unit] == node)
+   {
+      _memberHead[unit] = _memberNext[node];
+   }
+   else
+   {
+      int prev = _memberHead[unit];
+      while (_memberNext[prev] != node)
+         prev = _memberNext[prev];
+      _memberNext[prev] = _memberNext[node];
+   }
+   _memberNext[node] = -1;
+   _memberCount[unit]--;
+   _unitOf[node] = -1;
+}
+
+void TreeLayout::attachChild(int parent, int unit)
+{
+   // Дети упорядочены по номеру владельца семьи, как и при полной раскладке
+   int key = _memberHead[unit];
+   int next = -1;
+   int prev = _lastChild[parent];
+   while ((prev >= 0) && (_memberHead[prev] > key))
+   {
+      next = prev;
+      prev = _prevSibling[prev];
+   }
+
+   _unitParent[unit] = parent;
+   _prevSibling[unit] = prev;
+   _nextSibling[unit] = next;
+   if (prev >= 0)
+      _nextSibling[prev] = unit;
+   else
+      _firstChild[parent] = unit;
+   if (next >= 0)
+      _prevSibling[next] = unit;
+   else
+      _lastChild[parent] = unit;
+}
+
+void TreeLayout::detachChild(int unit)
+{
+   int parent = _unitParent[unit];
+   if (parent < 0)
+      return;
+
+   if (_prevSibling[unit] >= 0)
+      _nextSibling[_prevSibling[unit]] = _nextSibling[unit];
+   else
+      _firstChild[parent] = _nextSibling[unit];
+   if (_nextSibling[unit] >= 0)
+      _prevSibling[_nextSibling[unit]] = _prevSibling[unit];
+   else
+      _lastChild[parent] = _prevSibling[unit];
+
+   _unitParent[unit] = -1;
+   _prevSibling[unit] = -1;
+   _nextSibling[unit] = -1;
+}
+
+int TreeLayout::wantedParentUnit(const TreeGraph &graph, int unit) const
+{
+   int owner = _memberHead[unit];
+   int p = (graph.father[owner] >= 0) ? graph.father[owner] : graph.mother[owner];
+   if ((p < 0) || (_unitOf[p] < 0) || (_unitOf[p] == unit))
+      return _root;
+
+   for (int a = _unitOf[p]; a >= 0; a = _unitParent[a])
+      if (a == unit)
+         return _root;
+   return _unitOf[p];
+}
+
+void TreeLayout::invalidateContour(int unit)
+{
+   _contourValid[unit] = 0;
+   _leftContour[unit].clear();
+   _rightContour[unit].clear();
+}
+
+const std::vector<double> &TreeLayout::leftContour(int unit)
+{
+   buildContour(unit);
+   return _leftContour[unit];
+}
+
+const std::vector<double> &TreeLayout::rightContour(int unit)
+{
+   buildContour(unit);
+   return _rightContour[unit];
+}
+
+void TreeLayout::buildContour(int unit)
+{
+   if (_contourValid[unit])
+      return;
+
+   // Контуры считаются лениво снизу вверх и живут до следующей правки поддерева
+   std::vector<std::pair<int, bool>> stack;
+   stack.emplace_back(unit, false);
+   while (!stack.empty())
+   {
+      int v = stack.back().first;
+      if (!stack.back().second)
+      {
+         stack.back().second = true;
+         for (int c = _firstChild[v]; c >= 0; c = _nextSibling[c])
+            if (!_contourValid[c])
+               stack.emplace_back(c, false);
+         continue;
+      }
+      stack.pop_back();
+
+      std::vector<double> &lc = _leftContour[v];
+      std::vector<double> &rc = _rightContour[v];
+      lc.assign(1, -_unitWidth[v] / 2);
+      rc.assign(1, _unitWidth[v] / 2);
+      for (int c = _firstChild[v]; c >= 0; c = _nextSibling[c])
+      {
+         double dx = _relX[c];
+         const std::vector<double> &clc = _leftContour[c];
+         const std::vector<double> &crc = _rightContour[c];
+         if (lc.size() < clc.size() + 1)
+         {
+            lc.resize(clc.size() + 1, std::numeric_limits<double>::max());
+            rc.resize(crc.size() + 1, std::numeric_limits<double>::lowest());
+         }
+         for (size_t d = 0; d < clc.size(); d++)
+         {
+            lc[d + 1] = std::min(lc[d + 1], dx + clc[d]);
+            rc[d + 1] = std::max(rc[d + 1], dx + crc[d]);
+         }
+      }
+      _contourValid[v] = 1;
+   }
+}
+
+void TreeLayout::placeChildren(int unit)
+{
+   std::vector<int> kids;
+   for (int c = _firstChild[unit]; c >= 0; c = _nextSibling[c])
+      kids.push_back(c);
+   if (kids.empty())
+      return;
+
+   for (int c : kids)
+      buildContour(c);
+
+   // Дети ставятся слева направо вплотную по контурам; сдвиг, вызванный дальним соседом,
+   // распределяется между промежуточными поддеревьями, как у Уокера
+   std::vector<double> pos(kids.size(), 0);
+   std::vector<double> accRight;
+   std::vector<int> accOwner;
+   std::vector<char> moved(kids.size(), 0);
+   std::vector<size_t> movedList;
+
+   auto merge = [&](size_t i)
+   {
+      const std::vector<double> &rc = _rightContour[kids[i]];
+      for (size_t d = 0; d < rc.size(); d++)
+      {
+         if (d >= accRight.size())
+         {
+            accRight.push_back(pos[i] + rc[d]);
+            accOwner.push_back(static_cast<int>(i));
+         }
+         else if (pos[i] + rc[d] >= accRight[d])
+         {
+            accRight[d] = pos[i] + rc[d];
+            accOwner[d] = static_cast<int>(i);
+         }
+      }
+   };
+
+   for (size_t i = 0; i < kids.size(); i++)
+   {
+      if (i > 0)
+      {
+         const std::vector<double> &lc = _leftContour[kids[i]];
+         pos[i] = pos[i - 1];
+         size_t levels = std::min(lc.size(), accRight.size());
+         for (size_t d = 0; d < levels; d++)
+         {
+            double gap = d ? _params.subtreeGap : _params.siblingGap;
+            double shift = accRight[d] + gap - (pos[i] + lc[d]);
+            if (shift <= 0)
+               continue;
+
+            pos[i] += shift;
+            size_t j = accOwner[d];
+            for (size_t s = j + 1; s < i; s++)
+            {
+               pos[s] += shift * (s - j) / (i - j);
+               if (!moved[s])
+               {
+                  moved[s] = 1;
+                  movedList.push_back(s);
+               }
+            }
+         }
+         for (size_t s : movedList)
+         {
+            merge(s);
+            moved[s] = 0;
+         }
+         movedList.clear();
+      }
+      merge(i);
+   }
+
+   double mid = (pos.front() + pos.back()) / 2;
+   for (size_t i = 0; i < kids.size(); i++)
+      _relX[kids[i]] = pos[i] - mid;
+}
+
+void TreeLayout::moveSubtreeTo(int unit, double dx, int depthDelta)
+{
+   std::vector<int> stack(1, unit);
+   while (!stack.empty())
+   {
+      int v = stack.back();
+      stack.pop_back();
+      _unitX[v] += dx;
+      _unitDepth[v] += depthDelta;
+      placeUnitMembers(v);
+      for (int c = _firstChild[v]; c >= 0; c = _nextSibling[c])
+         stack.push_back(c);
+   }
+}
+
+void TreeLayout::update(const TreeGraph &graph, const std::vector<int> &changedNodes)
+{
+   if (_root < 0)
+   {
+      run(graph);
+      return;
+   }
+
+   int n = graph.size();
+   _unitOf.resize(n, -1);
+   _memberNext.resize(n, -1);
+   _x.resize(n, 0);
+   _y.resize(n, 0);
+   _movedMark.resize(n, 0);
+   _moved.clear();
+   _recordMoves = true;
+
+   std::unordered_set<int> dirty;
+   std::vector<int> reparent;
+
+   // 1. Принадлежность к семьям: правленые люди, их родители и супруги
+   std::vector<int> work;
+   std::unordered_set<int> queued;
+   auto enqueue = [&](int node)
+   {
+      if ((node >= 0) && queued.insert(node).second)
+         work.push_back(node);
+   };
+   auto enqueuePartners = [&](int node)
+   {
+      for (int k = 0; k < graph.childCount(node); k++)
+      {
+         int c = graph.child(node, k);
+         enqueue((graph.father[c] == node) ? graph.mother[c] : graph.father[c]);
+      }
+   };
+
+   for (int node : changedNodes)
+   {
+      enqueue(node);
+      enqueue(graph.father[node]);
+      enqueue(graph.mother[node]);
+      enqueuePartners(node);
+
+      // Жена мужа без родителей встаёт в семью его супруга с родителями - это два шага по бракам
+      for (int k = 0; k < graph.childCount(node); k++)
+      {
+         int c = graph.child(node, k);
+         int partner = (graph.father[c] == node) ? graph.mother[c] : graph.father[c];
+         if ((partner >= 0) && (partner != node))
+            enqueuePartners(partner);
+      }
+      if (graph.father[node] >= 0)
+         enqueuePartners(graph.father[node]);
+      if (graph.mother[node] >= 0)
+         enqueuePartners(graph.mother[node]);
+   }
+
+   auto moveTo = [&](int node, int unit)
+   {
+      int old = _unitOf[node];
+      if (old >= 0)
+      {
+         bool wasOwner = (_memberHead[old] == node);
+         removeMember(old, node);
+         dirty.insert(old);
+
+         // Ушёл владелец - остальные члены семьи пересчитываются заново
+         if (wasOwner)
+         {
+            while (_memberHead[old] >= 0)
+            {
+               int m = _memberHead[old];
+               removeMember(old, m);
+               queued.erase(m);
+               enqueue(m);
+            }
+         }
+      }
+      addMember(unit, node);
+      dirty.insert(unit);
+      for (int k = 0; k < graph.childCount(node); k++)
+      {
+         int c = graph.child(node, k);
+         if ((_unitOf[c] >= 0) && (_memberHead[_unitOf[c]] == c))
+            reparent.push_back(_unitOf[c]);
+      }
+   };
+
+   for (size_t w = 0; w < work.size(); w++)
+   {
+      int node = work[w];
+      int owner = wantedOwner(graph, node);
+
+      if (owner == node)
+      {
+         if ((_unitOf[node] >= 0) && (_memberHead[_unitOf[node]] == node))
+            continue;
+         int unit = newUnit();
+         moveTo(node, unit);
+         reparent.push_back(unit);
+         continue;
+      }
+
+      if ((_unitOf[owner] < 0) || (_memberHead[_unitOf[owner]] != owner))
+      {
+         int unit = newUnit();
+         moveTo(owner, unit);
+         reparent.push_back(unit);
+      }
+      if (_unitOf[node] != _unitOf[owner])
+         moveTo(node, _unitOf[owner]);
+   }
+
+   for (int node : changedNodes)
+      if ((_unitOf[node] >= 0) && (_memberHead[_unitOf[node]] == node))
+         reparent.push_back(_unitOf[node]);
+
+   // 2. Опустевшие семьи отцепляются, их дети ищут новое место
+   std::vector<int> dead;
+   for (int u : dirty)
+   {
+      if ((u == _root) || _memberCount[u])
+      {
+         updateUnitWidth(u);
+         continue;
+      }
+      dead.push_back(u);
+      for (int c = _firstChild[u]; c >= 0; c = _nextSibling[c])
+         reparent.push_back(c);
+   }
+   for (int u : dead)
+   {
+      dirty.erase(u);
+      if (_unitParent[u] >= 0)
+         dirty.insert(_unitParent[u]);
+      detachChild(u);
+      updateUnitWidth(u);
+   }
+
+   for (int u : reparent)
+   {
+      if (!_memberCount[u])
+         continue;
+      int p = wantedParentUnit(graph, u);
+      if (p == _unitParent[u])
+         continue;
+      if (_unitParent[u] >= 0)
+         dirty.insert(_unitParent[u]);
+      detachChild(u);
+      attachChild(p, u);
+      dirty.insert(p);
+      dirty.insert(u);
+   }
+   for (int u : dead)
+      while (_firstChild[u] >= 0)
+      {
+         int c = _firstChild[u];
+         detachChild(c);
+         attachChild(_root, c);
+         dirty.insert(c);
+      }
+
+   // 3. Перекладываются правленые семьи и все их предки, от глубоких к корню
+   std::unordered_map<int, int> depth;
+   for (int u : dirty)
+   {
+      std::vector<int> path;
+      for (int a = u; (a >= 0) && !depth.count(a); a = _unitParent[a])
+         path.push_back(a);
+      if (path.empty())
+         continue;
+      int top = _unitParent[path.back()];
+      int base = (top >= 0) ? depth[top] + 1 : -1;
+      for (size_t i = path.size(); i-- > 0; )
+         depth[path[i]] = base + static_cast<int>(path.size() - 1 - i);
+   }
+
+   std::vector<std::pair<int, int>> order;
+   order.reserve(depth.size());
+   for (auto &it : depth)
+   {
+      invalidateContour(it.first);
+      order.emplace_back(it.second, it.first);
+   }
+   std::sort(order.begin(), order.end());
+
+   for (size_t i = order.size(); i-- > 0; )
+   {
+      placeChildren(order[i].second);
+      buildContour(order[i].second);
+   }
+
+   // 4. Абсолютные координаты: переложенные семьи ставятся заново, соседние поддеревья сдвигаются целиком.
+   // Виртуальный корень привязан к первому дереву леса, чтобы оно не сдвигалось от правок в соседних
+   if (_firstChild[_root] >= 0)
+      _unitX[_root] = _unitX[_firstChild[_root]] - _relX[_firstChild[_root]];
+
+   for (auto &it : order)
+   {
+      int v = it.second;
+      for (int c = _firstChild[v]; c >= 0; c = _nextSibling[c])
+      {
+         double x = _unitX[v] + _relX[c];
+         int d = it.first + 1;
+         if (depth.count(c))
+         {
+            _unitX[c] = x;
+            _unitDepth[c] = d;
+            placeUnitMembers(c);
+         }
+         else if ((std::fabs(x - _unitX[c]) > 1e-6) || (d != _unitDepth[c]))
+         {
+            moveSubtreeTo(c, x - _unitX[c], d - _unitDepth[c]);
+         }
+      }
+   }
+
+   _recordMoves = false;
+   for (const Move &move : _moved)
+      _movedMark[move.node] = 0;
+
+   updateBounds();
+   _version++;
+}
+
+void TreeLayout::updateBounds()
+{
+   const std::vector<double> &lc = leftContour(_root);
+   const std::vector<double> &rc = rightContour(_root);
+
+   _left = 0;
+   _width = 0;
+   _height = 0;
+   if (lc.size() < 2)
+      return;
+
+   double minX = std::numeric_limits<double>::max();
+   double maxX = std::numeric_limits<double>::lowest();
+   for (size_t d = 1; d < lc.size(); d++)
+   {
+      minX = std::min(minX, lc[d]);
+      maxX = std::max(maxX, rc[d]);
+   }
+
+   _left = _unitX[_root] + minX;
+   _width = maxX - minX;
+   _height = (lc.size() - 1) * (_params.cardHeight + _params.levelGap) - _params.levelGap;
+}
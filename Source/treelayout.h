@@ -0,0 +1,149 @@
+#ifndef TREELAYOUT_H
+#define TREELAYOUT_H
+
+/*
+ * Раскладка дерева за линейное время (алгоритм Уокера в варианте Бухгейма).
+ * Узлом раскладки служит "семья": человек вместе с супругами без родителей в дереве,
+ * поэтому у ребёнка всегда один узел-родитель, даже если известны оба родителя.
+ * Координаты - центры карточек, полная раскладка начинается с левого верхнего угла (0,0).
+ *
+ * После полной раскладки дерево можно править точечно: update() перестраивает только
+ * затронутые семьи, переставляет детей их предков по кэшированным контурам поддеревьев
+ * и сдвигает соседние поддеревья целиком. В changedNodes передаются добавленные люди и люди
+ * с изменёнными родителями (при смене родителя - и прежние родители тоже).
+ * Семья, отцепленная к корню ради разрыва цикла, обратно прицепляется только полной раскладкой.
+ */
+
+#include <vector>
+
+#include "treegraph.h"
+
+struct LayoutParams
+{
+   double cardWidth  = 160;
+   double cardHeight = 90;
+   double spouseGap  = 12;
+   double siblingGap = 24;
+   double subtreeGap = 48;
+   double levelGap   = 70;
+};
+
+class TreeLayout
+{
+public:
+   struct Move
+   {
+      int node;
+      double oldX;      // у добавленных людей - 0
+      double oldY;
+   };
+
+   TreeLayout();
+
+   void setParams(const LayoutParams &params);
+   const LayoutParams &params() const { return _params; }
+
+   void run(const TreeGraph &graph);
+   void update(const TreeGraph &graph, const std::vector<int> &changedNodes);
+
+   unsigned version() const { return _version; }
+   // Люди, чьи координаты изменил последний update(), каждый один раз; после run() - пусто
+   const std::vector<Move> &moved() const { return _moved; }
+   int size() const { return static_cast<int>(_x.size()); }
+   double x(int node) const { return _x[node]; }
+   double y(int node) const { return _y[node]; }
+   double left() const { return _left; }
+   double width() const { return _width; }
+   double height() const { return _height; }
+
+   int unitCount() const { return static_cast<int>(_unitWidth.size()); }
+   int rootUnit() const { return _root; }
+   int unitOf(int node) const { return _unitOf[node]; }
+   int unitParent(int unit) const { return _unitParent[unit]; }
+   int unitMemberCount(int unit) const { return _memberCount[unit]; }
+   int unitFirstMember(int unit) const { return _memberHead[unit]; }
+   int nextMember(int node) const { return _memberNext[node]; }
+   double unitX(int unit) const { return _unitX[unit]; }
+   int unitDepth(int unit) const { return _unitDepth[unit]; }
+
+private:
+   // Полная раскладка
+   void buildUnits(const TreeGraph &graph);
+   void buildUnitTree(const TreeGraph &graph);
+   void firstWalk();
+   void finishNode(int v);
+   int apportion(int v, int defaultAncestor);
+   void moveSubtree(int wm, int wp, double shift);
+   void executeShifts(int v);
+   void secondWalk();
+   void placeMembers();
+   void placeUnitMembers(int unit);
+   void updateBounds();
+
+   // Точечные правки
+   int wantedOwner(const TreeGraph &graph, int node) const;
+   int ownerCandidate(const TreeGraph &graph, int node) const;
+   int wantedParentUnit(const TreeGraph &graph, int unit) const;
+   int newUnit();
+   void addMember(int unit, int node);
+   void removeMember(int unit, int node);
+   void attachChild(int parent, int unit);
+   void detachChild(int unit);
+   void updateUnitWidth(int unit);
+   void invalidateContour(int unit);
+   const std::vector<double> &leftContour(int unit);
+   const std::vector<double> &rightContour(int unit);
+   void buildContour(int unit);
+   void placeChildren(int unit);
+   void moveSubtreeTo(int unit, double dx, int depthDelta);
+
+   int leftSibling(int unit) const { return _prevSibling[unit]; }
+   int leftmostSibling(int unit) const { return _firstChild[_unitParent[unit]]; }
+   int nextLeft(int unit) const { return (_firstChild[unit] >= 0) ? _firstChild[unit] : _thread[unit]; }
+   int nextRight(int unit) const { return (_lastChild[unit] >= 0) ? _lastChild[unit] : _thread[unit]; }
+   double distance(int left, int right) const;
+
+   LayoutParams _params;
+
+   // Семьи: члены и дерево семей хранятся навесными списками, чтобы их можно было править на месте
+   int _root;
+   std::vector<int> _unitOf;
+   std::vector<int> _memberHead;
+   std::vector<int> _memberNext;
+   std::vector<int> _memberCount;
+   std::vector<int> _unitParent;
+   std::vector<int> _firstChild;
+   std::vector<int> _lastChild;
+   std::vector<int> _prevSibling;
+   std::vector<int> _nextSibling;
+   std::vector<double> _unitWidth;
+   std::vector<int> _unitDepth;
+   std::vector<double> _unitX;
+   std::vector<double> _relX;       // смещение центра семьи относительно родительской
+
+   // Рабочие массивы алгоритма Бухгейма
+   std::vector<double> _prelim;
+   std::vector<double> _mod;
+   std::vector<double> _shift;
+   std::vector<double> _change;
+   std::vector<int> _thread;
+   std::vector<int> _ancestor;
+   std::vector<int> _number;
+
+   // Контуры поддеревьев относительно центра семьи, по одному значению на уровень
+   std::vector<std::vector<double>> _leftContour;
+   std::vector<std::vector<double>> _rightContour;
+   std::vector<char> _contourValid;
+
+   std::vector<double> _x;
+   std::vector<double> _y;
+   std::vector<Move> _moved;
+   std::vector<char> _movedMark;    // в update() - уже есть в _moved, вне update() - все нули
+   bool _recordMoves;
+   double _left;
+   double _width;
+   double _height;
+   unsigned _version;
+};
+
+#endif // TREELAYOUT_H
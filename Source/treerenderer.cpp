@@ -0,0 +1,269 @@
+#include "treerenderer.h"
+
+#include <limits>
+
+// Ширина карточки на экране в пикселях, с которой включается следующий уровень детализации
+#define BLOCKS_MIN_WIDTH    8.0
+#define NAMES_MIN_WIDTH     48.0
+#define FULL_MIN_WIDTH      120.0
+
+#define CARD_PADDING        6.0
+
+static const QColor MALE_COLOR(180, 205, 235);
+static const QColor FEMALE_COLOR(240, 195, 210);
+static const QColor ALIVE_FRAME(40, 120, 60);
+static const QColor DEAD_FRAME(90, 90, 90);
+static const QColor LINK_COLOR(140, 140, 140);
+static const QColor PHOTO_PLACEHOLDER(225, 225, 225);
+
+TreeRenderer::TreeRenderer()
+   : m_thumbnails(nullptr),
+     m_nameCache(TEXT_CACHE_SIZE),
+     m_detailsCache(TEXT_CACHE_SIZE),
+     m_sceneSerial(0),
+     m_linkTop(std::numeric_limits<double>::lowest()),
+     m_linkBottom(std::numeric_limits<double>::max())
+{
+   m_nameFont.setPixelSize(14);
+   m_nameFont.setBold(true);
+   m_detailsFont.setPixelSize(11);
+}
+
+DetailLevel TreeRenderer::detailFor(double scale, const LayoutParams &params)
+{
+   double cardWidth = params.cardWidth * scale;
+   if (cardWidth < BLOCKS_MIN_WIDTH)
+      return DETAIL_DOTS;
+   if (cardWidth < NAMES_MIN_WIDTH)
+      return DETAIL_BLOCKS;
+   if (cardWidth < FULL_MIN_WIDTH)
+      return DETAIL_NAMES;
+   return DETAIL_FULL;
+}
+
+bool TreeRenderer::isFemale(const Person *pers)
+{
+   return Person::sexOf(pers->sex) == SEX_FEMALE;
+}
+
+void TreeRenderer::clearCache()
+{
+   m_nameCache.clear();
+   m_detailsCache.clear();
+}
+
+void TreeRenderer::setLinkBand(double top, double bottom)
+{
+   m_linkTop = top;
+   m_linkBottom = bottom;
+}
+
+void TreeRenderer::clearLinkBand()
+{
+   setLinkBand(std::numeric_limits<double>::lowest(), std::numeric_limits<double>::max());
+}
+
+void TreeRenderer::setSceneSerial(quint64 serial)
+{
+   if (serial == m_sceneSerial)
+      return;
+   m_sceneSerial = serial;
+   clearCache();
+}
+
+void TreeRenderer::prefetchPhotos(const TreeScene &scene, const QVector<Person*> &persons,
+                                  const QRectF &world, double scale)
+{
+   const LayoutParams &params = scene.layout().params();
+   if (!m_thumbnails || (scene.size() != persons.size()) || (detailFor(scale, params) != DETAIL_FULL))
+      return;
+
+   double photoSize = params.cardHeight - 2 * CARD_PADDING;
+   scene.cardsIn(world, m_cards);
+   for (int node : m_cards)
+      m_thumbnails->thumbnail(persons[node], photoSize * scale);
+}
+
+void TreeRenderer::render(QPainter &painter, const TreeScene &scene, const QVector<Person*> &persons,
+                          const QRectF &world, double scale)
+{
+   if (scene.size() != persons.size())
+      return;
+
+   scene.cardsIn(world, m_cards);
+
+   DetailLevel level = detailFor(scale, scene.layout().params());
+   if (level != DETAIL_DOTS)
+   {
+      scene.linksIn(world, m_links);
+      drawLinks(painter, scene, scale);
+   }
+
+   switch (level)
+   {
+   case DETAIL_DOTS:
+      drawDots(painter, scene, persons, scale);
+      break;
+   case DETAIL_BLOCKS:
+      drawBlocks(painter, scene, persons, scale);
+      break;
+   case DETAIL_NAMES:
+      drawCards(painter, scene, persons, scale, false);
+      break;
+   case DETAIL_FULL:
+      drawCards(painter, scene, persons, scale, true);
+      break;
+   }
+}
+
+void TreeRenderer::drawLinks(QPainter &painter, const TreeScene &scene, double scale)
+{
+   Q_UNUSED(scale);
+
+   QPen pen(LINK_COLOR);
+   pen.setCosmetic(true);
+   painter.setPen(pen);
+
+   QVector<QLineF> lines;
+   lines.reserve(static_cast<int>(m_links.size()));
+   for (int link : m_links)
+   {
+      QLineF line = scene.linkLine(link);
+      if ((line.y1() >= m_linkTop) && (line.y1() < m_linkBottom))
+         lines.append(line);
+   }
+   painter.drawLines(lines);
+}
+
+void TreeRenderer::drawDots(QPainter &painter, const TreeScene &scene, const QVector<Person*> &persons, double scale)
+{
+   Q_UNUSED(scale);
+
+   // Четыре пачки точек: пол x жив/умер, по одному вызову отрисовки на пачку
+   QVector<QPointF> dots[4];
+   for (int node : m_cards)
+   {
+      const Person *pers = persons[node];
+      int group = (isFemale(pers) ? 2 : 0) + (pers->bIsAlive ? 0 : 1);
+      dots[group].append(QPointF(scene.layout().x(node), scene.layout().y(node)));
+   }
+
+   const QColor colors[4] = { MALE_COLOR.darker(150), DEAD_FRAME, FEMALE_COLOR.darker(150), DEAD_FRAME };
+   for (int group = 0; group < 4; group++)
+   {
+      QPen pen(colors[group], 3);
+      pen.setCosmetic(true);
+      painter.setPen(pen);
+      painter.drawPoints(dots[group].constData(), dots[group].size());
+   }
+}
+
+void TreeRenderer::drawShape(QPainter &painter, const QRectF &rect, const Person *pers)
+{
+   painter.setBrush(isFemale(pers) ? FEMALE_COLOR : MALE_COLOR);
+   if (isFemale(pers))
+      painter.drawRoundedRect(rect, rect.height() / 4, rect.height() / 4);
+   else
+      painter.drawRect(rect);
+}
+
+void TreeRenderer::drawBlocks(QPainter &painter, const TreeScene &scene, const QVector<Person*> &persons, double scale)
+{
+   Q_UNUSED(scale);
+
+   QPen alive(ALIVE_FRAME, 2), dead(DEAD_FRAME, 2);
+   alive.setCosmetic(true);
+   dead.setCosmetic(true);
+
+   for (int node : m_cards)
+   {
+      const Person *pers = persons[node];
+      painter.setPen(pers->bIsAlive ? alive : dead);
+      drawShape(painter, scene.cardRect(node), pers);
+   }
+}
+
+const QStaticText &TreeRenderer::cachedText(QCache<uint32_t, CachedText> &cache, uint32_t id,
+                                            const QString &source, double width)
+{
+   // Запись правленого человека пересчитывается на месте по смене исходной строки,
+   // давно не рисованные вытесняются самим QCache
+   CachedText *entry = cache.object(id);
+   if (!entry)
+   {
+      entry = new CachedText;
+      cache.insert(id, entry);
+   }
+   if ((entry->source != source) || (entry->text.textWidth() != width))
+   {
+      entry->source = source;
+      entry->text.setText(source);
+      entry->text.setTextFormat(Qt::PlainText);
+      entry->text.setTextWidth(width);
+      entry->text.setPerformanceHint(QStaticText::AggressiveCaching);
+   }
+   return entry->text;
+}
+
+void TreeRenderer::drawPhoto(QPainter &painter, const QRectF &rect, const Person *pers, double scale)
+{
+   QImage image;
+   if (m_thumbnails)
+      image = m_thumbnails->thumbnail(pers, rect.width() * scale);
+
+   if (image.isNull())
+   {
+      painter.setBrush(PHOTO_PLACEHOLDER);
+      painter.drawRect(rect);
+      return;
+   }
+
+   QSizeF fit = QSizeF(image.size()).scaled(rect.size(), Qt::KeepAspectRatio);
+   QRectF target(rect.center().x() - fit.width() / 2, rect.center().y() - fit.height() / 2, fit.width(), fit.height());
+   painter.drawImage(target, image);
+   painter.setBrush(Qt::NoBrush);
+   painter.drawRect(rect);
+}
+
+void TreeRenderer::drawCards(QPainter &painter, const TreeScene &scene, const QVector<Person*> &persons,
+                             double scale, bool full)
+{
+   const LayoutParams &params = scene.layout().params();
+   double photoSize = full ? params.cardHeight - 2 * CARD_PADDING : 0;
+   double textLeft = CARD_PADDING + (full ? photoSize + CARD_PADDING : 0);
+   double textWidth = params.cardWidth - textLeft - CARD_PADDING;
+
+   QPen alive(ALIVE_FRAME, 2), dead(DEAD_FRAME, 2);
+   alive.setCosmetic(true);
+   dead.setCosmetic(true);
+
+   for (int node : m_cards)
+   {
+      const Person *pers = persons[node];
+      QRectF card = scene.cardRect(node);
+
+      painter.setPen(pers->bIsAlive ? alive : dead);
+      drawShape(painter, card, pers);
+
+      painter.setPen(Qt::black);
+      painter.setFont(m_nameFont);
+      const QStaticText &name = cachedText(m_nameCache, pers->id, pers->name, textWidth);
+      painter.drawStaticText(QPointF(card.left() + textLeft, card.top() + CARD_PADDING), name);
+
+      if (!full)
+         continue;
+
+      QRectF photo(card.left() + CARD_PADDING, card.top() + CARD_PADDING, photoSize, photoSize);
+      drawPhoto(painter, photo, pers, scale);
+
+      QString details = pers->birthDate.toString("dd.MM.yyyy");
+      if (!pers->bIsAlive)
+         details += " - " + pers->deathDate.toString("dd.MM.yyyy");
+      if (!pers->birthPlace.isEmpty())
+         details += QChar(QChar::LineSeparator) + pers->birthPlace;
+
+      painter.setFont(m_detailsFont);
+      const QStaticText &text = cachedText(m_detailsCache, pers->id, details, textWidth);
+      painter.drawStaticText(QPointF(card.left() + textLeft, card.top() + CARD_PADDING + name.size().height()), text);
+   }
+}
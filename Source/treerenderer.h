@@ -0,0 +1,87 @@
+#ifndef TREERENDERER_H
+#define TREERENDERER_H
+
+/*
+ * Отрисовка разложенного дерева в мировых координатах с уровнями детализации:
+ * издалека - точки, затем цветные блоки (форма - пол, рамка - жив или нет),
+ * затем карточки с именем, вблизи - полные карточки с датами, местом рождения и фото.
+ * Фото берутся из ThumbnailCache, пока миниатюра не готова - рисуется заглушка.
+ * Раскладка текста имён кэшируется в QStaticText; кэш ограничен TEXT_CACHE_SIZE людьми,
+ * давно не рисованные вытесняются.
+ */
+
+#include <vector>
+
+#include <QCache>
+#include <QFont>
+#include <QStaticText>
+#include <QPainter>
+
+#include "person.h"
+#include "treescene.h"
+#include "thumbnailcache.h"
+
+#define TEXT_CACHE_SIZE 4096   // людей в каждом кэше текста одного отрисовщика
+
+enum DetailLevel
+{
+   DETAIL_DOTS,
+   DETAIL_BLOCKS,
+   DETAIL_NAMES,
+   DETAIL_FULL
+};
+
+class TreeRenderer
+{
+public:
+   TreeRenderer();
+
+   void setThumbnails(ThumbnailCache *thumbnails) { m_thumbnails = thumbnails; }
+
+   static DetailLevel detailFor(double scale, const LayoutParams &params);
+   static bool isFemale(const Person *pers);
+
+   // painter уже переведён в мировые координаты с масштабом scale
+   void render(QPainter &painter, const TreeScene &scene, const QVector<Person*> &persons,
+               const QRectF &world, double scale);
+   void clearCache();
+   // Рисуются только линии, начинающиеся в полосе мира [top, bottom): соседние полосы плаката
+   // не повторяют общие линии. По умолчанию полоса бесконечна
+   void setLinkBand(double top, double bottom);
+   void clearLinkBand();
+   // Номер раскладки сцены: при смене люди могли пропасть, кэш текста сбрасывается
+   void setSceneSerial(quint64 serial);
+
+   // Заказывает миниатюры, которые понадобятся render() для этой области
+   void prefetchPhotos(const TreeScene &scene, const QVector<Person*> &persons, const QRectF &world, double scale);
+
+private:
+   struct CachedText
+   {
+      QString source;
+      QStaticText text;
+   };
+
+   void drawLinks(QPainter &painter, const TreeScene &scene, double scale);
+   void drawDots(QPainter &painter, const TreeScene &scene, const QVector<Person*> &persons, double scale);
+   void drawBlocks(QPainter &painter, const TreeScene &scene, const QVector<Person*> &persons, double scale);
+   void drawCards(QPainter &painter, const TreeScene &scene, const QVector<Person*> &persons, double scale, bool full);
+   void drawShape(QPainter &painter, const QRectF &rect, const Person *pers);
+   void drawPhoto(QPainter &painter, const QRectF &rect, const Person *pers, double scale);
+   const QStaticText &cachedText(QCache<uint32_t, CachedText> &cache, uint32_t id,
+                                 const QString &source, double width);
+
+   ThumbnailCache *m_thumbnails;
+   QFont m_nameFont;
+   QFont m_detailsFont;
+   QCache<uint32_t, CachedText> m_nameCache;
+   QCache<uint32_t, CachedText> m_detailsCache;
+   quint64 m_sceneSerial;
+   double m_linkTop;
+   double m_linkBottom;
+
+   std::vector<int> m_cards;
+   std::vector<int> m_links;
+};
+
+#endif // TREERENDERER_H
@@ -0,0 +1,187 @@
+#include "treescene.h"
+
+#include <algorithm>
+#include <utility>
+
+TreeScene::TreeScene()
+{
+
+}
+
+void TreeScene::build(const QVector<Person*> &persons, const LayoutParams &params)
+{
+   build(TreeGraph::fromPersons(persons), params);
+}
+
+void TreeScene::build(TreeGraph graph, const LayoutParams &params)
+{
+   _graph = std::move(graph);
+   _layout.setParams(params);
+   _layout.run(_graph);
+   rebuildIndex();
+}
+
+QVector<QRectF> TreeScene::update(const QVector<Person*> &persons, const QVector<Person*> &changed)
+{
+   int oldSize = _layout.size();
+
+   std::vector<int> nodes;
+   for (Person *pers : changed)
+   {
+      int node = _graph.indexOf(pers->id);
+      if (node < 0)
+         node = _graph.addNode(pers->id);
+      nodes.push_back(node);
+   }
+
+   // Прежние родители тоже правятся: у них мог пропасть ребёнок
+   for (Person *pers : changed)
+   {
+      int node = _graph.indexOf(pers->id);
+      if (_graph.father[node] >= 0)
+         nodes.push_back(_graph.father[node]);
+      if (_graph.mother[node] >= 0)
+         nodes.push_back(_graph.mother[node]);
+      _graph.setParents(node, pers->father ? _graph.indexOf(pers->father->id) : -1,
+                        pers->mother ? _graph.indexOf(pers->mother->id) : -1);
+   }
+   _graph.finalize();
+
+   Q_ASSERT(_graph.size() == persons.size());
+   _layout.update(_graph, nodes);
+
+   // Раскладки ещё не было - update() сделал полную
+   if (!oldSize)
+   {
+      rebuildIndex();
+      return QVector<QRectF>() << bounds();
+   }
+
+   // Изменённые карточки перерисовываются всегда, остальные - если сдвинулись
+   QVector<QRectF> dirty;
+   const LayoutParams &params = _layout.params();
+   std::vector<SpatialBox> boxes;
+   for (int node : nodes)
+      dirty.append(cardRect(node));
+   for (int i = oldSize; i < _layout.size(); i++)
+   {
+      boxes.push_back(cardBox(i));
+      dirty.append(cardRect(i));
+   }
+   for (const TreeLayout::Move &move : _layout.moved())
+   {
+      if (move.node >= oldSize)
+         continue;
+      boxes.push_back(cardBox(move.node));
+      dirty.append(QRectF(move.oldX - params.cardWidth / 2, move.oldY - params.cardHeight / 2,
+                          params.cardWidth, params.cardHeight));
+      dirty.append(cardRect(move.node));
+   }
+   _cardIndex.update(boxes);
+
+   // Перекладываются только группы, где кто-то сдвинулся
+   _router.route(_graph, _layout);
+   boxes.clear();
+   for (int group : _router.changedGroups())
+   {
+      SpatialBox box;
+      if (groupBox(group, box))
+         boxes.push_back(box);
+      else
+         _linkIndex.remove(group);
+   }
+   _linkIndex.update(boxes);
+
+   for (const ConnectorSegment &box : _router.dirtyBoxes())
+      dirty.append(QRectF(QPointF(box.x1, box.y1), QPointF(box.x2, box.y2)));
+   return dirty;
+}
+
+QRectF TreeScene::bounds() const
+{
+   return QRectF(_layout.left(), 0, _layout.width(), _layout.height());
+}
+
+QRectF TreeScene::cardRect(int node) const
+{
+   const LayoutParams &params = _layout.params();
+   return QRectF(_layout.x(node) - params.cardWidth / 2, _layout.y(node) - params.cardHeight / 2,
+                 params.cardWidth, params.cardHeight);
+}
+
+QLineF TreeScene::linkLine(int link) const
+{
+   const ConnectorSegment &seg = _router.segment(link);
+   return QLineF(seg.x1, seg.y1, seg.x2, seg.y2);
+}
+
+SpatialBox TreeScene::cardBox(int node) const
+{
+   QRectF r = cardRect(node);
+   return { r.left(), r.top(), r.right(), r.bottom(), node };
+}
+
+bool TreeScene::groupBox(int group, SpatialBox &box) const
+{
+   int first = _router.groupFirstSegment(group);
+   int count = _router.groupSegmentCount(group);
+   if (!count)
+      return false;
+
+   const ConnectorSegment &seg = _router.segment(first);
+   box = { std::min(seg.x1, seg.x2), std::min(seg.y1, seg.y2), std::max(seg.x1, seg.x2), std::max(seg.y1, seg.y2), group };
+   for (int i = first + 1; i < first + count; i++)
+   {
+      const ConnectorSegment &s = _router.segment(i);
+      box.x1 = std::min(box.x1, std::min(s.x1, s.x2));
+      box.y1 = std::min(box.y1, std::min(s.y1, s.y2));
+      box.x2 = std::max(box.x2, std::max(s.x1, s.x2));
+      box.y2 = std::max(box.y2, std::max(s.y1, s.y2));
+   }
+   return true;
+}
+
+void TreeScene::rebuildIndex()
+{
+   std::vector<SpatialBox> cards(_layout.size());
+   for (int i = 0; i < _layout.size(); i++)
+      cards[i] = cardBox(i);
+   _cardIndex.build(std::move(cards));
+
+   _router.route(_graph, _layout);
+
+   std::vector<SpatialBox> groups;
+   groups.reserve(_router.groupCount());
+   for (int g = 0; g < _router.groupCount(); g++)
+   {
+      SpatialBox box;
+      if (groupBox(g, box))
+         groups.push_back(box);
+   }
+   _linkIndex.build(std::move(groups));
+}
+
+void TreeScene::cardsIn(const QRectF &rect, std::vector<int> &nodes) const
+{
+   _cardIndex.query(rect.left(), rect.top(), rect.right(), rect.bottom(), nodes);
+}
+
+void TreeScene::linksIn(const QRectF &rect, std::vector<int> &links) const
+{
+   // Индекс отдаёт группы, отрезки внутри группы отбираются перебором - их единицы
+   std::vector<int> groups;
+   _linkIndex.query(rect.left(), rect.top(), rect.right(), rect.bottom(), groups);
+
+   links.clear();
+   for (int group : groups)
+   {
+      int first = _router.groupFirstSegment(group);
+      for (int i = first; i < first + _router.groupSegmentCount(group); i++)
+      {
+         const ConnectorSegment &seg = _router.segment(i);
+         if ((std::max(seg.x1, seg.x2) >= rect.left()) && (std::min(seg.x1, seg.x2) <= rect.right())
+               && (std::max(seg.y1, seg.y2) >= rect.top()) && (std::min(seg.y1, seg.y2) <= rect.bottom()))
+            links.push_back(i);
+      }
+   }
+}
@@ -0,0 +1,59 @@
+#ifndef TREESCENE_H
+#define TREESCENE_H
+
+/*
+ * Разложенное дерево вместе с прямоугольными линиями связи и пространственными индексами
+ * карточек и групп линий.
+ * Строится целиком (в рабочем потоке - из готового TreeGraph) либо обновляется точечно после правки: в индексах
+ * переставляются только сдвинутые карточки и переложенные группы линий.
+ */
+
+#include <vector>
+
+#include <QVector>
+#include <QRectF>
+#include <QLineF>
+
+#include "person.h"
+#include "treegraph.h"
+#include "treelayout.h"
+#include "spatialindex.h"
+#include "connectorrouter.h"
+
+class TreeScene
+{
+public:
+   TreeScene();
+
+   void build(const QVector<Person*> &persons, const LayoutParams &params);
+   // Для рабочего потока: граф собран заранее, людей сцена не читает
+   void build(TreeGraph graph, const LayoutParams &params);
+   // Возвращает области мира, где картинка могла измениться (старые и новые места карточек и линий)
+   QVector<QRectF> update(const QVector<Person*> &persons, const QVector<Person*> &changed);
+
+   const TreeGraph &graph() const { return _graph; }
+   const TreeLayout &layout() const { return _layout; }
+   int size() const { return _layout.size(); }
+
+   QRectF bounds() const;
+   QRectF cardRect(int node) const;
+   QLineF linkLine(int link) const;
+   const ConnectorRouter &router() const { return _router; }
+
+   void cardsIn(const QRectF &rect, std::vector<int> &nodes) const;
+   void linksIn(const QRectF &rect, std::vector<int> &links) const;
+
+private:
+   void rebuildIndex();
+   SpatialBox cardBox(int node) const;
+   // false - у группы нет линий
+   bool groupBox(int group, SpatialBox &box) const;
+
+   TreeGraph _graph;
+   TreeLayout _layout;
+   ConnectorRouter _router;
+   SpatialIndex _cardIndex;
+   SpatialIndex _linkIndex;      // по группам ConnectorRouter
+};
+
+#endif // TREESCENE_H
@@ -0,0 +1,373 @@
+#include "treesnapshot.h"
+
+#include <cstring>
+#include <unordered_map>
+
+#include <QSaveFile>
+
+#include "writelog.h"
+
+#define SNAPSHOT_BYTE_ORDER     0x01020304u
+#define SNAPSHOT_WRITE_BUFFER   (1 << 20)
+
+#define FLAG_ALIVE              0x1
+
+static const char SNAPSHOT_MAGIC[8] = { 'F', 'T', 'S', 'N', 'A', 'P', '\r', '\n' };
+
+static uint64_t align8(uint64_t value)
+{
+   return (value + 7) & ~uint64_t(7);
+}
+
+/*
+ * Запись секций подряд через буфер в 1 МБ: на каждое поле отдельный вызов QFile не нужен
+ */
+class SnapshotStream
+{
+public:
+   explicit SnapshotStream(QSaveFile &file)
+      : m_file(file),
+      m_pos(0),
+      m_ok(true)
+   {
+      m_buffer.reserve(SNAPSHOT_WRITE_BUFFER);
+   }
+
+   void put(const void *data, qint64 size)
+   {
+      m_pos += size;
+      if (m_buffer.size() + size > SNAPSHOT_WRITE_BUFFER)
+      {
+         flush();
+         if (size > SNAPSHOT_WRITE_BUFFER)
+         {
+            m_ok = m_ok && (m_file.write(static_cast<const char*>(data), size) == size);
+            return;
+         }
+      }
+      m_buffer.append(static_cast<const char*>(data), static_cast<int>(size));
+   }
+
+   // Дополняет нулями до смещения, где начинается следующая секция
+   void padTo(uint64_t offset)
+   {
+      static const char zeros[8] = { 0 };
+      if (offset > m_pos)
+         put(zeros, offset - m_pos);
+   }
+
+   bool flush()
+   {
+      if (!m_buffer.isEmpty())
+         m_ok = m_ok && (m_file.write(m_buffer) == m_buffer.size());
+      m_buffer.clear();
+      return m_ok;
+   }
+
+private:
+   QSaveFile &m_file;
+   QByteArray m_buffer;
+   uint64_t m_pos;
+   bool m_ok;
+};
+
+TreeSnapshot::TreeSnapshot()
+   : _data(nullptr),
+   _header(nullptr),
+   _records(nullptr),
+   _childStart(nullptr),
+   _childList(nullptr),
+   _strings(nullptr),
+   _photos(nullptr)
+{
+
+}
+
+TreeSnapshot::~TreeSnapshot()
+{
+   close();
+}
+
+int TreeSnapshot::write(const QString &fileName, const QVector<Person*> &persons)
+{
+   static_assert(sizeof(SnapshotRecord) == 72, "SnapshotRecord layout changed");
+   static_assert(sizeof(SnapshotHeader) == 88, "SnapshotHeader layout changed");
+
+   uint32_t count = static_cast<uint32_t>(persons.size());
+   std::unordered_map<const Person*, int32_t> index;
+   index.reserve(count);
+   for (uint32_t i = 0; i < count; i++)
+      index[persons[i]] = static_cast<int32_t>(i);
+
+   auto indexOf = [&index](const Person *pers) -> int32_t
+   {
+      if (!pers)
+         return -1;
+      auto it = index.find(pers);
+      return (it != index.end()) ? it->second : -1;
+   };
+
+   // Размеры секций известны заранее, поэтому файл пишется одним проходом по секциям
+   SnapshotHeader header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+   header.version = SNAPSHOT_VERSION;
+   header.byteOrder = SNAPSHOT_BYTE_ORDER;
+   header.personCount = count;
+   for (const Person *pers : persons)
+   {
+      for (const Person *child : pers->children)
+         if (indexOf(child) >= 0)
+            header.childCount++;
+      header.stringsSize += pers->name.size() + pers->info.size() + pers->birthPlace.size() + pers->sex.size();
+      header.photosSize += pers->photoData.size();
+   }
+   if (header.stringsSize > UINT32_MAX)
+   {
+      writeDebugLog("TreeSnapshot::write String table is too large");
+      return -1;
+   }
+
+   header.recordsOffset = align8(sizeof(SnapshotHeader));
+   header.childStartOffset = align8(header.recordsOffset + uint64_t(count) * sizeof(SnapshotRecord));
+   header.childListOffset = align8(header.childStartOffset + (uint64_t(count) + 1) * sizeof(uint32_t));
+   header.stringsOffset = align8(header.childListOffset + uint64_t(header.childCount) * sizeof(uint32_t));
+   header.photosOffset = align8(header.stringsOffset + header.stringsSize * sizeof(ushort));
+   header.fileSize = header.photosOffset + header.photosSize;
+
+   QSaveFile file(fileName);
+   if (!file.open(QIODevice::WriteOnly))
+   {
+      writeDebugLog("TreeSnapshot::write Could not open " + fileName);
+      return -1;
+   }
+
+   SnapshotStream out(file);
+   out.put(&header, sizeof(header));
+
+   out.padTo(header.recordsOffset);
+   uint32_t stringPos = 0;
+   uint64_t photoPos = 0;
+   auto addString = [&stringPos](const QString &str) -> SnapshotString
+   {
+      SnapshotString ref = { stringPos, static_cast<uint32_t>(str.size()) };
+      stringPos += ref.length;
+      return ref;
+   };
+   for (const Person *pers : persons)
+   {
+      SnapshotRecord rec;
+      memset(&rec, 0, sizeof(rec));
+      rec.id = pers->id;
+      rec.father = indexOf(pers->father);
+      rec.mother = indexOf(pers->mother);
+      rec.flags = pers->bIsAlive ? FLAG_ALIVE : 0;
+      rec.birthDay = pers->birthDate.isValid() ? static_cast<int32_t>(pers->birthDate.toJulianDay()) : SNAPSHOT_NO_DATE;
+      rec.deathDay = pers->deathDate.isValid() ? static_cast<int32_t>(pers->deathDate.toJulianDay()) : SNAPSHOT_NO_DATE;
+      rec.name = addString(pers->name);
+      rec.info = addString(pers->info);
+      rec.birthPlace = addString(pers->birthPlace);
+      rec.sex = addString(pers->sex);
+      rec.photoOffset = photoPos;
+      rec.photoSize = static_cast<uint32_t>(pers->photoData.size());
+      photoPos += rec.photoSize;
+      out.put(&rec, sizeof(rec));
+   }
+
+   out.padTo(header.childStartOffset);
+   uint32_t start = 0;
+   out.put(&start, sizeof(start));
+   for (const Person *pers : persons)
+   {
+      for (const Person *child : pers->children)
+         if (indexOf(child) >= 0)
+            start++;
+      out.put(&start, sizeof(start));
+   }
+
+   out.padTo(header.childListOffset);
+   for (const Person *pers : persons)
+   {
+      for (const Person *child : pers->children)
+      {
+         int32_t num = indexOf(child);
+         if (num >= 0)
+            out.put(&num, sizeof(num));
+      }
+   }
+
+   out.padTo(header.stringsOffset);
+   for (const Person *pers : persons)
+   {
+      for (const QString *str : { &pers->name, &pers->info, &pers->birthPlace, &pers->sex })
+         out.put(str->utf16(), str->size() * sizeof(ushort));
+   }
+
+   out.padTo(header.photosOffset);
+   for (const Person *pers : persons)
+      out.put(pers->photoData.constData(), pers->photoData.size());
+
+   if (!out.flush() || !file.commit())
+   {
+      writeDebugLog("TreeSnapshot::write Write failed: " + file.errorString());
+      return -1;
+   }
+   return 0;
+}
+
+int TreeSnapshot::open(const QString &fileName)
+{
+   close();
+
+   _file.setFileName(fileName);
+   if (!_file.open(QIODevice::ReadOnly))
+   {
+      writeDebugLog("TreeSnapshot::open Could not open " + fileName);
+      return -1;
+   }
+
+   qint64 fileSize = _file.size();
+   if (fileSize >= static_cast<qint64>(sizeof(SnapshotHeader)))
+      _data = _file.map(0, fileSize);
+   if (!_data || !validate(fileSize))
+   {
+      writeDebugLog("TreeSnapshot::open Not a valid snapshot: " + fileName);
+      close();
+      return -1;
+   }
+
+   // Дальше никакого разбора: указатели на секции прямо в отображённом файле
+   _header = reinterpret_cast<const SnapshotHeader*>(_data);
+   _records = reinterpret_cast<const SnapshotRecord*>(_data + _header->recordsOffset);
+   _childStart = reinterpret_cast<const uint32_t*>(_data + _header->childStartOffset);
+   _childList = reinterpret_cast<const uint32_t*>(_data + _header->childListOffset);
+   _strings = reinterpret_cast<const ushort*>(_data + _header->stringsOffset);
+   _photos = reinterpret_cast<const char*>(_data + _header->photosOffset);
+   return 0;
+}
+
+bool TreeSnapshot::validate(qint64 fileSize) const
+{
+   const SnapshotHeader *header = reinterpret_cast<const SnapshotHeader*>(_data);
+   if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) || (header->version != SNAPSHOT_VERSION)
+         || (header->byteOrder != SNAPSHOT_BYTE_ORDER) || (header->fileSize != uint64_t(fileSize)))
+      return false;
+
+   // Секции идут по порядку, выровнены и не вылезают за следующую
+   uint64_t n = header->personCount;
+   const uint64_t ends[][2] = {
+      { header->recordsOffset, header->recordsOffset + n * sizeof(SnapshotRecord) },
+      { header->childStartOffset, header->childStartOffset + (n + 1) * sizeof(uint32_t) },
+      { header->childListOffset, header->childListOffset + uint64_t(header->childCount) * sizeof(uint32_t) },
+      { header->stringsOffset, header->stringsOffset + header->stringsSize * sizeof(ushort) },
+      { header->photosOffset, header->photosOffset + header->photosSize }
+   };
+   uint64_t prev = sizeof(SnapshotHeader);
+   for (const auto &section : ends)
+   {
+      if ((section[0] % 8) || (section[0] < prev) || (section[1] < section[0]) || (section[1] > header->fileSize))
+         return false;
+      prev = section[1];
+   }
+
+   const uint32_t *childStart = reinterpret_cast<const uint32_t*>(_data + header->childStartOffset);
+   return (childStart[0] == 0) && (childStart[n] == header->childCount);
+}
+
+void TreeSnapshot::close()
+{
+   if (_data)
+      _file.unmap(const_cast<uchar*>(_data));
+   _file.close();
+
+   _data = nullptr;
+   _header = nullptr;
+   _records = nullptr;
+   _childStart = nullptr;
+   _childList = nullptr;
+   _strings = nullptr;
+   _photos = nullptr;
+}
+
+bool TreeSnapshot::isAlive(int num) const
+{
+   return _records[num].flags & FLAG_ALIVE;
+}
+
+QString TreeSnapshot::string(const SnapshotString &str) const
+{
+   if (uint64_t(str.offset) + str.length > _header->stringsSize)
+      return QString();
+   return QString::fromRawData(reinterpret_cast<const QChar*>(_strings + str.offset), static_cast<int>(str.length));
+}
+
+QByteArray TreeSnapshot::photo(int num) const
+{
+   const SnapshotRecord &rec = _records[num];
+   if (!rec.photoSize || (rec.photoOffset + rec.photoSize > _header->photosSize))
+      return QByteArray();
+   return QByteArray::fromRawData(_photos + rec.photoOffset, static_cast<int>(rec.photoSize));
+}
+
+int TreeSnapshot::child(int num, int k) const
+{
+   uint32_t pos = _childStart[num] + k;
+   if ((pos >= _header->childCount) || (_childList[pos] >= _header->personCount))
+      return -1;
+   return static_cast<int>(_childList[pos]);
+}
+
+TreeGraph TreeSnapshot::graph() const
+{
+   // Граф для раскладки строится по одним записям, без создания Person
+   TreeGraph graph;
+   int n = size();
+   graph.reserve(n);
+
+   auto checked = [n](int32_t num) -> int { return ((num >= 0) && (num < n)) ? num : -1; };
+   for (int i = 0; i < n; i++)
+      graph.addNode(_records[i].id, checked(_records[i].father), checked(_records[i].mother));
+   graph.finalize();
+   return graph;
+}
+
+int TreeSnapshot::loadPersons(std::vector<Person> &persons) const
+{
+   if (!isOpen())
+      return -1;
+
+   int n = size();
+   persons.clear();
+   persons.resize(n);
+
+   // Здесь строки и фото копируются: люди живут дольше отображения файла
+   auto copy = [](const QString &str) { return QString(str.constData(), str.size()); };
+   for (int i = 0; i < n; i++)
+   {
+      Person &pers = persons[i];
+      pers.id = id(i);
+      pers.name = copy(name(i));
+      pers.info = copy(info(i));
+      pers.birthPlace = copy(birthPlace(i));
+      pers.sex = copy(sex(i));
+      pers.bIsAlive = isAlive(i);
+      pers.birthDate = birthDate(i);
+      pers.deathDate = deathDate(i);
+      QByteArray data = photo(i);
+      pers.photoData = QByteArray(data.constData(), data.size());
+
+      int f = father(i), m = mother(i);
+      pers.father = ((f >= 0) && (f < n)) ? &persons[f] : nullptr;
+      pers.mother = ((m >= 0) && (m < n)) ? &persons[m] : nullptr;
+      for (int k = 0; k < childCount(i); k++)
+      {
+         int c = child(i, k);
+         if (c >= 0)
+            pers.children.append(&persons[c]);
+      }
+
+      if (pers.id > Person::global_id)
+         Person::global_id = pers.id;
+   }
+   return 0;
+}
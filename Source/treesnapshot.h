@@ -0,0 +1,115 @@
+#ifndef TREESNAPSHOT_H
+#define TREESNAPSHOT_H
+
+/*
+ * Двоичный снимок всего дерева для мгновенной загрузки.
+ * Файл отображается в память целиком и используется как есть, без разбора:
+ * заголовок, записи людей фиксированной длины, дети в виде CSR (индексы записей),
+ * таблица строк в UTF-16 и подряд лежащие фото. Все секции выровнены на 8 байт,
+ * числа записаны в порядке байтов машины (проверяется по заголовку).
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+#include <QDate>
+#include <QVector>
+
+#include "person.h"
+#include "treegraph.h"
+
+#define SNAPSHOT_VERSION    1
+#define SNAPSHOT_NO_DATE    INT32_MIN
+
+struct SnapshotString
+{
+   uint32_t offset;     // в символах UTF-16 от начала таблицы строк
+   uint32_t length;
+};
+
+struct SnapshotRecord
+{
+   uint32_t id;
+   int32_t father;      // индекс записи или -1
+   int32_t mother;
+   uint32_t flags;
+   int32_t birthDay;    // юлианский день или SNAPSHOT_NO_DATE
+   int32_t deathDay;
+   SnapshotString name;
+   SnapshotString info;
+   SnapshotString birthPlace;
+   SnapshotString sex;
+   uint64_t photoOffset;
+   uint32_t photoSize;
+   uint32_t reserved;
+};
+
+struct SnapshotHeader
+{
+   char magic[8];
+   uint32_t version;
+   uint32_t byteOrder;
+   uint32_t personCount;
+   uint32_t childCount;
+   uint64_t recordsOffset;
+   uint64_t childStartOffset;
+   uint64_t childListOffset;
+   uint64_t stringsOffset;
+   uint64_t stringsSize;   // в символах UTF-16
+   uint64_t photosOffset;
+   uint64_t photosSize;
+   uint64_t fileSize;
+};
+
+class TreeSnapshot
+{
+public:
+   TreeSnapshot();
+   ~TreeSnapshot();
+
+   static int write(const QString &fileName, const QVector<Person*> &persons);
+
+   int open(const QString &fileName);
+   void close();
+   bool isOpen() const { return _header != nullptr; }
+
+   int size() const { return _header ? static_cast<int>(_header->personCount) : 0; }
+   uint32_t id(int num) const { return _records[num].id; }
+   int father(int num) const { return _records[num].father; }
+   int mother(int num) const { return _records[num].mother; }
+   bool isAlive(int num) const;
+   QDate birthDate(int num) const { return date(_records[num].birthDay); }
+   QDate deathDate(int num) const { return date(_records[num].deathDay); }
+
+   // Строки и фото указывают прямо в отображённый файл и действительны, пока снимок открыт
+   QString name(int num) const { return string(_records[num].name); }
+   QString info(int num) const { return string(_records[num].info); }
+   QString birthPlace(int num) const { return string(_records[num].birthPlace); }
+   QString sex(int num) const { return string(_records[num].sex); }
+   QByteArray photo(int num) const;
+
+   int childCount(int num) const { return static_cast<int>(_childStart[num + 1] - _childStart[num]); }
+   int child(int num, int k) const;
+
+   TreeGraph graph() const;
+   int loadPersons(std::vector<Person> &persons) const;
+
+private:
+   static QDate date(int32_t day) { return (day == SNAPSHOT_NO_DATE) ? QDate() : QDate::fromJulianDay(day); }
+   QString string(const SnapshotString &str) const;
+   bool validate(qint64 fileSize) const;
+
+   QFile _file;
+   const uchar *_data;
+   const SnapshotHeader *_header;
+   const SnapshotRecord *_records;
+   const uint32_t *_childStart;
+   const uint32_t *_childList;
+   const ushort *_strings;
+   const char *_photos;
+};
+
+#endif // TREESNAPSHOT_H
@@ -0,0 +1,308 @@
+#include "treestatistics.h"
+
+#include <algorithm>
+
+#include <QHash>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
+
+#ifdef DATABASE
+#include "db.h"
+#endif
+#include "writelog.h"
+
+// Корзины считаются по индексам; все ядра - простые циклы без ветвлений
+
+static void lifespanBins(const PersonColumns &c, size_t begin, size_t end, int, int step, int bins, int32_t *out)
+{
+   const int32_t *by = c.birthYear.data(), *bmd = c.birthMonthDay.data();
+   const int32_t *dy = c.deathYear.data(), *dmd = c.deathMonthDay.data();
+   for (size_t i = begin; i < end; i++)
+   {
+      int32_t age = dy[i] - by[i] - static_cast<int32_t>(dmd[i] < bmd[i]);
+      int32_t bin = std::min(age, STATISTICS_MAX_AGE) / step;
+      bool known = (by[i] > 0) & (dy[i] > 0) & (age >= 0);
+      out[i - begin] = known ? bin : bins;
+   }
+}
+
+static void birthBins(const PersonColumns &c, size_t begin, size_t end, int first, int step, int bins, int32_t *out)
+{
+   const int32_t *by = c.birthYear.data();
+   for (size_t i = begin; i < end; i++)
+   {
+      int32_t bin = (by[i] - first) / step;
+      out[i - begin] = (by[i] > 0) ? bin : bins;
+   }
+}
+
+static void familyBins(const PersonColumns &c, size_t begin, size_t end, int, int, int bins, int32_t *out)
+{
+   const int32_t *children = c.children.data();
+   for (size_t i = begin; i < end; i++)
+      out[i - begin] = std::min(children[i], bins - 1);
+}
+
+static void placeBins(const PersonColumns &c, size_t begin, size_t end, int, int, int bins, int32_t *out)
+{
+   const int32_t *place = c.place.data();
+   for (size_t i = begin; i < end; i++)
+      out[i - begin] = (place[i] >= 0) ? place[i] : bins;
+}
+
+static void sexBins(const PersonColumns &c, size_t begin, size_t end, int, int, int, int32_t *out)
+{
+   const int8_t *sex = c.sex.data();
+   for (size_t i = begin; i < end; i++)
+      out[i - begin] = sex[i];
+}
+
+TreeStatistics::TreeStatistics()
+   : _generation(0), _loaded(false), _threads(0), _minBirthYear(0), _maxBirthYear(0), _maxChildren(0)
+{
+
+}
+
+void TreeStatistics::clear()
+{
+   _columns.clear();
+   _histograms.clear();
+   _topPlaces.clear();
+   _loaded = false;
+   _source.clear();
+   _generation = 0;
+}
+
+void TreeStatistics::invalidate(const std::string &source, uint64_t generation)
+{
+   _histograms.clear();
+   _topPlaces.clear();
+   _source = source;
+   _generation = generation;
+   _loaded = true;
+
+   _minBirthYear = _maxBirthYear = _maxChildren = 0;
+   for (size_t i = 0; i < _columns.size(); i++)
+   {
+      int year = _columns.birthYear[i];
+      if (year > 0)
+      {
+         _minBirthYear = _minBirthYear ? std::min(_minBirthYear, year) : year;
+         _maxBirthYear = std::max(_maxBirthYear, year);
+      }
+      _maxChildren = std::max(_maxChildren, static_cast<int>(_columns.children[i]));
+   }
+}
+
+void TreeStatistics::load(const QVector<Person*> &persons, uint64_t generation)
+{
+   // Другой список людей - другие данные массива QVector (он делится неявно, копия даёт тот же адрес)
+   std::string source = "persons:" + std::to_string(reinterpret_cast<uintptr_t>(persons.constData()))
+                        + ':' + std::to_string(persons.size());
+   if (isCurrent(source, generation))
+      return;
+
+   _columns.clear();
+   _columns.reserve(static_cast<size_t>(persons.size()));
+   QHash<QString, int> placeIndex;
+   for (const Person *pers : persons)
+   {
+      bool born = pers->birthDate.isValid();
+      bool died = !pers->bIsAlive && pers->deathDate.isValid();
+      _columns.birthYear.push_back(born ? pers->birthDate.year() : 0);
+      _columns.birthMonthDay.push_back(born ? pers->birthDate.month() * 100 + pers->birthDate.day() : 0);
+      _columns.deathYear.push_back(died ? pers->deathDate.year() : 0);
+      _columns.deathMonthDay.push_back(died ? pers->deathDate.month() * 100 + pers->deathDate.day() : 0);
+      _columns.sex.push_back(Person::sexOf(pers->sex));
+      _columns.children.push_back(pers->children.size());
+
+      QString place = pers->birthPlace.trimmed();
+      int index = -1;
+      if (!place.isEmpty())
+      {
+         auto it = placeIndex.find(place);
+         if (it == placeIndex.end())
+         {
+            it = placeIndex.insert(place, static_cast<int>(_columns.places.size()));
+            _columns.places.push_back(place);
+         }
+         index = it.value();
+      }
+      _columns.place.push_back(index);
+   }
+   invalidate(source, generation);
+}
+
+#ifdef DATABASE
+int TreeStatistics::load(DB &db, const std::string &tableName, uint64_t generation)
+{
+   std::string source = db.dbPath() + '\x1f' + tableName;
+   if (isCurrent(source, generation))
+      return 0;
+
+   int ret = db.getPersonColumns(tableName, _columns);
+   if (ret)
+   {
+      writeDebugLog(QString("TreeStatistics::load Failed to read ") + tableName.c_str());
+      clear();
+      return ret;
+   }
+   invalidate(source, generation);
+   return 0;
+}
+#endif
+
+std::vector<int64_t> TreeStatistics::count(BinKernel kernel, int first, int step, int bins) const
+{
+   // Куски по STATISTICS_CHUNK строк в пуле, у каждого свои счётчики; последний - "не учтено"
+   size_t rows = _columns.size();
+   size_t chunks = (rows + STATISTICS_CHUNK - 1) / STATISTICS_CHUNK;
+   std::vector<std::vector<int64_t>> partial(std::max<size_t>(chunks, 1), std::vector<int64_t>(bins + 1, 0));
+
+   auto countChunk = [this, kernel, first, step, bins, rows, &partial](size_t chunk)
+   {
+      int32_t bin[STATISTICS_BLOCK];
+      std::vector<int64_t> &counts = partial[chunk];
+      size_t last = std::min(rows, (chunk + 1) * STATISTICS_CHUNK);
+      for (size_t begin = chunk * STATISTICS_CHUNK; begin < last; begin += STATISTICS_BLOCK)
+      {
+         size_t end = std::min(last, begin + STATISTICS_BLOCK);
+         kernel(_columns, begin, end, first, step, bins, bin);
+         for (size_t i = 0; i < end - begin; i++)
+            counts[bin[i]]++;
+      }
+   };
+
+   int threads = (_threads > 0) ? _threads : QThread::idealThreadCount();
+   if ((threads <= 1) || (chunks <= 1))
+   {
+      for (size_t chunk = 0; chunk < chunks; chunk++)
+         countChunk(chunk);
+   }
+   else
+   {
+      QThreadPool pool;
+      pool.setMaxThreadCount(threads);
+      std::vector<QFuture<void>> futures;
+      for (size_t chunk = 0; chunk < chunks; chunk++)
+         futures.push_back(QtConcurrent::run(&pool, countChunk, chunk));
+      for (QFuture<void> &future : futures)
+         future.waitForFinished();
+   }
+
+   std::vector<int64_t> total(bins + 1, 0);
+   for (const std::vector<int64_t> &counts : partial)
+      for (int i = 0; i <= bins; i++)
+         total[i] += counts[i];
+   return total;
+}
+
+TreeStatistics::Histogram TreeStatistics::lifespans(int bucketYears)
+{
+   bucketYears = std::max(1, bucketYears);
+   auto it = _histograms.find(std::make_pair(static_cast<int>(REPORT_LIFESPANS), bucketYears));
+   if (it != _histograms.end())
+      return it->second;
+
+   int bins = STATISTICS_MAX_AGE / bucketYears + 1;
+   std::vector<int64_t> counts = count(lifespanBins, 0, bucketYears, bins);
+   Histogram hist;
+   hist.first = 0;
+   hist.step = bucketYears;
+   hist.unknown = counts[bins];
+   counts.pop_back();
+   hist.counts = std::move(counts);
+   return _histograms[std::make_pair(static_cast<int>(REPORT_LIFESPANS), bucketYears)] = hist;
+}
+
+TreeStatistics::Histogram TreeStatistics::births(int bucketYears)
+{
+   bucketYears = std::max(1, bucketYears);
+   auto it = _histograms.find(std::make_pair(static_cast<int>(REPORT_BIRTHS), bucketYears));
+   if (it != _histograms.end())
+      return it->second;
+
+   Histogram hist;
+   hist.step = bucketYears;
+   hist.first = (_minBirthYear / bucketYears) * bucketYears;
+   int bins = _maxBirthYear ? (_maxBirthYear - hist.first) / bucketYears + 1 : 0;
+   std::vector<int64_t> counts = count(birthBins, hist.first, bucketYears, bins);
+   hist.unknown = counts[bins];
+   counts.pop_back();
+   hist.counts = std::move(counts);
+   return _histograms[std::make_pair(static_cast<int>(REPORT_BIRTHS), bucketYears)] = hist;
+}
+
+TreeStatistics::Histogram TreeStatistics::familySizes()
+{
+   auto it = _histograms.find(std::make_pair(static_cast<int>(REPORT_FAMILY_SIZES), 0));
+   if (it != _histograms.end())
+      return it->second;
+
+   int bins = _maxChildren + 1;
+   std::vector<int64_t> counts = count(familyBins, 0, 1, bins);
+   Histogram hist;
+   hist.first = 0;
+   hist.step = 1;
+   hist.unknown = 0;
+   counts.pop_back();
+   hist.counts = std::move(counts);
+   return _histograms[std::make_pair(static_cast<int>(REPORT_FAMILY_SIZES), 0)] = hist;
+}
+
+std::vector<TreeStatistics::PlaceCount> TreeStatistics::topBirthPlaces(int limit)
+{
+   limit = std::max(0, limit);
+   auto cached = _topPlaces.find(limit);
+   if (cached != _topPlaces.end())
+      return cached->second;
+
+   // Счётчики всех мест считаются один раз, разные limit только выбирают из них
+   auto it = _histograms.find(std::make_pair(static_cast<int>(REPORT_PLACES), 0));
+   if (it == _histograms.end())
+   {
+      int bins = static_cast<int>(_columns.places.size());
+      std::vector<int64_t> counts = count(placeBins, 0, 1, bins);
+      Histogram hist;
+      hist.first = 0;
+      hist.step = 1;
+      hist.unknown = counts[bins];
+      counts.pop_back();
+      hist.counts = std::move(counts);
+      it = _histograms.emplace(std::make_pair(static_cast<int>(REPORT_PLACES), 0), std::move(hist)).first;
+   }
+   const std::vector<int64_t> &counts = it->second.counts;
+
+   std::vector<int> order(counts.size());
+   for (size_t i = 0; i < order.size(); i++)
+      order[i] = static_cast<int>(i);
+   size_t top = std::min(order.size(), static_cast<size_t>(limit));
+   std::partial_sort(order.begin(), order.begin() + top, order.end(), [&counts](int a, int b)
+   {
+      return (counts[a] != counts[b]) ? (counts[a] > counts[b]) : (a < b);
+   });
+
+   std::vector<PlaceCount> result;
+   result.reserve(top);
+   for (size_t i = 0; i < top; i++)
+      result.push_back(PlaceCount{ _columns.places[order[i]], counts[order[i]] });
+   return _topPlaces[limit] = result;
+}
+
+std::vector<int64_t> TreeStatistics::sexCounts()
+{
+   auto it = _histograms.find(std::make_pair(static_cast<int>(REPORT_SEX), 0));
+   if (it != _histograms.end())
+      return it->second.counts;
+
+   std::vector<int64_t> counts = count(sexBins, 0, 1, SEX_COUNT);
+   counts.pop_back();
+   Histogram hist;
+   hist.first = 0;
+   hist.step = 1;
+   hist.unknown = counts[SEX_UNKNOWN];
+   hist.counts = counts;
+   _histograms[std::make_pair(static_cast<int>(REPORT_SEX), 0)] = hist;
+   return counts;
+}
@@ -0,0 +1,109 @@
+#ifndef TREESTATISTICS_H
+#define TREESTATISTICS_H
+
+/*
+ * Демографическая статистика дерева: продолжительность жизни, рождения по десятилетиям,
+ * частые места рождения, размеры семей, пол.
+ * Нужные поля один раз раскладываются по плотным массивам (PersonColumns из person.h): даты - числами,
+ * место - индексом в словаре мест, пол и число детей - маленькими целыми. Дальше отчёты
+ * считаются по массивам, а не по объектам Person: строки делятся на куски по STATISTICS_CHUNK
+ * и считаются в пуле потоков, внутри куска по STATISTICS_BLOCK строк - сначала номера корзин
+ * одним циклом без ветвлений (его компилятор векторизует), затем счётчики корзин.
+ * Готовые результаты хранятся, пока не сменятся источник (таблица или список людей) и номер
+ * версии дерева (ChangeTracker::generation): у разных деревьев номера версий начинаются одинаково.
+ * Не потокобезопасен: вызывается из одного потока.
+ */
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <QString>
+#include <QVector>
+
+#include "person.h"
+
+#define STATISTICS_CHUNK     65536   // строк на задачу пула
+#define STATISTICS_BLOCK     1024    // строк на проход цикла корзин
+#define STATISTICS_MAX_AGE   120     // старше - в последнюю корзину
+
+class DB;
+
+class TreeStatistics
+{
+public:
+   // counts[i] - значения от first + i * step до first + (i + 1) * step - 1
+   struct Histogram
+   {
+      int first;
+      int step;
+      std::vector<int64_t> counts;
+      int64_t unknown;   // без нужных данных
+   };
+
+   struct PlaceCount
+   {
+      QString place;
+      int64_t count;
+   };
+
+   TreeStatistics();
+
+   // С тем же источником и generation, что у загруженных данных, ничего не перечитывается
+   void load(const QVector<Person*> &persons, uint64_t generation);
+#ifdef DATABASE
+   int load(DB &db, const std::string &tableName, uint64_t generation);
+#endif
+   void clear();
+   bool isLoaded() const { return _loaded; }
+   int size() const { return static_cast<int>(_columns.size()); }
+   // 0 - по числу ядер
+   void setThreads(int threads) { _threads = threads; }
+
+   // Полных лет у умерших с известными датами
+   Histogram lifespans(int bucketYears = 5);
+   Histogram births(int bucketYears = 10);
+   // Корзина - число детей
+   Histogram familySizes();
+   // По убыванию числа рождений
+   std::vector<PlaceCount> topBirthPlaces(int limit = 10);
+   // По PersonSex
+   std::vector<int64_t> sexCounts();
+
+private:
+   enum Report
+   {
+      REPORT_LIFESPANS,
+      REPORT_BIRTHS,
+      REPORT_FAMILY_SIZES,
+      REPORT_PLACES,
+      REPORT_SEX
+   };
+
+   // Номера корзин строк [begin, end) в out; bins (число корзин) - строка не учитывается
+   typedef void (*BinKernel)(const PersonColumns &columns, size_t begin, size_t end, int first, int step, int bins,
+                             int32_t *out);
+   // Счётчики корзин и последним - число неучтённых строк
+   std::vector<int64_t> count(BinKernel kernel, int first, int step, int bins) const;
+   bool isCurrent(const std::string &source, uint64_t generation) const
+   {
+      return _loaded && (_generation == generation) && (_source == source);
+   }
+   void invalidate(const std::string &source, uint64_t generation);
+
+   PersonColumns _columns;
+   std::string _source;     // база и таблица либо адрес списка людей
+   uint64_t _generation;
+   bool _loaded;
+   int _threads;
+   int _minBirthYear;
+   int _maxBirthYear;
+   int _maxChildren;
+
+   std::map<std::pair<int, int>, Histogram> _histograms;   // по (Report, параметр)
+   std::map<int, std::vector<PlaceCount>> _topPlaces;
+};
+
+#endif // TREESTATISTICS_H
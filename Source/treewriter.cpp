@@ -0,0 +1,617 @@
+#include "treewriter.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <unordered_map>
+
+#include "writelog.h"
+
+#define INFO_BEGIN  "/!info!\\"
+#define INFO_END    "\\!info!/"
+
+TreeWriter::TreeWriter()
+   : _compression(TREE_PLAIN),
+   _level(Z_DEFAULT_COMPRESSION),
+   _file(nullptr),
+   _deflate(false),
+   _ok(true)
+{
+   memset(&_zstream, 0, sizeof(_zstream));
+}
+
+void TreeWriter::setCompression(TreeCompression compression, int level)
+{
+   _compression = compression;
+   _level = level;
+}
+
+int TreeWriter::write(const QString &fileName, const QVector<Person*> &persons)
+{
+   QSaveFile file(fileName);
+   if (!file.open(QIODevice::WriteOnly))
+   {
+      writeDebugLog("TreeWriter::write Could not open " + fileName);
+      return -1;
+   }
+
+   _file = &file;
+   _ok = true;
+   _deflate = (_compression == TREE_DEFLATE);
+   _buffer.clear();
+   _buffer.reserve(TREEFILE_BUFFER + 64 * 1024);
+
+   if (_deflate)
+   {
+      // 15 + 16: окно 32 КБ и заголовок gzip, файл можно открыть и обычным gunzip
+      memset(&_zstream, 0, sizeof(_zstream));
+      if (deflateInit2(&_zstream, _level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      {
+         writeDebugLog("TreeWriter::write deflateInit2 failed");
+         return -1;
+      }
+      _packed.resize(TREEFILE_BUFFER);
+   }
+
+   _buffer += "#FTREE ";
+   putNumber(TREEFILE_VERSION);
+   _buffer += ' ';
+   putNumber(persons.size());
+   _buffer += '\n';
+
+   for (const Person *pers : persons)
+   {
+      putPerson(pers);
+      if ((_buffer.size() >= TREEFILE_BUFFER) && !flush(false))
+         break;
+   }
+   bool ok = _ok && flush(true);
+
+   if (_deflate)
+      deflateEnd(&_zstream);
+   _file = nullptr;
+
+   if (!ok || !file.commit())
+   {
+      writeDebugLog("TreeWriter::write Write failed: " + file.errorString());
+      return -1;
+   }
+
+   // Всё из журнала уже вошло в полный файл. Если удалить не вышло, повтор журнала
+   // поверх нового файла безвреден: последние версии записей в нём совпадают с файлом
+   QFile::remove(journalName(fileName));
+   return 0;
+}
+
+int TreeWriter::appendJournal(const QString &fileName, const QVector<Person*> &changed, const std::vector<uint32_t> &removed)
+{
+   if (changed.isEmpty() && removed.empty())
+      return 0;
+
+   QFile file(journalName(fileName));
+   if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+   {
+      writeDebugLog("TreeWriter::appendJournal Could not open " + file.fileName());
+      return -1;
+   }
+
+   // Журнал всегда без сжатия: пачки дописываются в конец по одной
+   _file = &file;
+   _ok = true;
+   _deflate = false;
+   _buffer.clear();
+
+   if (!file.size())
+   {
+      _buffer += "#FTREE ";
+      putNumber(TREEFILE_VERSION);
+      _buffer += " 0\n";
+   }
+   for (const Person *pers : changed)
+   {
+      putPerson(pers);
+      if ((_buffer.size() >= TREEFILE_BUFFER) && !flush(false))
+         break;
+   }
+   for (uint32_t id : removed)
+   {
+      _buffer += "#REMOVE ";
+      putNumber(id);
+      _buffer += '\n';
+   }
+   _buffer += "#COMMIT\n";
+
+   bool ok = _ok && flush(true) && file.flush();
+   _file = nullptr;
+   if (!ok)
+   {
+      writeDebugLog("TreeWriter::appendJournal Write failed: " + file.errorString());
+      return -1;
+   }
+   return 0;
+}
+
+void TreeWriter::putPerson(const Person *pers)
+{
+   putNumber(pers->id);
+   // Координаты пересчитывает раскладка, поле оставлено для совместимости с save_pure
+   _buffer += "\n0 0\n\n";
+   putString(pers->name);
+   _buffer += '\n';
+   _buffer += pers->bIsAlive ? '1' : '0';
+   _buffer += ' ';
+   putDate(pers->birthDate);
+   _buffer += ' ';
+   putDate(pers->deathDate);
+   _buffer += '\n';
+   putString(pers->sex);
+   _buffer += '\n';
+   putNumber(pers->mother ? static_cast<long long>(pers->mother->id) : -1);
+   _buffer += ' ';
+   putNumber(pers->father ? static_cast<long long>(pers->father->id) : -1);
+   _buffer += '\n';
+   putNumber(pers->children.size());
+   _buffer += ' ';
+   for (const Person *child : pers->children)
+   {
+      putNumber(child->id);
+      _buffer += ' ';
+   }
+   _buffer += '\n';
+   putString(pers->birthPlace);
+   _buffer += "\n" INFO_BEGIN "\n";
+   putString(pers->info);
+   _buffer += "\n" INFO_END "\n";
+   QByteArray photo = pers->photoData.toBase64();
+   _buffer.append(photo.constData(), photo.size());
+   _buffer += '\n';
+}
+
+void TreeWriter::putNumber(long long value)
+{
+   char digits[24];
+   int n = 0;
+   bool negative = value < 0;
+   unsigned long long v = negative ? 0ULL - static_cast<unsigned long long>(value) : static_cast<unsigned long long>(value);
+   do
+   {
+      digits[n++] = static_cast<char>('0' + v % 10);
+      v /= 10;
+   } while (v);
+   if (negative)
+      _buffer += '-';
+   while (n)
+      _buffer += digits[--n];
+}
+
+void TreeWriter::putDate(const QDate &date)
+{
+   // Тот же dd.MM.yyyy, что и QDate::toString, но без разбора строки формата на каждой дате
+   if (!date.isValid())
+      return;
+   int d = date.day(), m = date.month(), y = date.year();
+   char text[16];
+   text[0] = static_cast<char>('0' + d / 10);
+   text[1] = static_cast<char>('0' + d % 10);
+   text[2] = '.';
+   text[3] = static_cast<char>('0' + m / 10);
+   text[4] = static_cast<char>('0' + m % 10);
+   text[5] = '.';
+   if ((y >= 1000) && (y <= 9999))
+   {
+      text[6] = static_cast<char>('0' + y / 1000);
+      text[7] = static_cast<char>('0' + y / 100 % 10);
+      text[8] = static_cast<char>('0' + y / 10 % 10);
+      text[9] = static_cast<char>('0' + y % 10);
+      _buffer.append(text, 10);
+   }
+   else
+   {
+      _buffer.append(text, 6);
+      putNumber(y);
+   }
+}
+
+void TreeWriter::putString(const QString &str)
+{
+   QByteArray utf8 = str.toUtf8();
+   _buffer.append(utf8.constData(), utf8.size());
+}
+
+bool TreeWriter::flush(bool last)
+{
+   if (!_deflate)
+   {
+      qint64 size = static_cast<qint64>(_buffer.size());
+      _ok = _ok && (_file->write(_buffer.data(), size) == size);
+      _buffer.clear();
+      return _ok;
+   }
+
+   _zstream.next_in = reinterpret_cast<Bytef*>(&_buffer[0]);
+   _zstream.avail_in = static_cast<uInt>(_buffer.size());
+   int mode = last ? Z_FINISH : Z_NO_FLUSH;
+   int ret;
+   do
+   {
+      _zstream.next_out = reinterpret_cast<Bytef*>(&_packed[0]);
+      _zstream.avail_out = static_cast<uInt>(_packed.size());
+      ret = deflate(&_zstream, mode);
+      if (ret == Z_STREAM_ERROR)
+         return _ok = false;
+      qint64 produced = static_cast<qint64>(_packed.size() - _zstream.avail_out);
+      if (produced)
+         _ok = _ok && (_file->write(_packed.data(), produced) == produced);
+   } while (_ok && ((_zstream.avail_out == 0) || (last && (ret != Z_STREAM_END))));
+
+   _buffer.clear();
+   return _ok;
+}
+
+TreeReader::TreeReader()
+   : _file(nullptr),
+   _pos(0),
+   _compressed(false),
+   _eof(false),
+   _version(0)
+{
+   memset(&_zstream, 0, sizeof(_zstream));
+}
+
+bool TreeReader::fill()
+{
+   if (_eof)
+      return false;
+
+   // Разобранное начало буфера выбрасывается, чтобы он не рос вместе с файлом
+   if (_pos)
+   {
+      _data.erase(0, _pos);
+      _pos = 0;
+   }
+
+   qint64 got = _file->read(_raw.data(), static_cast<qint64>(_raw.size()));
+   if (got <= 0)
+   {
+      _eof = true;
+      return false;
+   }
+
+   if (!_compressed)
+   {
+      _data.append(_raw.data(), static_cast<size_t>(got));
+      return true;
+   }
+
+   char out[64 * 1024];
+   _zstream.next_in = reinterpret_cast<Bytef*>(_raw.data());
+   _zstream.avail_in = static_cast<uInt>(got);
+   while (_zstream.avail_in)
+   {
+      _zstream.next_out = reinterpret_cast<Bytef*>(out);
+      _zstream.avail_out = sizeof(out);
+      int ret = inflate(&_zstream, Z_NO_FLUSH);
+      _data.append(out, sizeof(out) - _zstream.avail_out);
+      if (ret == Z_STREAM_END)
+      {
+         _eof = true;
+         break;
+      }
+      if ((ret != Z_OK) && (ret != Z_BUF_ERROR))
+      {
+         writeDebugLog("TreeReader::fill Corrupted compressed data");
+         _eof = true;
+         return false;
+      }
+   }
+   return true;
+}
+
+bool TreeReader::nextLine(std::string &line)
+{
+   size_t eol;
+   while ((eol = _data.find('\n', _pos)) == std::string::npos)
+   {
+      if (!fill())
+      {
+         // Последняя строка без перевода строки
+         if (_pos >= _data.size())
+            return false;
+         eol = _data.size();
+         break;
+      }
+   }
+
+   size_t end = eol;
+   if ((end > _pos) && (_data[end - 1] == '\r'))
+      end--;
+   line.assign(_data, _pos, end - _pos);
+   _pos = (eol < _data.size()) ? eol + 1 : eol;
+   return true;
+}
+
+QDate TreeReader::parseDate(const std::string &text)
+{
+   int d = 0, m = 0, y = 0;
+   if ((text.size() < 10) || (text[2] != '.') || (text[5] != '.'))
+      return QDate();
+   d = atoi(text.c_str());
+   m = atoi(text.c_str() + 3);
+   y = atoi(text.c_str() + 6);
+   return QDate(y, m, d);
+}
+
+bool TreeReader::open(QFile &file)
+{
+   _file = &file;
+   _raw.resize(TREEFILE_BUFFER);
+   _data.clear();
+   _pos = 0;
+   _eof = false;
+
+   // gzip узнаётся по первым двум байтам
+   char magic[2] = { 0, 0 };
+   _compressed = (file.peek(magic, 2) == 2) && (static_cast<uchar>(magic[0]) == 0x1F) && (static_cast<uchar>(magic[1]) == 0x8B);
+   if (_compressed)
+   {
+      memset(&_zstream, 0, sizeof(_zstream));
+      if (inflateInit2(&_zstream, 15 + 16) != Z_OK)
+      {
+         writeDebugLog("TreeReader::open inflateInit2 failed");
+         _compressed = false;
+         return false;
+      }
+   }
+   return true;
+}
+
+void TreeReader::close()
+{
+   if (_compressed)
+      inflateEnd(&_zstream);
+   _file = nullptr;
+   _data.clear();
+   _raw.clear();
+   _raw.shrink_to_fit();
+}
+
+int TreeReader::readRecord(const std::string &idLine, int version, Person &pers, Links &links)
+{
+   pers.id = static_cast<uint32_t>(strtoul(idLine.c_str(), nullptr, 10));
+
+   std::string coords, blank, name, dates, sex, parents, children, place, line;
+   if (!nextLine(coords) || !nextLine(blank) || !nextLine(name) || !nextLine(dates) || !nextLine(sex)
+         || !nextLine(parents) || !nextLine(children) || !nextLine(place) || !nextLine(line) || (line != INFO_BEGIN))
+      return -1;
+
+   pers.name = QString::fromUtf8(name.data(), static_cast<int>(name.size()));
+   pers.sex = QString::fromUtf8(sex.data(), static_cast<int>(sex.size()));
+   pers.birthPlace = QString::fromUtf8(place.data(), static_cast<int>(place.size()));
+
+   // "1 dd.MM.yyyy dd.MM.yyyy", пустая дата оставляет два пробела подряд
+   size_t first = dates.find(' ');
+   size_t second = (first != std::string::npos) ? dates.find(' ', first + 1) : std::string::npos;
+   pers.bIsAlive = !dates.empty() && (dates[0] == '1');
+   pers.birthDate = (first != std::string::npos) ? parseDate(dates.substr(first + 1, second - first - 1)) : QDate();
+   pers.deathDate = (second != std::string::npos) ? parseDate(dates.substr(second + 1)) : QDate();
+
+   char *end = nullptr;
+   links.mother = strtoll(parents.c_str(), &end, 10);
+   links.father = strtoll(end, nullptr, 10);
+
+   long count = strtol(children.c_str(), &end, 10);
+   links.children.clear();
+   for (long k = 0; k < count; k++)
+      links.children.push_back(strtoll(end, &end, 10));
+
+   std::string info;
+   bool closed = false;
+   bool firstLine = true;
+   while (nextLine(line))
+   {
+      if (line == INFO_END)
+      {
+         closed = true;
+         break;
+      }
+      if (!firstLine)
+         info += '\n';
+      info += line;
+      firstLine = false;
+   }
+   if (!closed)
+      return -1;
+   pers.info = QString::fromUtf8(info.data(), static_cast<int>(info.size()));
+
+   pers.photoData.clear();
+   if (version >= 1)
+   {
+      if (!nextLine(line))
+         return -1;
+      if (!line.empty())
+         pers.photoData = QByteArray::fromBase64(QByteArray::fromRawData(line.data(), static_cast<int>(line.size())));
+   }
+   return 0;
+}
+
+int TreeReader::parse(const QString &fileName, std::vector<Person> &persons, std::vector<Links> &links, bool journal)
+{
+   QFile file(fileName);
+   if (!file.open(QIODevice::ReadOnly))
+   {
+      if (journal)
+         return 0;
+      writeDebugLog("TreeReader::parse Could not open " + fileName);
+      return -1;
+   }
+   if (!open(file))
+      return -1;
+
+   int version = 0;
+   std::string line;
+   bool haveLine = nextLine(line);
+   if (haveLine && !line.compare(0, 7, "#FTREE "))
+   {
+      char *end = nullptr;
+      version = static_cast<int>(strtol(line.c_str() + 7, &end, 10));
+      long count = strtol(end, nullptr, 10);
+      if (count > 0)
+      {
+         persons.reserve(static_cast<size_t>(count));
+         links.reserve(static_cast<size_t>(count));
+      }
+      haveLine = nextLine(line);
+   }
+   if (!journal)
+      _version = version;
+
+   // Журнал копит пачку до строки #COMMIT и только тогда накладывает её по id
+   std::unordered_map<uint32_t, size_t> index;
+   std::vector<char> removed;
+   std::vector<Person> batch;
+   std::vector<Links> batchLinks;
+   std::vector<uint32_t> batchRemoved;
+   if (journal)
+   {
+      index.reserve(persons.size());
+      for (size_t i = 0; i < persons.size(); i++)
+         index[persons[i].id] = i;
+      removed.assign(persons.size(), 0);
+   }
+
+   int ret = 0;
+   while (haveLine)
+   {
+      if (line.empty())
+      {
+         haveLine = nextLine(line);
+         continue;
+      }
+
+      if (journal && !line.compare(0, 8, "#REMOVE "))
+         batchRemoved.push_back(static_cast<uint32_t>(strtoul(line.c_str() + 8, nullptr, 10)));
+      else if (journal && (line == "#COMMIT"))
+      {
+         for (size_t i = 0; i < batch.size(); i++)
+         {
+            auto it = index.find(batch[i].id);
+            if (it != index.end())
+            {
+               persons[it->second] = batch[i];
+               links[it->second] = batchLinks[i];
+               removed[it->second] = 0;
+            }
+            else
+            {
+               index[batch[i].id] = persons.size();
+               persons.push_back(batch[i]);
+               links.push_back(batchLinks[i]);
+               removed.push_back(0);
+            }
+         }
+         for (uint32_t id : batchRemoved)
+         {
+            auto it = index.find(id);
+            if (it != index.end())
+               removed[it->second] = 1;
+         }
+         batch.clear();
+         batchLinks.clear();
+         batchRemoved.clear();
+      }
+      else
+      {
+         std::vector<Person> &target = journal ? batch : persons;
+         std::vector<Links> &targetLinks = journal ? batchLinks : links;
+         target.emplace_back();
+         targetLinks.emplace_back();
+         if (readRecord(line, version, target.back(), targetLinks.back()))
+         {
+            // Оборванная пачка в конце журнала - обычное дело после сбоя, она просто не применяется
+            if (!journal)
+               ret = -1;
+            break;
+         }
+      }
+
+      haveLine = nextLine(line);
+   }
+   close();
+
+   if (ret)
+   {
+      writeDebugLog("TreeReader::parse Truncated record in " + fileName);
+      return ret;
+   }
+
+   if (journal && !batch.empty())
+      writeDebugLog("TreeReader::parse Unfinished journal batch dropped in " + fileName);
+
+   // Удалённые вычёркиваются сдвигом, порядок остальных сохраняется
+   size_t kept = 0;
+   for (size_t i = 0; i < removed.size(); i++)
+   {
+      if (removed[i])
+         continue;
+      if (kept != i)
+      {
+         persons[kept] = persons[i];
+         links[kept] = std::move(links[i]);
+      }
+      kept++;
+   }
+   if (journal)
+   {
+      persons.resize(kept);
+      links.resize(kept);
+   }
+   return 0;
+}
+
+int TreeReader::read(const QString &fileName, std::vector<Person> &persons)
+{
+   persons.clear();
+   _version = 0;
+
+   std::vector<Links> links;
+   int ret = parse(fileName, persons, links, false);
+   if (!ret)
+      ret = parse(TreeWriter::journalName(fileName), persons, links, true);
+   if (ret)
+   {
+      persons.clear();
+      return ret;
+   }
+
+   // Связи по id восстанавливаются, когда вектор уже не будет перераспределяться
+   std::unordered_map<uint32_t, Person*> byId;
+   byId.reserve(persons.size());
+   for (Person &pers : persons)
+   {
+      byId[pers.id] = &pers;
+      if (pers.id > Person::global_id)
+         Person::global_id = pers.id;
+   }
+
+   auto find = [&byId](long long id) -> Person*
+   {
+      if (id < 0)
+         return nullptr;
+      auto it = byId.find(static_cast<uint32_t>(id));
+      return (it != byId.end()) ? it->second : nullptr;
+   };
+
+   for (size_t i = 0; i < persons.size(); i++)
+   {
+      Person &pers = persons[i];
+      pers.mother = find(links[i].mother);
+      pers.father = find(links[i].father);
+      pers.children.clear();
+      for (long long id : links[i].children)
+      {
+         Person *child = find(id);
+         if (child)
+            pers.children.append(child);
+      }
+   }
+   return 0;
+}
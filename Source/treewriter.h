@@ -0,0 +1,107 @@
+#ifndef TREEWRITER_H
+#define TREEWRITER_H
+
+/*
+ * Текстовое сохранение всего дерева за один проход - замена Person::save_pure.
+ * Формат записей тот же, что у save_pure (id, координаты, имя, даты, пол, родители, дети,
+ * место рождения, блок info), но файл открывается один раз, строки копятся в большом буфере
+ * и уходят на диск целыми блоками, без flush на каждой строке.
+ * Новый файл начинается строкой "#FTREE <версия> <число людей>", после блока info идёт фото
+ * в base64 (пустая строка - без фото). Файлы save_pure без заголовка тоже читаются.
+ * По желанию поток сжимается deflate в обёртке gzip; читатель определяет сжатие сам.
+ * Мелкие правки дописываются в журнал <файл>.journal: записи изменённых людей в том же формате,
+ * строки "#REMOVE <id>" и "#COMMIT" в конце каждой пачки. Читатель накладывает журнал
+ * на основной файл по id, недописанная последняя пачка отбрасывается.
+ * Полная запись (она же уплотнение) удаляет журнал.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <QString>
+#include <QVector>
+#include <QFile>
+#include <QSaveFile>
+
+#include <zlib.h>
+
+#include "person.h"
+
+#define TREEFILE_VERSION        1
+#define TREEFILE_BUFFER         (1024 * 1024)
+#define TREEFILE_JOURNAL_SUFFIX ".journal"
+
+enum TreeCompression
+{
+   TREE_PLAIN,
+   TREE_DEFLATE
+};
+
+class TreeWriter
+{
+public:
+   TreeWriter();
+
+   void setCompression(TreeCompression compression, int level = 6);
+
+   int write(const QString &fileName, const QVector<Person*> &persons);
+   int appendJournal(const QString &fileName, const QVector<Person*> &changed, const std::vector<uint32_t> &removed);
+
+   static QString journalName(const QString &fileName) { return fileName + TREEFILE_JOURNAL_SUFFIX; }
+
+private:
+   void putPerson(const Person *pers);
+   void putNumber(long long value);
+   void putDate(const QDate &date);
+   void putString(const QString &str);
+   bool flush(bool last);
+
+   TreeCompression _compression;
+   int _level;
+   QFileDevice *_file;
+   std::string _buffer;
+   std::string _packed;
+   z_stream _zstream;
+   bool _deflate;
+   bool _ok;
+};
+
+class TreeReader
+{
+public:
+   TreeReader();
+
+   int read(const QString &fileName, std::vector<Person> &persons);
+
+   int version() const { return _version; }
+   bool isCompressed() const { return _compressed; }
+
+private:
+   struct Links
+   {
+      long long mother;
+      long long father;
+      std::vector<long long> children;
+   };
+
+   int parse(const QString &fileName, std::vector<Person> &persons, std::vector<Links> &links, bool journal);
+   int readRecord(const std::string &idLine, int version, Person &pers, Links &links);
+   bool open(QFile &file);
+   void close();
+   bool nextLine(std::string &line);
+   bool fill();
+
+   static QDate parseDate(const std::string &text);
+
+   QFile *_file;
+   std::vector<char> _raw;
+   std::string _data;         // распакованные байты, ещё не разобранные на строки
+   size_t _pos;
+   z_stream _zstream;
+   bool _compressed;
+   bool _eof;
+   int _version;
+};
+
+#endif // TREEWRITER_H